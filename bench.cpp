@@ -0,0 +1,719 @@
+/*
+ * Benchmarks of libbezier's own functions, apart from drawing (see bench.hpp).
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "trace.hpp"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+
+static size_t cpu_count() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+/*
+ * Share count things out between a thread on every CPU, in one batch each, and wait for them all
+ * to finish. Each thread calls work(part, first, batch) for the 'batch' things from 'first' on;
+ * 'part' counts the batches from 0, and is always less than cpu_count().
+ * Returns how many threads there were.
+ */
+template <typename Work>
+static size_t on_every_cpu(size_t count, Work work) {
+    size_t per_thread = (count + cpu_count() - 1) / cpu_count();
+    std::vector<std::thread> threads;
+
+    for (size_t first = 0; first < count; first += per_thread) {
+        threads.emplace_back(work, threads.size(), first, std::min(per_thread, count - first));
+    }
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    return threads.size();
+}
+
+
+/*
+ * --rays; how fast libbezier finds where lines cross the scene's curves (see intersect.cpp).
+ *
+ * Rays start at random places in the scene and go off in random directions until they hit
+ * a curve. They are shared out between a thread on every CPU, in one batch each.
+ * Then the answers are checked: the point on each curve where it was hit should be on the ray,
+ * no more than RAY_TOLERANCE away (well under a pixel, at any size the windows show), and
+ * bz_intersect_ray_all should agree about which hit is nearest. If not, this returns 1.
+ */
+const float RAY_TOLERANCE = 0.001f;     // In scene units
+
+int run_rays(Scene& scene, size_t count) {
+    size_t curve_count = scene.curves.size();
+    std::vector<bz_bvh_node> nodes(bz_bvh_nodes(curve_count));
+    std::vector<uint32_t> order(curve_count);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bz_bvh bvh = bz_bvh_build(scene.curves.data(), curve_count, nodes.data(), order.data());
+    double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<bz_ray> rays(count);
+    std::vector<bz_hit> hits(count);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    for (bz_ray& ray : rays) {
+        float angle = unit(random) * 2 * (float) M_PI;
+        ray = bz_ray{Point{unit(random), unit(random)}, Point{std::cos(angle), std::sin(angle)}, INFINITY};
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    size_t threads = on_every_cpu(count, [&bvh, &rays, &hits](size_t, size_t first, size_t batch) {
+        TRACE_SCOPE("intersect");
+        bz_intersect_rays(&bvh, rays.data() + first, batch, hits.data() + first);
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t hit_count = std::count_if(hits.begin(), hits.end(), [](const bz_hit& hit) { return hit.curve != BZ_NO_HIT; });
+
+    cout << "Rays: " << count << " rays against " << curve_count << " curves on " << threads << " threads" << endl;
+    cout << "  BVH: " << bvh.node_count << " boxes, built in " << build_seconds * 1000 << " ms" << endl;
+    float furthest = 0;
+    size_t disagree = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const bz_ray& ray = rays[i];
+        const bz_hit& hit = hits[i];
+        bz_hit nearest;
+
+        if (bz_intersect_ray_all(&bvh, &ray, &nearest, 1) != (hit.curve != BZ_NO_HIT ? 1 : 0)) {
+            ++disagree;
+            continue;
+        }
+
+        if (hit.curve == BZ_NO_HIT) {
+            continue;
+        }
+
+        if (nearest.distance != hit.distance) {
+            ++disagree;
+        }
+
+        Point on_curve = evaluate_curve(scene.curves[hit.curve], hit.t);
+        Point on_ray = {ray.origin.x + hit.distance * ray.direction.x, ray.origin.y + hit.distance * ray.direction.y};
+        furthest = std::max(furthest, std::hypot(on_curve.x - on_ray.x, on_curve.y - on_ray.y));
+    }
+
+    cout << "  " << count / seconds << " rays/sec, " << 100.0 * hit_count / std::max(count, (size_t) 1)
+         << "% hit a curve" << endl;
+    cout << "  hit points up to " << furthest << " from the ray; bz_intersect_ray_all disagrees about the nearest for "
+         << disagree << " rays" << endl;
+
+    if (furthest > RAY_TOLERANCE || disagree > 0) {
+        cerr << "Error: Rays found the wrong crossings" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * --inside; how fast libbezier finds whether points are inside the scene's shapes (see winding.cpp).
+ *
+ * Each curve is a shape on its own, closed by the straight line between its ends, as --raster fill
+ * draws it. The points are at random places in the scene, shared out between a thread on every CPU.
+ */
+int run_inside(Scene& scene, size_t count) {
+    size_t curve_count = scene.curves.size();
+    std::vector<size_t> path_ends(curve_count);
+
+    for (size_t i = 0; i < curve_count; ++i) {
+        path_ends[i] = i + 1;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<float> memory(bz_winding_grid_size(scene.curves.data(), path_ends.data(), curve_count) / sizeof(float) + 1);
+    bz_winding_grid grid = bz_winding_grid_build(scene.curves.data(), path_ends.data(), curve_count, memory.data());
+    double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<Point> points(count);
+    std::vector<uint8_t> inside(count);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    for (Point& point : points) {
+        point = Point{unit(random), unit(random)};
+    }
+
+    start = std::chrono::steady_clock::now();
+
+    size_t threads = on_every_cpu(count, [&grid, &points, &inside](size_t, size_t first, size_t batch) {
+        TRACE_SCOPE("inside");
+        bz_points_inside(&grid, points.data() + first, batch, BZ_FILL_NONZERO, inside.data() + first);
+    });
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t inside_count = std::count(inside.begin(), inside.end(), 1);
+
+    cout << "Inside: " << count << " points against " << curve_count << " shapes on " << threads << " threads" << endl;
+    cout << "  grid: " << grid.columns << "x" << grid.rows << " tiles, " << grid.piece_count << " pieces, "
+         << (double) grid.entry_count / ((size_t) grid.columns * grid.rows) << " per tile, built in "
+         << build_seconds * 1000 << " ms" << endl;
+    cout << "  " << count / seconds << " points/sec, " << 100.0 * inside_count / std::max(count, (size_t) 1)
+         << "% inside" << endl;
+    return 0;
+}
+
+
+/*
+ * --collide; how fast libbezier finds when moving circles first touch the scene's curves (see collide.cpp).
+ *
+ * The circles are at random places, with random sizes, and each moves a little in a random direction,
+ * as bodies in a physics engine would in one step; they are shared out between a thread on every CPU.
+ * Bodies don't usually start a step touching something, so circles which do are put somewhere else
+ * (up to COLLIDE_PLACE_TRIES times, since some scenes have hardly any room).
+ * For comparison, the curves are then turned into 'steps' straight lines each (as tessellation does, for
+ * physics engines which only know about lines), and the same circles are moved against those. That
+ * is only done for scenes with up to COLLIDE_MAX_LINES lines, to keep the memory down.
+ */
+const float COLLIDE_MAX_MOVE = 0.05f;       // In scene units
+const float COLLIDE_MIN_RADIUS = 0.001f;
+const float COLLIDE_MAX_RADIUS = 0.005f;
+const size_t COLLIDE_MAX_LINES = 4000000;
+const int COLLIDE_PLACE_TRIES = 10;
+
+static double collide_all(const bz_collision_grid& grid, const std::vector<bz_circle>& circles,
+                          std::vector<bz_contact>& contacts) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    on_every_cpu(circles.size(), [&grid, &circles, &contacts](size_t, size_t first, size_t batch) {
+        TRACE_SCOPE("collide");
+        bz_collide_circles(&grid, circles.data() + first, batch, contacts.data() + first);
+    });
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int run_collide(Scene& scene, size_t count, int steps) {
+    size_t curve_count = scene.curves.size();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<float> memory(bz_collision_grid_size(scene.curves.data(), curve_count) / sizeof(float) + 1);
+    bz_collision_grid grid = bz_collision_grid_build(scene.curves.data(), curve_count, memory.data());
+    double build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<bz_circle> circles(count);
+    std::vector<bz_contact> contacts(count);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    for (bz_circle& circle : circles) {
+        float angle = unit(random) * 2 * (float) M_PI, distance = unit(random) * COLLIDE_MAX_MOVE;
+        float radius = COLLIDE_MIN_RADIUS + unit(random) * (COLLIDE_MAX_RADIUS - COLLIDE_MIN_RADIUS);
+
+        circle = bz_circle{Point{unit(random), unit(random)}, Point{distance * std::cos(angle), distance * std::sin(angle)}, radius};
+    }
+
+    // Not moving at all finds the circles which touch something where they are
+    for (int attempt = 0; attempt < COLLIDE_PLACE_TRIES; ++attempt) {
+        std::vector<bz_circle> still(circles);
+
+        for (bz_circle& circle : still) {
+            circle.move = Point{0, 0};
+        }
+
+        collide_all(grid, still, contacts);
+
+        for (size_t i = 0; i < count; ++i) {
+            if (contacts[i].curve != BZ_NO_HIT) {
+                circles[i].position = Point{unit(random), unit(random)};
+            }
+        }
+    }
+
+    double seconds = collide_all(grid, circles, contacts);
+    size_t hit_count = std::count_if(contacts.begin(), contacts.end(), [](const bz_contact& c) { return c.curve != BZ_NO_HIT; });
+
+    cout << "Collide: " << count << " moving circles against " << curve_count << " curves" << endl;
+    cout << "  grid: " << grid.columns << "x" << grid.rows << " tiles, " << grid.entry_count << " entries, built in "
+         << build_seconds * 1000 << " ms" << endl;
+    cout << "  " << count / seconds << " circles/sec, " << 100.0 * hit_count / std::max(count, (size_t) 1)
+         << "% touch a curve" << endl;
+
+    if (curve_count * steps > COLLIDE_MAX_LINES) {
+        return 0;
+    }
+
+    // Each line as a quadratic curve with its middle control point half way along, which is straight already
+    std::vector<Point> points(bz_tessellation_size(curve_count, steps));
+    std::vector<bz_curve> lines;
+
+    start = std::chrono::steady_clock::now();
+    bz_tessellate(scene.curves.data(), curve_count, steps, points.data());
+    lines.reserve(curve_count * steps);
+
+    for (size_t i = 0; i < curve_count; ++i) {
+        const Point *p = points.data() + i * (steps + 1);
+
+        for (int step = 0; step < steps; ++step) {
+            Point middle = {0.5f * (p[step].x + p[step + 1].x), 0.5f * (p[step].y + p[step + 1].y)};
+            lines.push_back(bz_curve{2, {p[step], middle, p[step + 1]}, 0, 0, 0});
+        }
+    }
+
+    std::vector<float> line_memory(bz_collision_grid_size(lines.data(), lines.size()) / sizeof(float) + 1);
+    bz_collision_grid line_grid = bz_collision_grid_build(lines.data(), lines.size(), line_memory.data());
+    build_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<bz_contact> line_contacts(count);
+    double line_seconds = collide_all(line_grid, circles, line_contacts);
+    size_t disagree = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        disagree += (contacts[i].curve == BZ_NO_HIT) != (line_contacts[i].curve == BZ_NO_HIT);
+    }
+
+    cout << "  as " << lines.size() << " lines: " << line_grid.entry_count << " grid entries, built in "
+         << build_seconds * 1000 << " ms, " << count / line_seconds << " circles/sec, "
+         << 100.0 * disagree / std::max(count, (size_t) 1) << "% touch one but not the other" << endl;
+    return 0;
+}
+
+
+/*
+ * --msdf; how fast libbezier makes multi-channel signed distance fields (see msdf.cpp), and how
+ * well shapes come out when they are drawn bigger from them.
+ *
+ * Each curve is a shape on its own, closed by the straight line between its ends, as --raster fill
+ * draws it, and gets its own MSDF_SIZE by MSDF_SIZE texture. Shapes which go round anticlockwise
+ * would be holes, so they are turned round first. The textures are shared out between a thread
+ * on every CPU, MSDF_BAND rows at a time, so a single big texture would be shared out too.
+ * Then the first MSDF_CHECK_SHAPES shapes are drawn MSDF_CHECK_SCALE times bigger from their
+ * textures, as a GPU would (blending between the 4 nearest texels), and compared with whether each
+ * pixel is really inside the shape. The same is done with a plain signed distance field (every
+ * curve in every channel) for comparison.
+ *
+ * Finally, a square with a square hole in it, and the hole's square on its own (which, going round
+ * anticlockwise, is a hole in nothing), are checked the same way. If more than MSDF_HOLE_TOLERANCE
+ * of their pixels are wrong, this returns 1.
+ */
+const int MSDF_SIZE = 32;
+const float MSDF_RANGE = 2;             // In texels
+const int MSDF_BAND = 8;
+const size_t MSDF_CHECK_SHAPES = 100;
+const int MSDF_CHECK_SCALE = 4;
+const double MSDF_HOLE_TOLERANCE = 0.01;
+
+typedef struct {
+    std::vector<bz_curve> curves;
+    std::vector<size_t> path_ends;
+    std::vector<uint8_t> colours;
+    bz_transform transform;
+    std::vector<float> grid_memory;
+    bz_winding_grid grid;
+} MsdfShape;
+
+/*
+ * Pick the curves' colours, build the winding grid, and fit the shape into its texture,
+ * leaving MSDF_RANGE texels all round.
+ */
+static void prepare_msdf(MsdfShape& shape) {
+    shape.colours.resize(shape.curves.size());
+    bz_msdf_colour_edges(shape.curves.data(), shape.path_ends.data(), shape.path_ends.size(), 3, shape.colours.data());
+
+    shape.grid_memory.resize(bz_winding_grid_size(shape.curves.data(), shape.path_ends.data(), shape.path_ends.size())
+                             / sizeof(float) + 1);
+    shape.grid = bz_winding_grid_build(shape.curves.data(), shape.path_ends.data(), shape.path_ends.size(),
+                                       shape.grid_memory.data());
+
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+
+    for (const bz_curve& curve : shape.curves) {
+        for (int p = 0; p <= curve.degree; ++p) {
+            min_x = std::min(min_x, curve.p[p].x);
+            min_y = std::min(min_y, curve.p[p].y);
+            max_x = std::max(max_x, curve.p[p].x);
+            max_y = std::max(max_y, curve.p[p].y);
+        }
+    }
+
+    float room = MSDF_SIZE - 2 * MSDF_RANGE;
+    float scale = room / std::max(std::max(max_x - min_x, max_y - min_y), 1e-6f);
+
+    shape.transform = bz_transform{scale, scale, MSDF_RANGE + 0.5f * (room - (max_x - min_x) * scale) - min_x * scale,
+                                   MSDF_RANGE + 0.5f * (room - (max_y - min_y) * scale) - min_y * scale};
+}
+
+/*
+ * A straight line from a to b, as a curve.
+ */
+static bz_curve straight(Point a, Point b) {
+    return bz_curve{2, {a, Point{0.5f * (a.x + b.x), 0.5f * (a.y + b.y)}, b}, 0, 0, 0};
+}
+
+static double make_msdfs(std::vector<MsdfShape>& shapes, std::vector<uint32_t>& texels, bool plain) {
+    // Each job is one band of one shape's texture
+    size_t bands = (MSDF_SIZE + MSDF_BAND - 1) / MSDF_BAND;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    on_every_cpu(shapes.size() * bands, [&shapes, &texels, bands, plain](size_t, size_t first, size_t batch) {
+        TRACE_SCOPE("msdf");
+
+        for (size_t job = first; job < first + batch; ++job) {
+            MsdfShape& shape = shapes[job / bands];
+            bz_canvas canvas = {texels.data() + job / bands * MSDF_SIZE * MSDF_SIZE, MSDF_SIZE, MSDF_SIZE, MSDF_SIZE};
+            std::vector<uint8_t> white(plain ? shape.curves.size() : 0, 7);
+
+            bz_msdf_rows(&canvas, &shape.transform, MSDF_RANGE, shape.curves.data(), plain ? white.data() : shape.colours.data(),
+                         shape.curves.size(), &shape.grid, (int) (job % bands) * MSDF_BAND, MSDF_BAND);
+        }
+    });
+
+    // The clean-up needs every row, but is quick
+    if (!plain) {
+        for (size_t i = 0; i < shapes.size(); ++i) {
+            bz_canvas canvas = {texels.data() + i * MSDF_SIZE * MSDF_SIZE, MSDF_SIZE, MSDF_SIZE, MSDF_SIZE};
+            bz_msdf_correct(&canvas, MSDF_RANGE);
+        }
+    }
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * How many of the pixels come out wrong when a shape is drawn MSDF_CHECK_SCALE times bigger from its texture.
+ * Inside is wherever the paths go round clockwise more times than anticlockwise, as bezier.h says.
+ */
+static size_t msdf_wrong_pixels(const MsdfShape& shape, const uint32_t *texels) {
+    const int size = MSDF_SIZE * MSDF_CHECK_SCALE;
+    std::vector<Point> points(size);
+    std::vector<int32_t> winding(size);
+    size_t wrong = 0;
+
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            points[x] = Point{((x + 0.5f) / MSDF_CHECK_SCALE - shape.transform.offset_x) / shape.transform.scale_x,
+                              ((y + 0.5f) / MSDF_CHECK_SCALE - shape.transform.offset_y) / shape.transform.scale_y};
+        }
+
+        bz_winding_numbers(&shape.grid, points.data(), size, winding.data());
+
+        for (int x = 0; x < size; ++x) {
+            // Blend the 4 nearest texels, with their middles at half a texel in
+            float tx = std::min(std::max((x + 0.5f) / MSDF_CHECK_SCALE - 0.5f, 0.0f), MSDF_SIZE - 1.001f);
+            float ty = std::min(std::max((y + 0.5f) / MSDF_CHECK_SCALE - 0.5f, 0.0f), MSDF_SIZE - 1.001f);
+            int x0 = (int) tx, y0 = (int) ty;
+            float fx = tx - x0, fy = ty - y0;
+            float channels[3];
+
+            for (int c = 0; c < 3; ++c) {
+                int shift = 16 - 8 * c;
+                const uint32_t *t = texels + y0 * MSDF_SIZE + x0;
+                float top = ((t[0] >> shift) & 0xff) * (1 - fx) + ((t[1] >> shift) & 0xff) * fx;
+                float bottom = ((t[MSDF_SIZE] >> shift) & 0xff) * (1 - fx) + ((t[MSDF_SIZE + 1] >> shift) & 0xff) * fx;
+                channels[c] = top * (1 - fy) + bottom * fy;
+            }
+
+            float median = std::max(std::min(channels[0], channels[1]), std::min(std::max(channels[0], channels[1]), channels[2]));
+            wrong += (median > 127.5f) != (winding[x] > 0);
+        }
+    }
+
+    return wrong;
+}
+
+int run_msdf(Scene& scene, size_t count) {
+    count = std::min(count, scene.curves.size());
+    std::vector<MsdfShape> shapes(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        MsdfShape& shape = shapes[i];
+        bz_curve curve = scene.curves[i];
+        size_t path_end = 1;
+        bz_moments moments;
+        bz_path_moments(&curve, &path_end, 1, &moments);
+
+        if (moments.area < 0) {
+            std::reverse(curve.p, curve.p + curve.degree + 1);
+        }
+
+        shape.curves = {curve, straight(curve.p[curve.degree], curve.p[0])};
+        shape.path_ends = {2};
+        prepare_msdf(shape);
+    }
+
+    std::vector<uint32_t> texels(count * MSDF_SIZE * MSDF_SIZE), plain_texels(texels.size());
+    double seconds = make_msdfs(shapes, texels, false);
+    double plain_seconds = make_msdfs(shapes, plain_texels, true);
+
+    size_t checked = std::min(count, MSDF_CHECK_SHAPES), wrong = 0, plain_wrong = 0;
+
+    for (size_t i = 0; i < checked; ++i) {
+        wrong += msdf_wrong_pixels(shapes[i], texels.data() + i * MSDF_SIZE * MSDF_SIZE);
+        plain_wrong += msdf_wrong_pixels(shapes[i], plain_texels.data() + i * MSDF_SIZE * MSDF_SIZE);
+    }
+
+    double pixels = (double) checked * MSDF_SIZE * MSDF_SIZE * MSDF_CHECK_SCALE * MSDF_CHECK_SCALE;
+    size_t texel_count = count * MSDF_SIZE * MSDF_SIZE;
+
+    cout << "MSDF: " << count << " shapes, " << MSDF_SIZE << "x" << MSDF_SIZE << " texels each" << endl;
+    cout << "  " << texel_count / seconds << " texels/sec (plain SDF: " << texel_count / plain_seconds << ")" << endl;
+    cout << "  drawn " << MSDF_CHECK_SCALE << " times bigger: " << 100 * wrong / std::max(pixels, 1.0) << "% of pixels wrong"
+         << " (plain SDF: " << 100 * plain_wrong / std::max(pixels, 1.0) << "%)" << endl;
+
+    // A clockwise square with an anticlockwise one inside it, and then the inside one on its own
+    Point outer[4] = {{0, 0}, {1, 0}, {1, 1}, {0, 1}};
+    Point inner[4] = {{0.3f, 0.3f}, {0.3f, 0.7f}, {0.7f, 0.7f}, {0.7f, 0.3f}};
+    std::vector<MsdfShape> holes(2);
+
+    for (int i = 0; i < 4; ++i) {
+        holes[0].curves.push_back(straight(outer[i], outer[(i + 1) % 4]));
+    }
+
+    for (int i = 0; i < 4; ++i) {
+        holes[0].curves.push_back(straight(inner[i], inner[(i + 1) % 4]));
+        holes[1].curves.push_back(straight(inner[i], inner[(i + 1) % 4]));
+    }
+
+    holes[0].path_ends = {4, 8};
+    holes[1].path_ends = {4};
+    prepare_msdf(holes[0]);
+    prepare_msdf(holes[1]);
+
+    std::vector<uint32_t> hole_texels(2 * MSDF_SIZE * MSDF_SIZE);
+    make_msdfs(holes, hole_texels, false);
+
+    double hole_pixels = MSDF_SIZE * MSDF_SIZE * MSDF_CHECK_SCALE * MSDF_CHECK_SCALE;
+    double hole_wrong = msdf_wrong_pixels(holes[0], hole_texels.data()) / hole_pixels;
+    double alone_wrong = msdf_wrong_pixels(holes[1], hole_texels.data() + MSDF_SIZE * MSDF_SIZE) / hole_pixels;
+
+    cout << "  a square with a square hole: " << 100 * hole_wrong << "% of pixels wrong; the hole on its own: "
+         << 100 * alone_wrong << "%" << endl;
+
+    if (hole_wrong > MSDF_HOLE_TOLERANCE || alone_wrong > MSDF_HOLE_TOLERANCE) {
+        cerr << "Error: Holes didn't come out as holes" << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * --ease; how fast libbezier works out where animations should be (see easing.cpp).
+ *
+ * Every animation uses one of CSS's standard easing curves, or a made-up one, and is at a random
+ * point in its time. Each 'frame' moves them all on a little and works out where they should be,
+ * then a solver which only ever halves the range of t (as simple easing code often does) does the
+ * same frames again for comparison, and says how far apart the answers are.
+ */
+const int EASE_FRAMES = 100;
+
+int run_easing(size_t count) {
+    std::vector<bz_easing> easings = {
+        bz_easing_make(0.25f, 0.1f, 0.25f, 1),      // ease
+        bz_easing_make(0.42f, 0, 1, 1),             // ease-in
+        bz_easing_make(0, 0, 0.58f, 1),             // ease-out
+        bz_easing_make(0.42f, 0, 0.58f, 1),         // ease-in-out
+        bz_easing_make(0, 0, 1, 1),                 // linear
+        bz_easing_make(0.68f, -0.6f, 0.32f, 1.6f),  // Overshooting at both ends
+        bz_easing_make(1, 0, 0, 1),                 // Nearly standing still in the middle
+    };
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(0, 1);
+
+    for (int i = 0; i < 25; ++i) {
+        easings.push_back(bz_easing_make(unit(random), unit(random) * 2 - 0.5f, unit(random), unit(random) * 2 - 0.5f));
+    }
+
+    std::vector<uint32_t> which(count);
+    std::vector<float> start(count), x(count), y(count), bisected(count);
+
+    for (size_t i = 0; i < count; ++i) {
+        which[i] = random() % easings.size();
+        start[i] = unit(random);
+    }
+
+    // Each frame, every animation moves on by 1/EASE_FRAMES of its time, going round to the start again
+    auto frame_times = [&](int frame) {
+        for (size_t i = 0; i < count; ++i) {
+            x[i] = start[i] + (float) frame / EASE_FRAMES;
+            x[i] -= x[i] >= 1 ? 1 : 0;
+        }
+    };
+
+    double seconds = 0;
+
+    for (int frame = 0; frame < EASE_FRAMES; ++frame) {
+        frame_times(frame);
+
+        std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+        bz_ease_batch(easings.data(), which.data(), x.data(), count, y.data());
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - frame_start).count();
+    }
+
+    double bisect_seconds = 0, difference = 0;
+
+    for (int frame = 0; frame < EASE_FRAMES; ++frame) {
+        frame_times(frame);
+
+        std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < count; ++i) {
+            const bz_easing& easing = easings[which[i]];
+            float low = 0, high = 1;
+
+            for (int step = 0; step < 24; ++step) {
+                float t = 0.5f * (low + high);
+                float curve_x = ((easing.x[2] * t + easing.x[1]) * t + easing.x[0]) * t;
+                (curve_x < x[i] ? low : high) = t;
+            }
+
+            float t = 0.5f * (low + high);
+            bisected[i] = ((easing.y[2] * t + easing.y[1]) * t + easing.y[0]) * t;
+        }
+
+        bisect_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - frame_start).count();
+
+        // The last frame's answers from bz_ease_batch are still in y
+        if (frame == EASE_FRAMES - 1) {
+            for (size_t i = 0; i < count; ++i) {
+                difference = std::max(difference, (double) std::fabs(y[i] - bisected[i]));
+            }
+        }
+    }
+
+    size_t evaluations = count * EASE_FRAMES;
+
+    cout << "Easing: " << count << " animations, " << easings.size() << " curves, " << EASE_FRAMES << " frames" << endl;
+    cout << "  " << evaluations / seconds << " animations/sec (" << seconds / EASE_FRAMES * 1000 << " ms/frame)" << endl;
+    cout << "  only halving: " << evaluations / bisect_seconds << " animations/sec ("
+         << bisect_seconds / EASE_FRAMES * 1000 << " ms/frame), answers up to " << difference << " apart" << endl;
+    return 0;
+}
+
+/*
+ * The same moments as bz_path_moments, for a closed polygon; the usual 'shoelace' sums,
+ * where each edge adds the triangle between it and 0,0. Only used to compare with.
+ */
+static bz_moments polygon_moments(const Point *points, size_t count) {
+    bz_moments m = {};
+
+    for (size_t i = 0; i < count; ++i) {
+        double x0 = points[i].x, y0 = points[i].y;
+        double x1 = points[(i + 1) % count].x, y1 = points[(i + 1) % count].y;
+        double cross = x0 * y1 - x1 * y0;
+
+        m.area += cross / 2;
+        m.x += (x0 + x1) * cross / 6;
+        m.y += (y0 + y1) * cross / 6;
+        m.xx += (x0 * x0 + x0 * x1 + x1 * x1) * cross / 12;
+        m.yy += (y0 * y0 + y0 * y1 + y1 * y1) * cross / 12;
+        m.xy += (x0 * y1 + 2 * x0 * y0 + 2 * x1 * y1 + x1 * y0) * cross / 24;
+    }
+
+    return m;
+}
+
+
+/*
+ * --moments; the total area of the scene's shapes, where their middle is and how spread out
+ * they are, worked out exactly by libbezier (see moments.cpp), and how long that takes compared
+ * with tessellating each curve into 'steps' lines first.
+ *
+ * Each curve is a shape on its own, closed by the straight line between its ends, as --raster fill
+ * draws it. The curves are shared out between a thread on every CPU; each thread adds up its own
+ * part, and then the parts are added together.
+ */
+const size_t MOMENTS_BATCH = 4096;      // Curves tessellated at once for the comparison
+
+int run_moments(Scene& scene, int steps) {
+    size_t curve_count = scene.curves.size();
+    std::vector<bz_moments> moments(curve_count);
+
+    // Each thread's part of the sums (any left over stay at 0)
+    std::vector<bz_moments> exact_parts(cpu_count()), polygon_parts(cpu_count());
+
+    // Exactly
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    size_t threads = on_every_cpu(curve_count, [&scene, &moments, &exact_parts](size_t part, size_t first, size_t batch) {
+        TRACE_SCOPE("moments");
+
+        // One curve in each path, counting from the first curve in the batch
+        std::vector<size_t> path_ends(batch);
+
+        for (size_t i = 0; i < batch; ++i) {
+            path_ends[i] = i + 1;
+        }
+
+        bz_path_moments(scene.curves.data() + first, path_ends.data(), batch, moments.data() + first);
+        exact_parts[part] = bz_moments_sum(moments.data() + first, batch);
+    });
+
+    bz_moments exact = bz_moments_sum(exact_parts.data(), exact_parts.size());
+    double exact_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // From polygons, one batch of curves at a time
+    start = std::chrono::steady_clock::now();
+
+    on_every_cpu(curve_count, [&scene, &polygon_parts, steps](size_t part, size_t first, size_t batch) {
+        TRACE_SCOPE("polygon moments");
+        std::vector<Point> points(bz_tessellation_size(MOMENTS_BATCH, steps));
+        std::vector<bz_moments> parts;
+
+        for (size_t done = 0; done < batch; done += MOMENTS_BATCH) {
+            size_t count = std::min(MOMENTS_BATCH, batch - done);
+            bz_tessellate(scene.curves.data() + first + done, count, steps, points.data());
+
+            for (size_t i = 0; i < count; ++i) {
+                parts.push_back(polygon_moments(points.data() + i * (steps + 1), steps + 1));
+            }
+        }
+
+        polygon_parts[part] = bz_moments_sum(parts.data(), parts.size());
+    });
+
+    bz_moments polygon = bz_moments_sum(polygon_parts.data(), polygon_parts.size());
+    double polygon_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // The same shapes all going the same way round, to see how much the polygons miss in total
+    double total_area = 0, area_error = 0;
+
+    for (size_t i = 0; i < curve_count; ++i) {
+        total_area += std::fabs(moments[i].area);
+    }
+
+    for (size_t first = 0; first < curve_count; first += MOMENTS_BATCH) {
+        size_t count = std::min(MOMENTS_BATCH, curve_count - first);
+        std::vector<Point> points(bz_tessellation_size(count, steps));
+        bz_tessellate(scene.curves.data() + first, count, steps, points.data());
+
+        for (size_t i = 0; i < count; ++i) {
+            area_error += std::fabs(polygon_moments(points.data() + i * (steps + 1), steps + 1).area - moments[first + i].area);
+        }
+    }
+
+    double cx = exact.x / exact.area, cy = exact.y / exact.area;
+
+    cout << "Moments: " << curve_count << " shapes on " << threads << " threads" << endl;
+    cout << "  area " << exact.area << " (" << total_area << " ignoring which way round each shape goes)" << endl;
+    cout << "  centroid " << cx << ", " << cy << "; second moments about it xx " << exact.xx - exact.area * cx * cx
+         << ", xy " << exact.xy - exact.area * cx * cy << ", yy " << exact.yy - exact.area * cy * cy << endl;
+    cout << "  exact: " << curve_count / exact_seconds << " shapes/sec" << endl;
+    cout << "  from " << steps << "-line polygons: " << curve_count / polygon_seconds << " shapes/sec, "
+         << "area " << polygon.area << ", centroid " << polygon.x / polygon.area << ", " << polygon.y / polygon.area
+         << "; " << 100 * area_error / std::max(total_area, 1e-300) << "% of the area missed or added" << endl;
+    return 0;
+}
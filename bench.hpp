@@ -0,0 +1,30 @@
+/*
+ * Benchmarks of libbezier's own functions, apart from drawing, for main's command line options.
+ * Each one times the library against the scene (or against made-up data, where the scene has
+ * nothing to offer), and where there is a simpler way to get the same answers, times that too
+ * and says how far apart the answers are. The results go to standard output.
+ *
+ * The work is shared out between a thread on every CPU, as a program using libbezier would.
+ * Drawing is benchmarked by --bench, in main.cpp, since it shares its drawing code with the windows.
+ */
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <cstddef>
+
+#include "scene.hpp"
+
+
+/*
+ * Each returns 0, as main does when it has finished, or 1 if it finds libbezier gave wrong answers.
+ * Where curves are turned into lines for comparison, 'steps' is how many lines each one becomes.
+ */
+int run_rays(Scene& scene, size_t count);
+int run_inside(Scene& scene, size_t count);
+int run_collide(Scene& scene, size_t count, int steps);
+int run_msdf(Scene& scene, size_t count);
+int run_easing(size_t count);
+int run_moments(Scene& scene, int steps);
+
+#endif
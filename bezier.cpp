@@ -0,0 +1,31 @@
+/*
+ * libbezier; evaluating and tessellating curves in batches.
+ */
+
+#include "bezier.hpp"
+
+
+int bz_api_version(void) {
+    return BZ_API_VERSION;
+}
+
+
+void bz_evaluate(const bz_curve *curves, size_t count, const float *t, size_t t_count, bz_point *out) {
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < t_count; ++j) {
+            out[i * t_count + j] = evaluate_curve(curves[i], t[j]);
+        }
+    }
+}
+
+
+size_t bz_tessellation_size(size_t count, int steps) {
+    return count * (steps + 1);
+}
+
+
+void bz_tessellate(const bz_curve *curves, size_t count, int steps, bz_point *out) {
+    for (size_t i = 0; i < count; ++i) {
+        tessellate_curve(curves[i], steps, out + i * (steps + 1));
+    }
+}
@@ -0,0 +1,475 @@
+/*
+ * libbezier - the curve maths from this program, as a library.
+ *
+ * This is a plain C interface, so it can be used from C, C++ or anything else
+ * which can call C functions.
+ *
+ * None of these functions allocate any memory. The caller always provides the
+ * buffers to read from and write to, and can find out how big they need to be
+ * beforehand, which makes them safe to call from code where speed matters.
+ *
+ * Link with libbezier.a, or libbezier.so to share one copy between programs.
+ */
+
+#ifndef BEZIER_H
+#define BEZIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*
+ * Changes whenever anything in this file changes in a way that could break existing callers.
+ */
+#define BZ_API_VERSION 12
+
+
+/*
+ * Data type to represent a position on the screen.
+ * To make this easier to think about, in this program, we take x and y to be between 0 and 1.
+ * 0,0 is the upper-left of the window and 1,1 is the lower-right.
+ */
+typedef struct {
+    float x;
+    float y;
+} bz_point;
+
+
+/*
+ * A curve.
+ * Quadratic curves use the first 3 control points, and cubic curves use all 4.
+ */
+typedef struct {
+    int degree;         /* 2 for a quadratic curve, 3 for a cubic curve */
+    bz_point p[4];
+    uint8_t r, g, b;    /* The colour to draw the curve in */
+} bz_curve;
+
+
+/*
+ * Somewhere to draw pixels; a block of memory which belongs to the caller.
+ * Each pixel is 0xAARRGGBB (the same as SDL_PIXELFORMAT_ARGB8888).
+ * pitch is the number of pixels from the start of one row to the start of the next.
+ */
+typedef struct {
+    uint32_t *pixels;
+    int width;
+    int height;
+    int pitch;
+} bz_canvas;
+
+
+/*
+ * A canvas kept in square tiles of BZ_TILE_SIZE by BZ_TILE_SIZE pixels, one tile after another,
+ * rather than in rows. Lines going in any direction stay within a few KB of memory, which is
+ * much kinder to the CPU's caches on big canvases. Use bz_tiled_canvas_copy to turn it back into rows.
+ *
+ * The memory belongs to the caller; bz_tiled_canvas_pixels says how many pixels it needs.
+ */
+#define BZ_TILE_SIZE 32
+
+typedef struct {
+    uint32_t *pixels;
+    int width;
+    int height;
+    int tiles_across;
+} bz_tiled_canvas;
+
+
+/*
+ * How positions on curves become pixels on a canvas:
+ *   pixel x = x * scale_x + offset_x
+ *   pixel y = y * scale_y + offset_y
+ */
+typedef struct {
+    float scale_x;
+    float scale_y;
+    float offset_x;
+    float offset_y;
+} bz_transform;
+
+
+/*
+ * The version of this file which the library was built with.
+ * Compare with BZ_API_VERSION to make sure a shared library matches.
+ */
+int bz_api_version(void);
+
+
+/*
+ * Find the points at some positions along each of a number of curves.
+ *
+ * t holds t_count positions, each between 0 (the start of a curve) and 1 (the end).
+ * out must have room for count * t_count points; the points for curve i
+ * are out[i * t_count] to out[i * t_count + t_count - 1].
+ */
+void bz_evaluate(const bz_curve *curves, size_t count, const float *t, size_t t_count, bz_point *out);
+
+
+/*
+ * The number of points written by bz_tessellate.
+ */
+size_t bz_tessellation_size(size_t count, int steps);
+
+
+/*
+ * Split each of a number of curves into 'steps' straight lines.
+ * Each curve writes steps + 1 points to out, one curve after another.
+ */
+void bz_tessellate(const bz_curve *curves, size_t count, int steps, bz_point *out);
+
+
+/*
+ * Fill the whole canvas with one colour.
+ */
+void bz_canvas_clear(bz_canvas *canvas, uint32_t colour);
+
+
+/*
+ * Draw the output of bz_tessellate onto a canvas, each curve in its own colour.
+ * Lines are 1 pixel wide; anything outside of the canvas is skipped.
+ * Several lines are drawn at once with SIMD instructions.
+ *
+ * Curves which fit inside a pixel are drawn as that pixel, and curves which are
+ * nearly straight are drawn as one line. Returns the number of lines drawn.
+ */
+size_t bz_rasterize(bz_canvas *canvas, const bz_transform *transform,
+                    const bz_curve *curves, size_t count, int steps, const bz_point *points);
+
+
+/*
+ * Tiled canvases; how many pixels of memory one needs, setting one up in that memory,
+ * filling it with one colour, drawing onto it (as bz_rasterize), and copying it into an ordinary canvas.
+ */
+size_t bz_tiled_canvas_pixels(int width, int height);
+bz_tiled_canvas bz_tiled_canvas_make(uint32_t *memory, int width, int height);
+void bz_tiled_canvas_clear(bz_tiled_canvas *canvas, uint32_t colour);
+size_t bz_tiled_rasterize(bz_tiled_canvas *canvas, const bz_transform *transform,
+                          const bz_curve *curves, size_t count, int steps, const bz_point *points);
+void bz_tiled_canvas_copy(const bz_tiled_canvas *tiled, bz_canvas *canvas);
+
+
+/*
+ * Draw a single line (in canvas pixels) in one colour.
+ */
+void bz_draw_line(bz_canvas *canvas, float x0, float y0, float x1, float y1, uint32_t colour);
+
+
+/*
+ * Draw a quadratic curve (in canvas pixels) directly, one pixel at a time, without
+ * splitting it into lines. The result is a gap-free, 8-connected approximation of the curve
+ * (each pixel touches the next along a side or at a corner); the control points are rounded
+ * to whole pixels first, so pixels can be up to 2 pixels from the exact curve, though most are
+ * within 1.
+ */
+void bz_draw_quadratic(bz_canvas *canvas, float x0, float y0, float x1, float y1, float x2, float y2, uint32_t colour);
+
+
+/*
+ * The same for a rational quadratic curve, whose middle control point has weight w.
+ * A weight of 1 is an ordinary quadratic curve; with p0, p1 and p2 at the corners of
+ * a square and w = sqrt(2) / 2, the curve is an exact quarter circle.
+ */
+void bz_draw_rational_quadratic(bz_canvas *canvas, float x0, float y0, float x1, float y1, float x2, float y2,
+                                float w, uint32_t colour);
+
+
+/*
+ * Fill a closed shape, made of the lines between count points and back from the last to the first,
+ * with smooth edges; each pixel gets as much of the colour as the shape covers of it.
+ *
+ * The rule says what is inside where the outline goes round the same place more than once:
+ * with BZ_FILL_NONZERO, anywhere it goes round at all; with BZ_FILL_EVEN_ODD, only where it goes
+ * round an odd number of times (so a shape inside another one, going the same way, is a hole).
+ *
+ * buffer must hold bz_fill_buffer_size(width, height) floats for the canvas, all zero;
+ * it is left all zero again afterwards, so the same buffer can be used for every shape.
+ * Shapes whose box has a lot of empty space (over 128x128 pixels of it) are drawn by
+ * bz_fill_polygon_scanline instead, when their edges take less memory than notes for the box.
+ *
+ * On a big canvas, a buffer that size can be more than is worth allocating. bz_fill_polygon_size
+ * gives the bytes a particular shape needs (without drawing it), after making the same choice, and
+ * a buffer which holds at least that much, all zero, will do instead. That is never more than
+ * bz_fill_buffer_size, and for shapes drawn a row at a time it is only about a row of pixels more
+ * than their edges.
+ */
+typedef enum {
+    BZ_FILL_NONZERO,
+    BZ_FILL_EVEN_ODD
+} bz_fill_rule;
+
+size_t bz_fill_buffer_size(int width, int height);
+size_t bz_fill_polygon_size(const bz_canvas *canvas, const bz_transform *transform, const bz_point *points, size_t count);
+void bz_fill_polygon(bz_canvas *canvas, float *buffer, const bz_transform *transform,
+                     const bz_point *points, size_t count, bz_fill_rule rule, uint32_t colour);
+
+
+/*
+ * The same, but a row at a time, keeping only the shape's edges and one row of pixels' worth of notes.
+ * It uses far less memory for big shapes on big canvases, and spends no time on empty space, but is
+ * anti-aliased less finely up and down (4 levels) than across.
+ *
+ * buffer must hold bz_scanline_buffer_size(width, count) bytes, of which the first
+ * (width + 2) floats must be zero; they are left zero again afterwards.
+ */
+size_t bz_scanline_buffer_size(int width, size_t count);
+void bz_fill_polygon_scanline(bz_canvas *canvas, void *buffer, const bz_transform *transform,
+                              const bz_point *points, size_t count, bz_fill_rule rule, uint32_t colour);
+
+
+/*
+ * Occlusion culling; finding opaque shapes which would be completely hidden behind shapes drawn after them.
+ *
+ * Go through the shapes in reverse, from the front to the back. For each one, bz_occlusion_hidden
+ * says whether it can be skipped; if not, bz_occlusion_add marks the parts of the canvas it covers.
+ * Then draw the shapes which weren't skipped in their usual order.
+ *
+ * The canvas is divided into tiles of BZ_OCCLUSION_TILE pixels square, with one byte each,
+ * which the caller provides; bz_occlusion_tiles says how many. bz_occlusion_add needs
+ * bz_occlusion_buffer_size(count) bytes of working space.
+ */
+#define BZ_OCCLUSION_TILE 8
+
+typedef struct {
+    uint8_t *tiles;
+    int tiles_across;
+    int tiles_down;
+} bz_occlusion;
+
+size_t bz_occlusion_tiles(int width, int height);
+bz_occlusion bz_occlusion_make(uint8_t *tiles, int width, int height);
+void bz_occlusion_clear(bz_occlusion *occlusion);
+size_t bz_occlusion_buffer_size(size_t count);
+int bz_occlusion_hidden(const bz_occlusion *occlusion, const bz_transform *transform,
+                        const bz_point *points, size_t count);
+void bz_occlusion_add(bz_occlusion *occlusion, void *buffer, const bz_transform *transform,
+                      const bz_point *points, size_t count, bz_fill_rule rule);
+
+
+/*
+ * Draw curves onto a canvas without tessellating them first.
+ * Quadratic curves are drawn directly (as bz_draw_quadratic); cubic curves are
+ * still drawn as cubic_steps lines each (or one, as in bz_rasterize), but without
+ * needing a buffer for the points. Returns the number of lines drawn for the cubic curves.
+ */
+size_t bz_rasterize_direct(bz_canvas *canvas, const bz_transform *transform,
+                           const bz_curve *curves, size_t count, int cubic_steps);
+
+
+/*
+ * Where straight lines cross curves.
+ *
+ * A ray starts at 'origin' and goes in 'direction'; the point 'distance' along it is
+ * origin + distance * direction, and only crossings with distance from 0 to max_distance count.
+ * For a line from a to b, use origin a, direction b - a and max_distance 1; for a ray which
+ * goes on forever, use INFINITY.
+ *
+ * The curves are first put into a 'bounding volume hierarchy' of boxes inside boxes, so that each
+ * ray only needs to look at the few curves near it. bz_bvh_build needs room for bz_bvh_nodes(count)
+ * nodes and count numbers in 'order'; the curves must stay where they are while the BVH is used.
+ *
+ * bz_intersect_rays finds the nearest crossing along each of many rays, or BZ_NO_HIT.
+ * bz_intersect_ray_all finds the crossings along one ray, nearest first, and returns how many it
+ * wrote. If there are more than max_hits, it writes the nearest max_hits (and, to save time, doesn't
+ * look for the rest), so a result of max_hits means there may be more further along.
+ * Places where a curve only touches the line without crossing it are not counted.
+ */
+#define BZ_BVH_LEAF_SIZE 4
+#define BZ_NO_HIT 0xffffffffu
+
+typedef struct {
+    bz_point origin;
+    bz_point direction;
+    float max_distance;
+} bz_ray;
+
+typedef struct {
+    float distance;     /* How far along the ray */
+    float t;            /* Where on the curve, from 0 at its start to 1 at its end */
+    uint32_t curve;     /* Which curve, or BZ_NO_HIT */
+} bz_hit;
+
+typedef struct {
+    float min_x, min_y, max_x, max_y;
+    uint32_t first;     /* The first of a box's two halves in 'nodes', or its first curve in 'order' at the bottom */
+    uint32_t count;     /* How many curves are in a box at the bottom of the tree; 0 for the others */
+} bz_bvh_node;
+
+typedef struct {
+    bz_bvh_node *nodes;
+    uint32_t *order;    /* Curve numbers, with each bottom box's curves together */
+    size_t node_count;
+    const bz_curve *curves;
+} bz_bvh;
+
+size_t bz_bvh_nodes(size_t count);
+bz_bvh bz_bvh_build(const bz_curve *curves, size_t count, bz_bvh_node *nodes, uint32_t *order);
+void bz_intersect_rays(const bz_bvh *bvh, const bz_ray *rays, size_t count, bz_hit *hits);
+size_t bz_intersect_ray_all(const bz_bvh *bvh, const bz_ray *ray, bz_hit *hits, size_t max_hits);
+
+
+/*
+ * The area of shapes made of curves, worked out exactly from the control points.
+ *
+ * A path is one or more curves, one after another; path i is made of the curves from
+ * path_ends[i - 1] (or 0 for the first path) up to just before path_ends[i]. Each path is
+ * closed with a straight line from the end of its last curve back to the start of its first
+ * (so a single curve on its own makes a path closed by its chord, as with RASTER_FILL), and
+ * any other curves which don't quite meet are joined the same way.
+ *
+ * The area is positive for paths which go clockwise on the screen (with y going down) and
+ * negative for ones which go anticlockwise, so holes can be made by going round the other way.
+ * The centroid (the middle of the shape) is at (x / area, y / area), and the second moments
+ * about the centroid are xx - area * cx^2, yy - area * cy^2 and xy - area * cx * cy.
+ *
+ * All of the moments add up: the moments of several shapes together are the sum of theirs,
+ * so big sums can be split into parts (on different threads, say) and the parts added up with
+ * bz_moments_sum, which adds them in pairs to keep rounding errors small.
+ */
+typedef struct {
+    double area;
+    double x, y;            /* The integrals of x and y over the shape */
+    double xx, xy, yy;      /* The integrals of x * x, x * y and y * y over the shape */
+} bz_moments;
+
+void bz_path_moments(const bz_curve *curves, const size_t *path_ends, size_t path_count, bz_moments *out);
+bz_moments bz_moments_sum(const bz_moments *moments, size_t count);
+
+
+/*
+ * Whether points are inside paths (see bz_path_moments for how paths are given, and closed).
+ *
+ * bz_winding_numbers finds how many times the paths go round each point; +1 for each time
+ * clockwise (on the screen) and -1 for each time anticlockwise, added up over all of the paths.
+ * bz_points_inside sets inside[i] to 1 for the points which are inside by the fill rule, and 0
+ * for the others. To tell which of several separate shapes a point is in, give each one a grid.
+ *
+ * The paths are first covered in a grid of tiles, each knowing which parts of the curves pass
+ * through it, so that each point only needs to look at the curves near it. The grid needs
+ * bz_winding_grid_size bytes of memory (aligned for floats) from the caller, and the
+ * curves can be moved or changed once it has been built.
+ */
+typedef struct {
+    float min_x, min_y;             /* The top-left corner of the grid */
+    float tile_width, tile_height;
+    int columns, rows;
+    size_t piece_count;             /* How many parts the curves were cut into */
+    size_t entry_count;             /* How many parts there are in all of the tiles together */
+    void *memory;
+} bz_winding_grid;
+
+size_t bz_winding_grid_size(const bz_curve *curves, const size_t *path_ends, size_t path_count);
+bz_winding_grid bz_winding_grid_build(const bz_curve *curves, const size_t *path_ends, size_t path_count, void *memory);
+void bz_winding_numbers(const bz_winding_grid *grid, const bz_point *points, size_t count, int32_t *winding);
+void bz_points_inside(const bz_winding_grid *grid, const bz_point *points, size_t count, bz_fill_rule rule, uint8_t *inside);
+
+
+/*
+ * Easing curves; how fast an animation moves, as in CSS's cubic-bezier(x1, y1, x2, y2).
+ *
+ * The curve goes from 0,0 to 1,1, with x1,y1 and x2,y2 as its middle control points. x is how much
+ * of the animation's time has gone (from 0 to 1), and bz_ease says how far along it should be by
+ * then; usually from 0 to 1 as well, although y1 and y2 can be outside that, to overshoot.
+ * x1 and x2 have to be between 0 and 1, and are moved there if not.
+ *
+ * bz_easing_make works out everything about a curve which doesn't depend on x, once, including
+ * a small table which gives each bz_ease a good place to start from. bz_ease_batch finds y for
+ * count animations at once; animation i uses easings[which[i]], or easings[i] if which is NULL.
+ */
+#define BZ_EASING_SAMPLES 11
+
+typedef struct {
+    float x[3], y[3];                       /* x = ((x[2] t + x[1]) t + x[0]) t, and the same for y */
+    float samples[BZ_EASING_SAMPLES];       /* x at t = 0, 0.1, 0.2, ... 1 */
+    int linear;                             /* Whether y is always just x */
+} bz_easing;
+
+bz_easing bz_easing_make(float x1, float y1, float x2, float y2);
+float bz_ease(const bz_easing *easing, float x);
+void bz_ease_batch(const bz_easing *easings, const uint32_t *which, const float *x, size_t count, float *y);
+
+
+/*
+ * When moving circles first touch curves; for physics, where bodies move a step at a time and
+ * must not pass through the ground or walls between steps, however fast they go.
+ *
+ * Each circle's middle moves in a straight line from 'position' to position + move (usually its
+ * velocity times the length of the step). bz_collide_circles finds, for each circle, the first
+ * curve it touches on the way: 'time' is how far through the move that happens, from 0 to 1, and
+ * 'normal' is a unit vector straight out from the curve, towards the middle of the circle, at
+ * that moment. A circle which doesn't touch anything gets time 1 and curve BZ_NO_HIT, so moving
+ * each circle by time * move is always safe. One which already overlaps a curve gets time 0.
+ * Curves are touched to within about 1e-5 scene units.
+ *
+ * The curves are first put into a grid of tiles, so that each circle only needs to look at the
+ * curves near its move. bz_collision_grid_build needs bz_collision_grid_size bytes of memory
+ * (aligned for floats) from the caller, and the curves must stay where they are while the grid
+ * is used.
+ */
+typedef struct {
+    bz_point position;      /* Where the middle of the circle starts */
+    bz_point move;          /* How far it moves */
+    float radius;
+} bz_circle;
+
+typedef struct {
+    float time;             /* How far through the move the circle first touches a curve, from 0 to 1 */
+    float t;                /* Where on the curve, from 0 at its start to 1 at its end */
+    bz_point normal;        /* Straight out from the curve, towards the middle of the circle */
+    uint32_t curve;         /* Which curve, or BZ_NO_HIT */
+} bz_contact;
+
+typedef struct {
+    float min_x, min_y;             /* The top-left corner of the grid */
+    float tile_width, tile_height;
+    int columns, rows;
+    size_t curve_count;
+    size_t entry_count;             /* How many curves there are in all of the tiles together */
+    const bz_curve *curves;
+    void *memory;
+} bz_collision_grid;
+
+size_t bz_collision_grid_size(const bz_curve *curves, size_t count);
+bz_collision_grid bz_collision_grid_build(const bz_curve *curves, size_t count, void *memory);
+void bz_collide_circles(const bz_collision_grid *grid, const bz_circle *circles, size_t count, bz_contact *contacts);
+
+/*
+ * Multi-channel signed distance fields (MSDFs); small textures from which a shape can be drawn
+ * sharply at any size, with a single texture lookup per pixel, by keeping wherever the median of
+ * the red, green and blue channels is over half (over 127, in the canvas). Unlike a plain signed
+ * distance field, the corners stay sharp too.
+ *
+ * The shape is made of closed paths, given as for bz_path_moments, with clockwise paths (on the
+ * screen) filled and anticlockwise ones making holes. Unlike bz_path_moments, nothing joins up gaps:
+ * every curve has to start where the one before it ends, and the last curve of each path where its
+ * first one starts (add a straight curve to close a path that doesn't). First bz_msdf_colour_edges
+ * picks which of the channels see each curve (1 for red, 2 for green and 4 for blue, added up),
+ * making sure that the curves either side of every corner share only one channel. corner_angle is
+ * the widest angle between two curves, measured inside the corner (pi being straight on), that
+ * still counts as a corner, as in msdfgen; 3 is usual, making any turn of more than about 8 degrees
+ * a corner. (Below pi/2, only turns of 90 degrees or more count.)
+ *
+ * bz_msdf_rows then fills in row_count rows of the canvas, starting at first_row, each texel being
+ * where 'transform' puts it. Different rows (and different shapes) can be done on different threads
+ * at once. 'range' is how many pixels either side of the outline the distances go out to; 0 and 255
+ * are that far outside and inside. If 'grid' isn't NULL, it should be a bz_winding_grid for the same
+ * paths, and is used to make sure that texels end up on the right side where paths overlap or go
+ * the wrong way round. Once every row is done, bz_msdf_correct finds texels where blending with
+ * their neighbours would leave specks, and makes all three channels the same there.
+ */
+void bz_msdf_colour_edges(const bz_curve *curves, const size_t *path_ends, size_t path_count, float corner_angle,
+                          uint8_t *colours);
+void bz_msdf_rows(bz_canvas *canvas, const bz_transform *transform, float range,
+                  const bz_curve *curves, const uint8_t *colours, size_t count,
+                  const bz_winding_grid *grid, int first_row, int row_count);
+void bz_msdf_correct(bz_canvas *canvas, float range);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
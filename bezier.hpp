@@ -0,0 +1,235 @@
+/*
+ * The curve maths behind libbezier, for C++ code.
+ *
+ * Everything here is 'constexpr', which means that the compiler can run it
+ * while it is building the program if the curves are known in advance
+ * (see tessellate_static at the bottom).
+ *
+ * C code (and anything else) should use bezier.h instead.
+ */
+
+#ifndef BEZIER_HPP
+#define BEZIER_HPP
+
+#include <array>
+
+#include "bezier.h"
+
+
+typedef bz_point Point;
+typedef bz_curve Curve;
+
+
+/*
+ * Linear interpolation between two points.
+ * When interp is 0, the result is the first point, p0.
+ * When interp is 1, the result is the first point, p1.
+ * As interp moves from 0 to 1, the result moves smoothly from p0 to p1.
+ * If interp is 0.8, the result is 80% of the way from p0 to p1.
+ */
+constexpr Point lerp(float interp, const Point &p0, const Point &p1) {
+    return Point{(1 - interp) * p0.x + interp * p1.x,
+                 (1 - interp) * p0.y + interp * p1.y};
+}
+
+
+/*
+ * Work out the points along a quadratic Bezier curve based on 3 control points.
+ * The curve is split into 'steps' straight lines, so steps + 1 points are written to out.
+ */
+constexpr void tessellate_quadratic(const Point& p0, const Point& p1, const Point& p2, int steps, Point *out) {
+    // (These start out as zero only because the compiler insists on it
+    // when it runs this function itself; see tessellate_static below.)
+    Point p0_p1_interp = {};
+    Point p1_p2_interp = {};
+
+    // We already know that the curve will start at p0.
+    out[0] = p0;
+
+    // Loop through the number of line segments which we need to draw
+    for (int i = 1; i <= steps; ++i) {
+        // Work out our interpolation value for this line segment.
+        // It will be between 0 and 1.
+        float interp = (float) i / steps;
+
+        // Interpolate between p0 and p1.
+        p0_p1_interp = lerp(interp, p0, p1);
+
+        // Interpolate between p1 and p2 by the same amount again.
+        p1_p2_interp = lerp(interp, p1, p2);
+
+        // Now interpolate between the two points we just calculated,
+        // again by the same amount.
+        // This will give us the next point in our curve.
+        // The line segment we draw later runs from the previous point to this one.
+        out[i] = lerp(interp, p0_p1_interp, p1_p2_interp);
+    }
+}
+
+
+/*
+ * Work out the points along a cubic Bezier curve based on 4 control points.
+ * The curve is split into 'steps' straight lines, so steps + 1 points are written to out.
+ */
+constexpr void tessellate_cubic(const Point& p0, const Point& p1, const Point& p2, const Point& p3, int steps, Point *out) {
+    Point p0_p1_interp = {};
+    Point p1_p2_interp = {};
+    Point p2_p3_interp = {};
+
+    Point p0p1_p1p2_interp = {};
+    Point p1p2_p2p3_interp = {};
+
+    // We already know that the curve will start at p0.
+    out[0] = p0;
+
+    // Loop through the number of line segments which we need to draw
+    for (int i = 1; i <= steps; ++i) {
+        // Work out our interpolation value for this line segment.
+        // It will be between 0 and 1.
+        float interp = (float) i / steps;
+
+        // In the quadratic curve, we interpolated between two pairs of points;
+        // p0 and p1, and then p1 and p2.
+        // For a cubic curve, we interpolate between three pairs;
+        // p0 and p1, p1 and p2, and finally p2 and p3.
+        p0_p1_interp = lerp(interp, p0, p1);
+        p1_p2_interp = lerp(interp, p1, p2);
+        p2_p3_interp = lerp(interp, p2, p3);
+
+        // Next, we interpolate each pair of values which we just computed,
+        // again using the same interpolation vaule.
+        p0p1_p1p2_interp = lerp(interp, p0_p1_interp, p1_p2_interp);
+        p1p2_p2p3_interp = lerp(interp, p1_p2_interp, p2_p3_interp);
+
+        // We perform one final interpolation on the previous two points to get
+        // our next position in the curve, with the same interpolation again.
+        //
+        // Note that all we have done differently from the quadratic curve
+        // is to use 3 'layers' of interpolation instead of 2.
+        //
+        // We needed 4 control points instead of 3 in order to have enough
+        // data to perform this many interpolations.
+        out[i] = lerp(interp, p0p1_p1p2_interp, p1p2_p2p3_interp);
+    }
+}
+
+
+/*
+ * Work out the points along any curve.
+ */
+constexpr void tessellate_curve(const Curve& curve, int steps, Point *out) {
+    if (curve.degree == 2) {
+        tessellate_quadratic(curve.p[0], curve.p[1], curve.p[2], steps, out);
+    } else {
+        tessellate_cubic(curve.p[0], curve.p[1], curve.p[2], curve.p[3], steps, out);
+    }
+}
+
+
+/*
+ * Work out a single point along a curve.
+ * This is the same as one step of the loops above, for any interpolation value.
+ */
+constexpr Point evaluate_curve(const Curve& curve, float interp) {
+    Point p0_p1_interp = lerp(interp, curve.p[0], curve.p[1]);
+    Point p1_p2_interp = lerp(interp, curve.p[1], curve.p[2]);
+
+    if (curve.degree == 2) {
+        return lerp(interp, p0_p1_interp, p1_p2_interp);
+    }
+
+    Point p2_p3_interp = lerp(interp, curve.p[2], curve.p[3]);
+
+    return lerp(interp, lerp(interp, p0_p1_interp, p1_p2_interp),
+                        lerp(interp, p1_p2_interp, p2_p3_interp));
+}
+
+
+/*
+ * How much of a curve is worth drawing, once 'transform' has put it on a canvas.
+ *
+ * Zoomed out, most curves are tiny, and drawing every one of their line segments
+ * just draws the same pixel over and over. A curve always stays within the shape
+ * made by its control points, so if the control points all fit in one pixel, so does
+ * the curve, and if they are all close to the straight line between its ends (and alongside it,
+ * not off past either end), so is the curve.
+ */
+enum CurveDetail {
+    DETAIL_POINT,       // The whole curve is inside one pixel
+    DETAIL_LINE,        // The curve is never more than 'tolerance' pixels from the line between its ends
+    DETAIL_FULL         // The curve needs all of its line segments
+};
+
+
+/*
+ * How far (in pixels) a curve drawn as a single line can be from where it should be;
+ * less than the width of the line itself.
+ */
+constexpr float COLLAPSE_TOLERANCE = 0.5f;
+
+constexpr CurveDetail curve_detail(const Curve& curve, const bz_transform& transform, float tolerance) {
+    float x[4] = {};
+    float y[4] = {};
+    float min_x = 0, min_y = 0, max_x = 0, max_y = 0;
+
+    for (int i = 0; i <= curve.degree; ++i) {
+        x[i] = curve.p[i].x * transform.scale_x + transform.offset_x;
+        y[i] = curve.p[i].y * transform.scale_y + transform.offset_y;
+
+        min_x = (i == 0 || x[i] < min_x) ? x[i] : min_x;
+        max_x = (i == 0 || x[i] > max_x) ? x[i] : max_x;
+        min_y = (i == 0 || y[i] < min_y) ? y[i] : min_y;
+        max_y = (i == 0 || y[i] > max_y) ? y[i] : max_y;
+    }
+
+    if (max_x - min_x < 1 && max_y - min_y < 1) {
+        return DETAIL_POINT;
+    }
+
+    // How far each middle control point is from the line between the ends. The 'cross product'
+    // of the line with the way to the control point is that distance times the line's length,
+    // so compare squares to save working out square roots. The 'dot product' is how far along
+    // the line the control point is (times its length again), which has to be between the ends:
+    // a curve whose control points are close to the line but beyond an end goes past that end.
+    int end = curve.degree;
+    float line_x = x[end] - x[0];
+    float line_y = y[end] - y[0];
+    float length_squared = line_x * line_x + line_y * line_y;
+
+    for (int i = 1; i < end; ++i) {
+        float to_x = x[i] - x[0];
+        float to_y = y[i] - y[0];
+        float cross = line_x * to_y - line_y * to_x;
+        float along = line_x * to_x + line_y * to_y;
+
+        // (If the ends are in the same place, it's the distance from them instead)
+        float distance_squared = length_squared > 0 ? cross * cross / length_squared : to_x * to_x + to_y * to_y;
+
+        if (distance_squared > tolerance * tolerance || along < 0 || along > length_squared) {
+            return DETAIL_FULL;
+        }
+    }
+
+    return DETAIL_LINE;
+}
+
+
+/*
+ * Tessellation done by the compiler.
+ *
+ * Everything that tessellate_curve needs is known before the program even runs
+ * when the control points are constants, like the two curves at the top of main.cpp.
+ * Because the functions above are 'constexpr', the compiler can run them itself
+ * and store the finished points inside the program, so they never need to be
+ * worked out again while it is running.
+ *
+ * STEPS_ is the number of line segments (it has to be a constant too).
+ */
+template <int STEPS_>
+constexpr std::array<Point, STEPS_ + 1> tessellate_static(const Curve& curve) {
+    std::array<Point, STEPS_ + 1> points = {};
+    tessellate_curve(curve, STEPS_, points.data());
+    return points;
+}
+
+#endif
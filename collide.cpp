@@ -0,0 +1,685 @@
+/*
+ * libbezier; when moving circles first touch curves, for physics with curved ground and walls.
+ *
+ * A circle moving in a straight line touches a curve at the first moment its middle comes within
+ * its radius of the curve. Going in small steps and checking each one can step right over thin
+ * curves ('tunnelling'), so instead we find that moment directly.
+ *
+ * That is easy against a straight line: the middle of the circle is moving along a ray, and it
+ * touches the line when the ray reaches the 'capsule' around the line (the line made fatter by the
+ * radius, with round ends). So each curve is cut in half, and in half again (as de Casteljau does),
+ * until the pieces are close enough to straight. Most of the pieces are never looked at, though.
+ * A piece never goes further from the line between its ends than its control points do, so the
+ * circle can't touch it before it would touch that line if its radius were that much bigger; the
+ * pieces are only cut up further if that could happen before the earliest touch found so far,
+ * soonest pieces first. This is 'conservative advancement'; each of those times is never later than
+ * the circle actually touches the piece, so nothing is ever missed.
+ *
+ * To avoid looking at every curve for every circle, the boxes around the curves' control points are
+ * put into a grid of tiles, and each circle only looks at the curves in the tiles along its move.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "bezier.hpp"
+
+
+/*
+ * How close to straight a piece of a curve has to be before it is treated as a straight line;
+ * the most its control points are from the line between its ends, in scene units. The curve never
+ * leaves its control points, so circles touch it at most this far from where they should.
+ * Each halving makes a piece about 4 times straighter, so MAX_SPLIT_DEPTH is plenty for any curve.
+ */
+const float FLAT_TOLERANCE = 1e-5f;
+const int MAX_SPLIT_DEPTH = 16;
+
+
+/*
+ * About how many curves each tile has, on average; as in winding.cpp, big curves are in lots of
+ * tiles, so there are fewer, bigger tiles when the curves would otherwise be in more than
+ * MAX_TILES_PER_CURVE tiles each, on average.
+ */
+const double CURVES_PER_TILE = 2;
+const double MAX_TILES_PER_CURVE = 8;
+const int MAX_GRID_SIZE = 4096;
+
+
+typedef struct {
+    float min_x, min_y, max_x, max_y;
+} Box;
+
+
+/*
+ * Where everything goes in the caller's memory.
+ */
+typedef struct {
+    Box *boxes;             // The box around each curve's control points
+    uint32_t *tile_first;   // Each tile's first entry, with one more at the end
+    uint32_t *entries;      // The curves in each tile
+} GridMemory;
+
+
+static GridMemory grid_memory(const bz_collision_grid& grid) {
+    GridMemory memory;
+    size_t tiles = (size_t) grid.columns * grid.rows;
+
+    memory.boxes = (Box *) grid.memory;
+    memory.tile_first = (uint32_t *) (memory.boxes + grid.curve_count);
+    memory.entries = memory.tile_first + tiles + 1;
+    return memory;
+}
+
+
+/*
+ * A curve's x and y as polynomials in t, c[0] + c[1] t + c[2] t^2 + c[3] t^3; the same sums as in moments.cpp.
+ */
+static void coefficients(const bz_curve& curve, float *cx, float *cy) {
+    const bz_point *p = curve.p;
+
+    cx[0] = p[0].x;
+    cy[0] = p[0].y;
+
+    if (curve.degree == 2) {
+        cx[1] = 2 * (p[1].x - p[0].x);
+        cy[1] = 2 * (p[1].y - p[0].y);
+        cx[2] = p[2].x - 2 * p[1].x + p[0].x;
+        cy[2] = p[2].y - 2 * p[1].y + p[0].y;
+        cx[3] = cy[3] = 0;
+    } else {
+        cx[1] = 3 * (p[1].x - p[0].x);
+        cy[1] = 3 * (p[1].y - p[0].y);
+        cx[2] = 3 * (p[2].x - 2 * p[1].x + p[0].x);
+        cy[2] = 3 * (p[2].y - 2 * p[1].y + p[0].y);
+        cx[3] = p[3].x - 3 * p[2].x + 3 * p[1].x - p[0].x;
+        cy[3] = p[3].y - 3 * p[2].y + 3 * p[1].y - p[0].y;
+    }
+}
+
+
+static Box control_box(const bz_point *p, int degree) {
+    Box box = {p[0].x, p[0].y, p[0].x, p[0].y};
+
+    for (int i = 1; i <= degree; ++i) {
+        box.min_x = std::min(box.min_x, p[i].x);
+        box.min_y = std::min(box.min_y, p[i].y);
+        box.max_x = std::max(box.max_x, p[i].x);
+        box.max_y = std::max(box.max_y, p[i].y);
+    }
+
+    return box;
+}
+
+
+static inline int column_at(const bz_collision_grid& grid, float x) {
+    return std::min(std::max((int) std::floor((x - grid.min_x) / grid.tile_width), 0), grid.columns - 1);
+}
+
+
+static inline int row_at(const bz_collision_grid& grid, float y) {
+    return std::min(std::max((int) std::floor((y - grid.min_y) / grid.tile_height), 0), grid.rows - 1);
+}
+
+
+/*
+ * How many tiles a box covers.
+ */
+static inline size_t tiles_covered(const bz_collision_grid& grid, const Box& box) {
+    return (size_t) (column_at(grid, box.max_x) - column_at(grid, box.min_x) + 1)
+         * (size_t) (row_at(grid, box.max_y) - row_at(grid, box.min_y) + 1);
+}
+
+
+/*
+ * Everything about the grid except where it goes in memory; the same for bz_collision_grid_size
+ * and bz_collision_grid_build, so that they always agree.
+ *
+ * The grid starts with enough tiles for about CURVES_PER_TILE curves each, in the shape of the box
+ * around all of the curves, and has half as many tiles each time the curves would be in too many.
+ */
+static bz_collision_grid plan_grid(const bz_curve *curves, size_t count) {
+    bz_collision_grid grid = {};
+    float max_x = -INFINITY, max_y = -INFINITY;
+
+    grid.min_x = grid.min_y = INFINITY;
+    grid.curve_count = count;
+    grid.curves = curves;
+
+    for (size_t i = 0; i < count; ++i) {
+        Box box = control_box(curves[i].p, curves[i].degree);
+
+        grid.min_x = std::min(grid.min_x, box.min_x);
+        grid.min_y = std::min(grid.min_y, box.min_y);
+        max_x = std::max(max_x, box.max_x);
+        max_y = std::max(max_y, box.max_y);
+    }
+
+    if (count == 0) {
+        grid.min_x = grid.min_y = max_x = max_y = 0;
+    }
+
+    float width = std::max(max_x - grid.min_x, 1e-6f);
+    float height = std::max(max_y - grid.min_y, 1e-6f);
+    double tiles = std::max(count / CURVES_PER_TILE, 1.0);
+
+    while (true) {
+        grid.columns = std::min(std::max((int) std::sqrt(tiles * width / height), 1), MAX_GRID_SIZE);
+        grid.rows = std::min(std::max((int) (tiles / grid.columns), 1), MAX_GRID_SIZE);
+
+        // A tiny bit bigger, so that the far edges are inside the last tiles
+        grid.tile_width = width / grid.columns * 1.0001f;
+        grid.tile_height = height / grid.rows * 1.0001f;
+        grid.entry_count = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            grid.entry_count += tiles_covered(grid, control_box(curves[i].p, curves[i].degree));
+        }
+
+        if (tiles <= 1 || grid.entry_count <= MAX_TILES_PER_CURVE * count) {
+            break;
+        }
+
+        tiles /= 2;
+    }
+
+    return grid;
+}
+
+
+size_t bz_collision_grid_size(const bz_curve *curves, size_t count) {
+    bz_collision_grid grid = plan_grid(curves, count);
+    size_t tiles = (size_t) grid.columns * grid.rows;
+
+    return count * sizeof(Box) + (tiles + 1) * sizeof(uint32_t) + grid.entry_count * sizeof(uint32_t);
+}
+
+
+bz_collision_grid bz_collision_grid_build(const bz_curve *curves, size_t count, void *memory) {
+    bz_collision_grid grid = plan_grid(curves, count);
+    grid.memory = memory;
+
+    GridMemory m = grid_memory(grid);
+    size_t tiles = (size_t) grid.columns * grid.rows;
+
+    // Count the curves in each tile, then turn the counts into where each tile's entries start
+    std::fill(m.tile_first, m.tile_first + tiles + 1, 0);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Box& box = m.boxes[i] = control_box(curves[i].p, curves[i].degree);
+
+        for (int row = row_at(grid, box.min_y); row <= row_at(grid, box.max_y); ++row) {
+            for (int column = column_at(grid, box.min_x); column <= column_at(grid, box.max_x); ++column) {
+                ++m.tile_first[(size_t) row * grid.columns + column + 1];
+            }
+        }
+    }
+
+    for (size_t tile = 0; tile < tiles; ++tile) {
+        m.tile_first[tile + 1] += m.tile_first[tile];
+    }
+
+    // Fill in the entries (using tile_first to count up as they go in, and putting it back afterwards)
+    for (size_t i = 0; i < count; ++i) {
+        const Box& box = m.boxes[i];
+
+        for (int row = row_at(grid, box.min_y); row <= row_at(grid, box.max_y); ++row) {
+            for (int column = column_at(grid, box.min_x); column <= column_at(grid, box.max_x); ++column) {
+                m.entries[m.tile_first[(size_t) row * grid.columns + column]++] = (uint32_t) i;
+            }
+        }
+    }
+
+    for (size_t tile = tiles; tile > 0; --tile) {
+        m.tile_first[tile] = m.tile_first[tile - 1];
+    }
+
+    m.tile_first[0] = 0;
+    return grid;
+}
+
+
+/*
+ * A circle's move; the middle of the circle goes from 'position' at time 0 to position + move at
+ * time 1, and 'inverse' is 1 / move (for the box test, as in intersect.cpp).
+ */
+typedef struct {
+    bz_point position, move, inverse;
+    float radius;
+} Sweep;
+
+
+/*
+ * When the middle of the circle reaches a box made bigger by the radius on every side; or false,
+ * if it doesn't before 'before'. (Dividing by a zero part of the move gives infinity, which the
+ * box test copes with.)
+ */
+static inline bool sweep_meets_box(const Sweep& sweep, const Box& box, float before, float *enter) {
+    float x0 = (box.min_x - sweep.radius - sweep.position.x) * sweep.inverse.x;
+    float x1 = (box.max_x + sweep.radius - sweep.position.x) * sweep.inverse.x;
+    float y0 = (box.min_y - sweep.radius - sweep.position.y) * sweep.inverse.y;
+    float y1 = (box.max_y + sweep.radius - sweep.position.y) * sweep.inverse.y;
+
+    float near = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), 0.0f);
+    float far = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), 1.0f);
+
+    *enter = near;
+    return near <= far && near < before;
+}
+
+
+static inline float dot(bz_point a, bz_point b) {
+    return a.x * b.x + a.y * b.y;
+}
+
+
+static inline bz_point minus(bz_point a, bz_point b) {
+    return bz_point{a.x - b.x, a.y - b.y};
+}
+
+
+/*
+ * How far p is from the straight line from a to b, and how far along the line the nearest point is
+ * (from 0 at a to 1 at b).
+ */
+static float distance_to_line(bz_point p, bz_point a, bz_point b, float *u) {
+    bz_point ab = minus(b, a), ap = minus(p, a);
+    float length2 = dot(ab, ab);
+
+    *u = length2 > 0 ? std::min(std::max(dot(ap, ab) / length2, 0.0f), 1.0f) : 0;
+
+    bz_point gap = {ap.x - *u * ab.x, ap.y - *u * ab.y};
+    return std::sqrt(dot(gap, gap));
+}
+
+
+/*
+ * When the circle first touches one of the round ends of a capsule, centred on 'end', if before
+ * *time; the middle of the circle is then exactly its radius from 'end'.
+ */
+static bool sweep_meets_end(const Sweep& sweep, bz_point end, float *time, bz_point *normal) {
+    bz_point w = minus(sweep.position, end);
+    float a = dot(sweep.move, sweep.move), b = dot(w, sweep.move);
+    float c = dot(w, w) - sweep.radius * sweep.radius;
+    float discriminant = b * b - a * c;
+
+    // Moving away, or passing by
+    if (a <= 0 || b >= 0 || discriminant < 0) {
+        return false;
+    }
+
+    float when = (-b - std::sqrt(discriminant)) / a;
+
+    if (when >= *time) {
+        return false;
+    }
+
+    *time = std::max(when, 0.0f);
+    *normal = bz_point{(w.x + *time * sweep.move.x) / sweep.radius, (w.y + *time * sweep.move.y) / sweep.radius};
+    return true;
+}
+
+
+/*
+ * When the circle first touches the straight line from a to b, if before *time. Also says where
+ * along the line (from 0 at a to 1 at b), and which way is straight out from the line towards
+ * the middle of the circle.
+ */
+static bool sweep_meets_line(const Sweep& sweep, bz_point a, bz_point b, float *time, float *u, bz_point *normal) {
+    float distance = distance_to_line(sweep.position, a, b, u);
+    bz_point ab = minus(b, a);
+    float length = std::sqrt(dot(ab, ab));
+
+    // Already touching
+    if (distance <= sweep.radius) {
+        bz_point nearest = {a.x + *u * ab.x, a.y + *u * ab.y};
+        bz_point out = minus(sweep.position, nearest);
+
+        if (distance > 0) {
+            *normal = bz_point{out.x / distance, out.y / distance};
+        } else if (length > 0) {
+            // Right on the line; push back the way it came
+            *normal = bz_point{-ab.y / length, ab.x / length};
+
+            if (dot(*normal, sweep.move) > 0) {
+                *normal = bz_point{-normal->x, -normal->y};
+            }
+        } else {
+            *normal = bz_point{0, -1};
+        }
+
+        *time = 0;
+        return true;
+    }
+
+    // Reaching the long side of the capsule; the middle of the circle comes within the radius of the line
+    if (length > 0) {
+        bz_point side = {-ab.y / length, ab.x / length};
+        float height = dot(minus(sweep.position, a), side);
+
+        if (height < 0) {
+            side = bz_point{-side.x, -side.y};
+            height = -height;
+        }
+
+        float approach = -dot(sweep.move, side);
+
+        // (Within the radius of the line already, but beyond one of its ends, the side can't come first)
+        if (approach > 0 && height > sweep.radius) {
+            float when = (height - sweep.radius) / approach;
+            bz_point middle = {sweep.position.x + when * sweep.move.x, sweep.position.y + when * sweep.move.y};
+            float along = dot(minus(middle, a), ab) / (length * length);
+
+            if (along >= 0 && along <= 1) {
+                if (when >= *time) {
+                    return false;
+                }
+
+                *time = when;
+                *u = along;
+                *normal = side;
+                return true;
+            }
+        }
+    }
+
+    // Otherwise it can only touch one of the ends first
+    bool found = false;
+
+    if (sweep_meets_end(sweep, a, time, normal)) {
+        *u = 0;
+        found = true;
+    }
+
+    if (sweep_meets_end(sweep, b, time, normal)) {
+        *u = 1;
+        found = true;
+    }
+
+    return found;
+}
+
+
+/*
+ * A part of a curve, from t0 to t1, with its own control points (quadratic curves just don't use
+ * the last one). 'bend' is how far it can be from the straight line between its ends, and 'enter'
+ * is the earliest the circle could touch it.
+ */
+typedef struct {
+    bz_point p[4];
+    float t0, t1;
+    float bend;
+    float enter;
+    int depth;
+} Part;
+
+
+/*
+ * Cut a part in half, with de Casteljau's algorithm.
+ */
+static void split(const Part& part, int degree, Part& first, Part& second) {
+    bz_point q[4];
+    std::copy(part.p, part.p + 4, q);
+
+    first.p[0] = q[0];
+    second.p[degree] = q[degree];
+
+    for (int level = 1; level <= degree; ++level) {
+        for (int i = 0; i <= degree - level; ++i) {
+            q[i] = bz_point{0.5f * (q[i].x + q[i + 1].x), 0.5f * (q[i].y + q[i + 1].y)};
+        }
+
+        first.p[level] = q[0];
+        second.p[degree - level] = q[degree - level];
+    }
+
+    float middle = 0.5f * (part.t0 + part.t1);
+    first.t0 = part.t0;
+    first.t1 = second.t0 = middle;
+    second.t1 = part.t1;
+    first.depth = second.depth = part.depth + 1;
+}
+
+
+/*
+ * Work out a part's bend, and the earliest the circle could touch it; false if not before 'before'.
+ *
+ * The curve never leaves its control points, so it is never further from the straight line between
+ * its ends than the furthest of them. So the circle can't touch it before it would touch that line
+ * with its radius made bigger by that much; which is a much closer fit around the part than its
+ * box, and gets closer still as the part is cut up and straightens out.
+ */
+static bool reach(const Sweep& sweep, Part& part, int degree, float before) {
+    float u;
+    bz_point normal;
+
+    part.bend = 0;
+
+    for (int i = 1; i < degree; ++i) {
+        part.bend = std::max(part.bend, distance_to_line(part.p[i], part.p[0], part.p[degree], &u));
+    }
+
+    Sweep fatter = sweep;
+    fatter.radius += part.bend;
+    part.enter = before;
+
+    return sweep_meets_line(fatter, part.p[0], part.p[degree], &part.enter, &u, &normal);
+}
+
+
+/*
+ * When the circle first touches a curve, if before contact.time; each part is either close enough
+ * to straight, or cut in half, with the half which could be touched first looked at first.
+ */
+static void sweep_curve(const Sweep& sweep, const bz_curve& curve, uint32_t index, bz_contact& contact) {
+    int degree = curve.degree;
+    Part stack[MAX_SPLIT_DEPTH + 1];
+    int depth = 0;
+    Part whole;
+
+    std::copy(curve.p, curve.p + 4, whole.p);
+    whole.t0 = 0;
+    whole.t1 = 1;
+    whole.depth = 0;
+
+    if (!reach(sweep, whole, degree, contact.time)) {
+        return;
+    }
+
+    stack[depth++] = whole;
+
+    while (depth > 0) {
+        Part part = stack[--depth];
+
+        // Something else was touched first, since this part was put on the stack
+        if (part.enter >= contact.time) {
+            continue;
+        }
+
+        if (part.depth == MAX_SPLIT_DEPTH || part.bend <= FLAT_TOLERANCE) {
+            float u;
+
+            if (sweep_meets_line(sweep, part.p[0], part.p[degree], &contact.time, &u, &contact.normal)) {
+                contact.t = part.t0 + u * (part.t1 - part.t0);
+                contact.curve = index;
+            }
+
+            continue;
+        }
+
+        Part first, second;
+        split(part, degree, first, second);
+
+        bool meets_first = reach(sweep, first, degree, contact.time);
+        bool meets_second = reach(sweep, second, degree, contact.time);
+
+        // Push the later one first, so the earlier one is looked at first
+        if (meets_first && meets_second && first.enter < second.enter) {
+            stack[depth++] = second;
+            stack[depth++] = first;
+        } else {
+            if (meets_first) {
+                stack[depth++] = first;
+            }
+
+            if (meets_second) {
+                stack[depth++] = second;
+            }
+        }
+    }
+}
+
+
+/*
+ * Every curve near a circle's move. Only the tiles which the middle of the circle reaches (with
+ * each tile made bigger by the radius, as for the curves' boxes) before the earliest touch so far
+ * are looked at, a row or column at a time in the direction it moves, so that the earliest
+ * touches tend to be found first.
+ *
+ * A curve in several of those tiles is only looked at in one of them; the one with the point of
+ * the curve's box which is nearest to where the middle of the circle first reaches the box. The
+ * middle of the circle is within the radius of that point then, so it always reaches that tile.
+ */
+static bz_contact sweep_circle(const bz_collision_grid& grid, const GridMemory& m, const bz_circle& circle) {
+    bz_contact contact = {1, 0, {0, 0}, BZ_NO_HIT};
+    Sweep sweep;
+
+    sweep.position = circle.position;
+    sweep.move = circle.move;
+    sweep.inverse = bz_point{1.0f / circle.move.x, 1.0f / circle.move.y};
+    sweep.radius = circle.radius;
+
+    bz_point end = {circle.position.x + circle.move.x, circle.position.y + circle.move.y};
+    Box box = {std::min(circle.position.x, end.x) - circle.radius, std::min(circle.position.y, end.y) - circle.radius,
+               std::max(circle.position.x, end.x) + circle.radius, std::max(circle.position.y, end.y) + circle.radius};
+
+    // Nowhere near the grid
+    if (box.max_x < grid.min_x || box.max_y < grid.min_y
+        || box.min_x > grid.min_x + grid.columns * grid.tile_width
+        || box.min_y > grid.min_y + grid.rows * grid.tile_height) {
+        return contact;
+    }
+
+    int column0 = column_at(grid, box.min_x), column1 = column_at(grid, box.max_x);
+    int row0 = row_at(grid, box.min_y), row1 = row_at(grid, box.max_y);
+
+    // Rows or columns, whichever the circle moves along most, in the direction it moves
+    bool by_column = std::fabs(circle.move.x) >= std::fabs(circle.move.y);
+    int outer_count = by_column ? column1 - column0 + 1 : row1 - row0 + 1;
+    int inner_count = by_column ? row1 - row0 + 1 : column1 - column0 + 1;
+    bool outer_back = by_column ? circle.move.x < 0 : circle.move.y < 0;
+    bool inner_back = by_column ? circle.move.y < 0 : circle.move.x < 0;
+    float enter;
+
+    for (int i = 0; i < outer_count; ++i) {
+        int outer = outer_back ? outer_count - 1 - i : i;
+        Box strip = by_column
+            ? Box{grid.min_x + (column0 + outer) * grid.tile_width, box.min_y,
+                  grid.min_x + (column0 + outer + 1) * grid.tile_width, box.max_y}
+            : Box{box.min_x, grid.min_y + (row0 + outer) * grid.tile_height,
+                  box.max_x, grid.min_y + (row0 + outer + 1) * grid.tile_height};
+
+        if (!sweep_meets_box(sweep, strip, contact.time, &enter)) {
+            continue;
+        }
+
+        for (int j = 0; j < inner_count; ++j) {
+            int inner = inner_back ? inner_count - 1 - j : j;
+            int column = column0 + (by_column ? outer : inner);
+            int row = row0 + (by_column ? inner : outer);
+            Box tile = {grid.min_x + column * grid.tile_width, grid.min_y + row * grid.tile_height,
+                        grid.min_x + (column + 1) * grid.tile_width, grid.min_y + (row + 1) * grid.tile_height};
+
+            if (!sweep_meets_box(sweep, tile, contact.time, &enter)) {
+                continue;
+            }
+
+            size_t tile_index = (size_t) row * grid.columns + column;
+
+            for (uint32_t entry = m.tile_first[tile_index]; entry < m.tile_first[tile_index + 1]; ++entry) {
+                uint32_t curve = m.entries[entry];
+                const Box& curve_box = m.boxes[curve];
+
+                if (!sweep_meets_box(sweep, curve_box, contact.time, &enter)) {
+                    continue;
+                }
+
+                float x = std::min(std::max(circle.position.x + enter * circle.move.x, curve_box.min_x), curve_box.max_x);
+                float y = std::min(std::max(circle.position.y + enter * circle.move.y, curve_box.min_y), curve_box.max_y);
+
+                if (column_at(grid, x) == column && row_at(grid, y) == row) {
+                    sweep_curve(sweep, grid.curves[curve], curve, contact);
+
+                    // Touching already, so nothing can come first
+                    if (contact.time == 0) {
+                        return contact;
+                    }
+                }
+            }
+        }
+    }
+
+    return contact;
+}
+
+
+/*
+ * The straight pieces don't go through t evenly, so the t where a circle touched one is only roughly
+ * right; a few steps of Newton's method find where on the curve is really nearest to the middle of
+ * the circle (where the line from it to the curve is square to the curve). Also sets 'out' to the
+ * way from there to the middle of the circle.
+ */
+const int NEAREST_STEPS = 3;
+
+static float nearest_t(const bz_curve& curve, bz_point middle, float t, bz_point *out) {
+    float cx[4], cy[4];
+    coefficients(curve, cx, cy);
+
+    for (int step = 0; step <= NEAREST_STEPS; ++step) {
+        float x = middle.x - (((cx[3] * t + cx[2]) * t + cx[1]) * t + cx[0]);
+        float y = middle.y - (((cy[3] * t + cy[2]) * t + cy[1]) * t + cy[0]);
+        *out = bz_point{x, y};
+
+        if (step == NEAREST_STEPS) {
+            break;
+        }
+
+        float dx = (3 * cx[3] * t + 2 * cx[2]) * t + cx[1], dy = (3 * cy[3] * t + 2 * cy[2]) * t + cy[1];
+        float ddx = 6 * cx[3] * t + 2 * cx[2], ddy = 6 * cy[3] * t + 2 * cy[2];
+
+        // (x, y) . (dx, dy) is 0 at the nearest point, and this is its slope
+        float f = x * dx + y * dy, slope = dx * dx + dy * dy - x * ddx - y * ddy;
+
+        if (!(slope > 0)) {
+            break;
+        }
+
+        t = std::min(std::max(t + f / slope, 0.0f), 1.0f);
+    }
+
+    return t;
+}
+
+
+void bz_collide_circles(const bz_collision_grid *grid, const bz_circle *circles, size_t count, bz_contact *contacts) {
+    GridMemory m = grid_memory(*grid);
+
+    for (size_t i = 0; i < count; ++i) {
+        const bz_circle& circle = circles[i];
+        bz_contact contact = sweep_circle(*grid, m, circle);
+
+        if (contact.curve != BZ_NO_HIT) {
+            bz_point middle = {circle.position.x + contact.time * circle.move.x, circle.position.y + contact.time * circle.move.y};
+            bz_point out;
+            float t = nearest_t(grid->curves[contact.curve], middle, contact.t, &out);
+            float distance = std::sqrt(dot(out, out));
+
+            contact.t = t;
+
+            if (distance > 0) {
+                contact.normal = bz_point{out.x / distance, out.y / distance};
+            }
+        }
+
+        contacts[i] = contact;
+    }
+}
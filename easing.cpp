@@ -0,0 +1,223 @@
+/*
+ * libbezier; easing curves, for how fast animations move (see bz_easing in bezier.h).
+ *
+ * An easing curve is a cubic curve from 0,0 to 1,1; x is how much of the animation's time has
+ * gone, and y is how far along it should be by then. Going from x to y means finding the t where
+ * the curve's x is the one wanted, and then working out y at that t. x is a cubic polynomial in
+ * t, which only ever goes up (as long as the middle control points' x are between 0 and 1), so
+ * there is exactly one such t.
+ *
+ * Newton's method finds t very quickly from a good first guess. The guess comes from a small table
+ * of x at evenly spaced values of t, made once for each curve: find which two entries x is between,
+ * and guess that t is the same fraction of the way between theirs. Where the curve is nearly flat
+ * in x, Newton's method can shoot off, so there the gap between the two entries is halved instead
+ * until it is small enough, as in intersect.cpp.
+ *
+ * bz_ease_batch does 4 animations at once, one in each lane of a SIMD register, all taking the same
+ * number of Newton steps. The few which haven't got close enough by then are finished off one at a time.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "bezier.hpp"
+
+
+typedef float quad_float __attribute__((vector_size(4 * sizeof(float))));
+typedef int32_t quad_int __attribute__((vector_size(4 * sizeof(int32_t))));
+
+
+/*
+ * How close t has to be; a millionth of the way along the curve. (Being close in x isn't enough;
+ * where the curve is nearly flat in x, x hardly changes over a big range of t, and y could
+ * change a lot.)
+ */
+const float EASING_TOLERANCE = 1e-6f;
+
+/*
+ * Newton's method is only used where x changes at least this fast with t,
+ * and at most this many steps are taken.
+ */
+const float NEWTON_MIN_SLOPE = 1e-3f;
+const int NEWTON_STEPS = 4;
+
+
+bz_easing bz_easing_make(float x1, float y1, float x2, float y2) {
+    bz_easing easing;
+
+    // Outside 0 to 1, x could go back on itself, and some x would have more than one y
+    x1 = std::min(std::max(x1, 0.0f), 1.0f);
+    x2 = std::min(std::max(x2, 0.0f), 1.0f);
+
+    // The cubic curve from 0,0 through x1,y1 and x2,y2 to 1,1, multiplied out as polynomials in t
+    // (the same sums as tessellate_cubic in bezier.hpp, with p0 = 0 and p3 = 1)
+    easing.x[0] = 3 * x1;
+    easing.x[1] = 3 * (x2 - 2 * x1);
+    easing.x[2] = 1 + 3 * (x1 - x2);
+    easing.y[0] = 3 * y1;
+    easing.y[1] = 3 * (y2 - 2 * y1);
+    easing.y[2] = 1 + 3 * (y1 - y2);
+    easing.linear = x1 == y1 && x2 == y2;
+
+    for (int i = 0; i < BZ_EASING_SAMPLES; ++i) {
+        float t = (float) i / (BZ_EASING_SAMPLES - 1);
+        easing.samples[i] = ((easing.x[2] * t + easing.x[1]) * t + easing.x[0]) * t;
+    }
+
+    return easing;
+}
+
+
+static inline float polynomial(const float *c, float t) {
+    return ((c[2] * t + c[1]) * t + c[0]) * t;
+}
+
+
+static inline float slope(const float *c, float t) {
+    return (3 * c[2] * t + 2 * c[1]) * t + c[0];
+}
+
+
+/*
+ * Which gap between table entries x is in, and the first guess at t.
+ */
+static inline int table_gap(const bz_easing& easing, float x, float *guess) {
+    int gap = 0;
+
+    while (gap < BZ_EASING_SAMPLES - 2 && easing.samples[gap + 1] <= x) {
+        ++gap;
+    }
+
+    float width = easing.samples[gap + 1] - easing.samples[gap];
+    float fraction = width > 0 ? (x - easing.samples[gap]) / width : 0;
+
+    *guess = (gap + std::min(std::max(fraction, 0.0f), 1.0f)) / (BZ_EASING_SAMPLES - 1);
+    return gap;
+}
+
+
+/*
+ * The t where the curve's x is the one wanted, for 0 < x < 1.
+ */
+static float solve(const bz_easing& easing, float x) {
+    float t;
+    int gap = table_gap(easing, x, &t);
+
+    for (int i = 0; i < NEWTON_STEPS; ++i) {
+        float s = slope(easing.x, t);
+
+        if (s < NEWTON_MIN_SLOPE) {
+            break;
+        }
+
+        // Each step roughly squares the error, so once a step is tiny, the next would be much tinier
+        float step = (polynomial(easing.x, t) - x) / s;
+        t -= step;
+
+        if (std::fabs(step) < EASING_TOLERANCE) {
+            return t;
+        }
+    }
+
+    // Halve the table gap until close enough
+    float low = (float) gap / (BZ_EASING_SAMPLES - 1);
+    float high = (float) (gap + 1) / (BZ_EASING_SAMPLES - 1);
+
+    while (high - low > EASING_TOLERANCE) {
+        float middle = 0.5f * (low + high);
+
+        if (polynomial(easing.x, middle) < x) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    return 0.5f * (low + high);
+}
+
+
+float bz_ease(const bz_easing *easing, float x) {
+    if (x <= 0) {
+        return 0;
+    } else if (x >= 1) {
+        return 1;
+    } else if (easing->linear) {
+        return x;
+    }
+
+    return polynomial(easing->y, solve(*easing, x));
+}
+
+
+static inline quad_float polynomial4(const quad_float *c, quad_float t) {
+    return ((c[2] * t + c[1]) * t + c[0]) * t;
+}
+
+
+static inline quad_float slope4(const quad_float *c, quad_float t) {
+    return (3 * c[2] * t + 2 * c[1]) * t + c[0];
+}
+
+
+void bz_ease_batch(const bz_easing *easings, const uint32_t *which, const float *x, size_t count, float *y) {
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        const bz_easing *lane_easing[4];
+        quad_float cx[3], cy[3], t, low, high, xs;
+
+        for (int lane = 0; lane < 4; ++lane) {
+            const bz_easing& easing = easings[which ? which[i + lane] : i + lane];
+            float lane_x = std::min(std::max(x[i + lane], 0.0f), 1.0f);
+            float guess;
+            int gap = table_gap(easing, lane_x, &guess);
+
+            lane_easing[lane] = &easing;
+
+            for (int k = 0; k < 3; ++k) {
+                cx[k][lane] = easing.x[k];
+                cy[k][lane] = easing.y[k];
+            }
+
+            xs[lane] = lane_x;
+            t[lane] = guess;
+            low[lane] = (float) gap / (BZ_EASING_SAMPLES - 1);
+            high[lane] = (float) (gap + 1) / (BZ_EASING_SAMPLES - 1);
+        }
+
+        // Newton's method in every lane, staying within each lane's table gap so that
+        // the flat places can't send t off somewhere else entirely
+        for (int step = 0; step < NEWTON_STEPS; ++step) {
+            quad_float s = slope4(cx, t);
+            quad_float step_size = (polynomial4(cx, t) - xs) / s;
+            quad_int steep = s >= NEWTON_MIN_SLOPE;
+
+            t = steep ? t - step_size : t;
+            t = t < low ? low : t;
+            t = t > high ? high : t;
+        }
+
+        // One last step, which also says how close the one before was
+        quad_float s = slope4(cx, t);
+        quad_float last_step = (polynomial4(cx, t) - xs) / s;
+        quad_float result = polynomial4(cy, t - last_step);
+
+        for (int lane = 0; lane < 4; ++lane) {
+            float lane_x = xs[lane];
+
+            // The ends, straight lines, and anything not close enough yet
+            if (lane_x <= 0 || lane_x >= 1 || lane_easing[lane]->linear
+                || !(s[lane] >= NEWTON_MIN_SLOPE && std::fabs(last_step[lane]) < EASING_TOLERANCE)) {
+                result[lane] = bz_ease(lane_easing[lane], lane_x);
+            }
+        }
+
+        memcpy(y + i, &result, sizeof(result));
+    }
+
+    for (; i < count; ++i) {
+        y[i] = bz_ease(&easings[which ? which[i] : i], x[i]);
+    }
+}
@@ -0,0 +1,921 @@
+/*
+ * Saving the scene as SVG, PDF or G-code (see export.hpp).
+ */
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "export.hpp"
+#include "trace.hpp"
+
+using std::cerr;
+using std::endl;
+
+
+/*
+ * Positions are rounded to a hundredth of a pixel before they are written, far finer than anyone
+ * could see, so that a curve at 12.3400002 is written as "12.34" and the files stay small.
+ */
+const float PRECISION = 100;
+
+
+/*
+ * Text on its way to a file.
+ *
+ * Handing the file a few bytes at a time costs far more than making them, so everything goes into
+ * a big buffer first and is written out whenever it fills up. 'written' counts what has been handed
+ * over already, so that PDF files can say where each of their parts starts.
+ */
+const size_t OUTPUT_BUFFER_SIZE = 1 << 16;
+
+// The most that any single put_ function adds at once, apart from put_text
+const size_t OUTPUT_MAX_PIECE = 64;
+
+typedef struct {
+    FILE *file;
+    char buffer[OUTPUT_BUFFER_SIZE];
+    size_t used;
+    size_t written;
+    bool failed;
+} Output;
+
+
+static void flush_output(Output& out) {
+    if (out.used > 0 && fwrite(out.buffer, 1, out.used, out.file) != out.used) {
+        out.failed = true;
+    }
+
+    out.written += out.used;
+    out.used = 0;
+}
+
+
+/*
+ * How far into the file the next byte will be.
+ */
+static size_t output_position(const Output& out) {
+    return out.written + out.used;
+}
+
+
+static void put_text(Output& out, const char *text, size_t length) {
+    if (out.used + length > OUTPUT_BUFFER_SIZE) {
+        flush_output(out);
+
+        if (length > OUTPUT_BUFFER_SIZE) {
+            if (fwrite(text, 1, length, out.file) != length) {
+                out.failed = true;
+            }
+
+            out.written += length;
+            return;
+        }
+    }
+
+    memcpy(out.buffer + out.used, text, length);
+    out.used += length;
+}
+
+
+static void put_text(Output& out, const char *text) {
+    put_text(out, text, strlen(text));
+}
+
+
+static void put_char(Output& out, char c) {
+    if (out.used + 1 > OUTPUT_BUFFER_SIZE) {
+        flush_output(out);
+    }
+
+    out.buffer[out.used++] = c;
+}
+
+
+/*
+ * A number, as the shortest text which reads back as exactly the same float.
+ */
+static void put_number(Output& out, float value) {
+    if (out.used + OUTPUT_MAX_PIECE > OUTPUT_BUFFER_SIZE) {
+        flush_output(out);
+    }
+
+    // (Adding zero turns -0 into 0, which nobody wants to read)
+    std::to_chars_result result = std::to_chars(out.buffer + out.used, out.buffer + OUTPUT_BUFFER_SIZE, value + 0.0f);
+    out.used = result.ptr - out.buffer;
+}
+
+
+static void put_integer(Output& out, size_t value) {
+    if (out.used + OUTPUT_MAX_PIECE > OUTPUT_BUFFER_SIZE) {
+        flush_output(out);
+    }
+
+    std::to_chars_result result = std::to_chars(out.buffer + out.used, out.buffer + OUTPUT_BUFFER_SIZE, value);
+    out.used = result.ptr - out.buffer;
+}
+
+
+/*
+ * A position on the page, rounded to PRECISION.
+ */
+static float rounded(float value) {
+    return std::nearbyint(value * PRECISION) / PRECISION;
+}
+
+static void put_coordinate(Output& out, float value) {
+    put_number(out, rounded(value));
+}
+
+
+/*
+ * A point as "x y", after a separator.
+ */
+static void put_point(Output& out, char separator, const Point& p) {
+    put_char(out, separator);
+    put_coordinate(out, p.x);
+    put_char(out, ' ');
+    put_coordinate(out, p.y);
+}
+
+
+/*
+ * Where one of a curve's control points lands on the page.
+ */
+static Point page_point(const Point& p, const bz_transform& transform) {
+    return Point{p.x * transform.scale_x + transform.offset_x, p.y * transform.scale_y + transform.offset_y};
+}
+
+
+/*
+ * Does any of a curve land on the page? As with curve_visible in main.cpp,
+ * a curve never leaves the box around its control points.
+ */
+static bool on_page(const Curve& curve, const bz_transform& transform, int width, int height) {
+    Point first = page_point(curve.p[0], transform);
+    float min_x = first.x, max_x = first.x, min_y = first.y, max_y = first.y;
+
+    for (int i = 1; i <= curve.degree; ++i) {
+        Point p = page_point(curve.p[i], transform);
+        min_x = std::min(min_x, p.x);
+        max_x = std::max(max_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_y = std::max(max_y, p.y);
+    }
+
+    return !(max_x < 0 || min_x > width || max_y < 0 || min_y > height);
+}
+
+
+/*
+ * How much of a curve to save.
+ */
+static CurveDetail export_detail(const Curve& curve, const bz_transform& transform, bool simplify) {
+    return simplify ? curve_detail(curve, transform, COLLAPSE_TOLERANCE) : DETAIL_FULL;
+}
+
+
+static bool same_colour(const Curve& a, const Curve& b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+
+/*
+ * SVG; every run of curves in the same colour becomes one <path>, whose 'd' is a list of
+ * commands, each a letter followed by points: "M" moves to a point without drawing, "L" draws
+ * a line, "h" a line across, and "Q" and "C" draw quadratic and cubic curves.
+ */
+static void write_svg(Output& out, const std::vector<Curve>& curves, const bz_transform& transform,
+                      int width, int height, bool simplify) {
+    put_text(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+    put_integer(out, width);
+    put_text(out, "\" height=\"");
+    put_integer(out, height);
+    put_text(out, "\" viewBox=\"0 0 ");
+    put_integer(out, width);
+    put_char(out, ' ');
+    put_integer(out, height);
+    put_text(out, "\">\n<rect width=\"100%\" height=\"100%\" fill=\"#000000\"/>\n<g fill=\"none\" stroke-width=\"1\">\n");
+
+    const Curve *path_colour = NULL;
+
+    for (const Curve& curve : curves) {
+        if (!on_page(curve, transform, width, height)) {
+            continue;
+        }
+
+        if (!path_colour || !same_colour(curve, *path_colour)) {
+            if (path_colour) {
+                put_text(out, "\"/>\n");
+            }
+
+            char colour[32];
+            snprintf(colour, sizeof(colour), "<path stroke=\"#%02x%02x%02x\" d=\"", curve.r, curve.g, curve.b);
+            put_text(out, colour);
+            path_colour = &curve;
+        }
+
+        Point start = page_point(curve.p[0], transform);
+        put_point(out, 'M', start);
+
+        switch (export_detail(curve, transform, simplify)) {
+            case DETAIL_POINT:
+                put_text(out, "h1");
+                break;
+            case DETAIL_LINE:
+                put_point(out, 'L', page_point(curve.p[curve.degree], transform));
+                break;
+            case DETAIL_FULL:
+                put_point(out, curve.degree == 2 ? 'Q' : 'C', page_point(curve.p[1], transform));
+
+                for (int i = 2; i <= curve.degree; ++i) {
+                    put_point(out, ' ', page_point(curve.p[i], transform));
+                }
+                break;
+        }
+    }
+
+    if (path_colour) {
+        put_text(out, "\"/>\n");
+    }
+
+    put_text(out, "</g>\n</svg>\n");
+}
+
+
+/*
+ * The drawing commands for a PDF page. Numbers come first and then what to do with them:
+ * "m" moves to a point, "l" adds a line, "c" adds a cubic curve, "RG" sets the colour
+ * (red, green and blue from 0 to 1) and "S" draws everything added since the last "S".
+ *
+ * PDF has no quadratic curves, but any quadratic curve is also a cubic curve, with its middle
+ * control point replaced by two which are each two thirds of the way to it from the ends.
+ */
+static void write_pdf_content(Output& out, const std::vector<Curve>& curves, const bz_transform& transform,
+                              int width, int height, bool simplify) {
+    // A black background, and lines 1 pixel wide
+    put_text(out, "0 0 0 rg 0 0 ");
+    put_integer(out, width);
+    put_char(out, ' ');
+    put_integer(out, height);
+    put_text(out, " re f\n1 w\n");
+
+    const Curve *stroke_colour = NULL;
+
+    for (const Curve& curve : curves) {
+        if (!on_page(curve, transform, width, height)) {
+            continue;
+        }
+
+        if (!stroke_colour || !same_colour(curve, *stroke_colour)) {
+            if (stroke_colour) {
+                put_text(out, "S\n");
+            }
+
+            put_number(out, curve.r / 255.0f);
+            put_char(out, ' ');
+            put_number(out, curve.g / 255.0f);
+            put_char(out, ' ');
+            put_number(out, curve.b / 255.0f);
+            put_text(out, " RG\n");
+            stroke_colour = &curve;
+        }
+
+        Point start = page_point(curve.p[0], transform);
+        Point end = page_point(curve.p[curve.degree], transform);
+        put_coordinate(out, start.x);
+        put_char(out, ' ');
+        put_coordinate(out, start.y);
+        put_text(out, " m");
+
+        switch (export_detail(curve, transform, simplify)) {
+            case DETAIL_POINT:
+                put_point(out, ' ', Point{start.x + 1, start.y});
+                put_text(out, " l\n");
+                break;
+            case DETAIL_LINE:
+                put_point(out, ' ', end);
+                put_text(out, " l\n");
+                break;
+            case DETAIL_FULL:
+                if (curve.degree == 2) {
+                    Point middle = page_point(curve.p[1], transform);
+                    put_point(out, ' ', lerp(2.0f / 3, start, middle));
+                    put_point(out, ' ', lerp(2.0f / 3, end, middle));
+                } else {
+                    put_point(out, ' ', page_point(curve.p[1], transform));
+                    put_point(out, ' ', page_point(curve.p[2], transform));
+                }
+
+                put_point(out, ' ', end);
+                put_text(out, " c\n");
+                break;
+        }
+    }
+
+    if (stroke_colour) {
+        put_text(out, "S\n");
+    }
+}
+
+
+/*
+ * A PDF file is a list of numbered objects; here a catalogue (1) pointing to a list of pages (2)
+ * holding one page (3), whose drawing commands are in a stream (4), whose length (5) is only known
+ * once it has been written. At the end, the 'xref' table says where each object starts in the file.
+ *
+ * PDF's y goes up from the bottom of the page rather than down from the top, so 'transform' has
+ * already been turned upside down.
+ */
+static void write_pdf(Output& out, const std::vector<Curve>& curves, const bz_transform& transform,
+                      int width, int height, bool simplify) {
+    const int OBJECTS = 5;
+    size_t offsets[OBJECTS + 1] = {};
+    char line[64];
+
+    // (The second line's odd characters tell programs that the file isn't plain text)
+    put_text(out, "%PDF-1.4\n%\xe2\xe3\xcf\xd3\n");
+
+    offsets[1] = output_position(out);
+    put_text(out, "1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+    offsets[2] = output_position(out);
+    put_text(out, "2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 >>\nendobj\n");
+
+    offsets[3] = output_position(out);
+    snprintf(line, sizeof(line), "[0 0 %d %d]", width, height);
+    put_text(out, "3 0 obj\n<< /Type /Page /Parent 2 0 R /MediaBox ");
+    put_text(out, line);
+    put_text(out, " /Contents 4 0 R >>\nendobj\n");
+
+    offsets[4] = output_position(out);
+    put_text(out, "4 0 obj\n<< /Length 5 0 R >>\nstream\n");
+
+    size_t stream_start = output_position(out);
+    write_pdf_content(out, curves, transform, width, height, simplify);
+    size_t stream_length = output_position(out) - stream_start;
+
+    put_text(out, "endstream\nendobj\n");
+
+    offsets[5] = output_position(out);
+    put_text(out, "5 0 obj\n");
+    put_integer(out, stream_length);
+    put_text(out, "\nendobj\n");
+
+    // Every line of the table is exactly 20 bytes long, so readers can jump straight to any object
+    size_t xref = output_position(out);
+    snprintf(line, sizeof(line), "xref\n0 %d\n0000000000 65535 f \n", OBJECTS + 1);
+    put_text(out, line);
+
+    for (int i = 1; i <= OBJECTS; ++i) {
+        snprintf(line, sizeof(line), "%010zu 00000 n \n", offsets[i]);
+        put_text(out, line);
+    }
+
+    snprintf(line, sizeof(line), "trailer\n<< /Size %d /Root 1 0 R >>\nstartxref\n", OBJECTS + 1);
+    put_text(out, line);
+    put_integer(out, xref);
+    put_text(out, "\n%%EOF\n");
+}
+
+
+/*
+ * G-code, for pen plotters and CNC machines.
+ *
+ * Positions are in millimetres, with one pixel of the page being one millimetre. The pen is lifted
+ * and lowered by moving Z; G0 moves as fast as possible (with the pen up), G1 draws a straight line,
+ * and G2 and G3 draw clockwise and anticlockwise arcs of a circle, whose centre is given as I and J,
+ * measured from where the arc starts. As with PDF, y goes up, so 'transform' has been turned upside down.
+ */
+const float GCODE_TOLERANCE = 0.05f;    // How far (in mm) the pen may stray from the true curve
+const float PEN_UP_Z = 2;
+const float PEN_DOWN_Z = 0;
+const int DRAW_SPEED = 1500;            // mm per minute
+const int MAX_FIT_DEPTH = 12;           // How many times a curve can be cut in half to make it fit
+
+/*
+ * Arc centres (I and J) are written to a ten-thousandth of a millimetre, rather than PRECISION.
+ * Controllers check that both ends of an arc are the same distance from its centre; GRBL allows
+ * 0.005 mm (or 0.1% of the radius, for big arcs), and a centre rounded to a hundredth can be 0.007 mm out.
+ */
+const float ARC_PRECISION = 10000;
+
+
+/*
+ * One curve to plot, in the order it will be plotted; 'reversed' ones are drawn from end to start.
+ */
+typedef struct {
+    Point start;
+    Point end;
+    size_t curve;
+    bool reversed;
+} Stop;
+
+
+static float distance(const Point& a, const Point& b) {
+    return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+}
+
+
+/*
+ * The total distance travelled with the pen up, starting from stops[0].
+ */
+static double travel_distance(const std::vector<Stop>& stops) {
+    double total = 0;
+
+    for (size_t i = 1; i < stops.size(); ++i) {
+        total += distance(stops[i - 1].end, stops[i].start);
+    }
+
+    return total;
+}
+
+
+/*
+ * The plotter spends most of its time travelling between curves rather than drawing them,
+ * so the curves are put in a better order (and turned round where that helps) first.
+ *
+ * Nearest neighbour: from wherever the pen is, go to whichever unplotted curve has an end
+ * closest to it. Finding that quickly among a million curves needs a 'spatial index'; here
+ * a grid, with a list in every cell of the curve ends which fall in it. We search outwards
+ * from the pen one square ring of cells at a time, and can stop as soon as the best end found
+ * is closer than anything in the next ring could be. Ends of curves already plotted are
+ * dropped from the lists as they are come across.
+ */
+typedef struct {
+    Point at;           // (A copy, so that searching a cell reads one small piece of memory)
+    uint32_t stop;
+    uint32_t at_end;    // 1 if this is the end of the curve rather than the start
+} GridEntry;
+
+static void order_nearest_neighbour(std::vector<Stop>& stops) {
+    size_t count = stops.size() - 1;    // (stops[0] is where the pen starts, and stays first)
+
+    if (count < 2) {
+        return;
+    }
+
+    Point min = stops[1].start, max = stops[1].start;
+
+    for (size_t i = 1; i < stops.size(); ++i) {
+        for (const Point& p : {stops[i].start, stops[i].end}) {
+            min = Point{std::min(min.x, p.x), std::min(min.y, p.y)};
+            max = Point{std::max(max.x, p.x), std::max(max.y, p.y)};
+        }
+    }
+
+    // About two curves (four ends) to a cell
+    int cells_across = std::max(1, (int) std::sqrt(count / 2.0));
+    int cells_down = cells_across;
+    float cell_width = std::max((max.x - min.x) / cells_across, 1e-6f);
+    float cell_height = std::max((max.y - min.y) / cells_down, 1e-6f);
+
+    auto cell_of = [&](const Point& p, int *cx, int *cy) {
+        *cx = std::min(std::max((int) ((p.x - min.x) / cell_width), 0), cells_across - 1);
+        *cy = std::min(std::max((int) ((p.y - min.y) / cell_height), 0), cells_down - 1);
+    };
+
+    // Each cell's ends are kept together in one big list (cell i's start at first[i]),
+    // with the ends still to be plotted at the front and live[i] of them left
+    size_t cell_count = (size_t) cells_across * cells_down;
+    std::vector<uint32_t> first(cell_count + 1, 0);
+    std::vector<uint32_t> live(cell_count, 0);
+    std::vector<GridEntry> entries(2 * count);
+
+    auto cell_index = [&](const Point& p) {
+        int cx, cy;
+        cell_of(p, &cx, &cy);
+        return (size_t) cy * cells_across + cx;
+    };
+
+    for (size_t i = 1; i < stops.size(); ++i) {
+        ++live[cell_index(stops[i].start)];
+        ++live[cell_index(stops[i].end)];
+    }
+
+    for (size_t c = 0; c < cell_count; ++c) {
+        first[c + 1] = first[c] + live[c];
+        live[c] = 0;
+    }
+
+    for (size_t i = 1; i < stops.size(); ++i) {
+        size_t c = cell_index(stops[i].start);
+        entries[first[c] + live[c]++] = GridEntry{stops[i].start, (uint32_t) i, 0};
+        c = cell_index(stops[i].end);
+        entries[first[c] + live[c]++] = GridEntry{stops[i].end, (uint32_t) i, 1};
+    }
+
+    std::vector<bool> plotted(stops.size(), false);
+    std::vector<Stop> order;
+    order.reserve(stops.size());
+    order.push_back(stops[0]);
+
+    // Look through one cell, tidying away the ends of curves which have already been plotted
+    float best_distance;
+    GridEntry best = {};
+
+    auto search_cell = [&](int cx, int cy, const Point& from) {
+        size_t c = (size_t) cy * cells_across + cx;
+
+        if (live[c] == 0) {
+            return;
+        }
+
+        GridEntry *cell = entries.data() + first[c];
+        uint32_t kept = 0;
+
+        for (uint32_t k = 0; k < live[c]; ++k) {
+            GridEntry entry = cell[k];
+
+            if (plotted[entry.stop]) {
+                continue;
+            }
+
+            cell[kept++] = entry;
+            float d = distance(from, entry.at);
+
+            if (d < best_distance) {
+                best_distance = d;
+                best = entry;
+            }
+        }
+
+        live[c] = kept;
+    };
+
+    for (size_t n = 0; n < count; ++n) {
+        Point from = order.back().end;
+        int cx, cy;
+        cell_of(from, &cx, &cy);
+
+        best_distance = INFINITY;
+        float ring_width = std::min(cell_width, cell_height);
+        int max_ring = std::max(cells_across, cells_down);
+
+        for (int ring = 0; ring <= max_ring; ++ring) {
+            int left = cx - ring, right = cx + ring, top = cy - ring, bottom = cy + ring;
+
+            for (int y = std::max(top, 0); y <= std::min(bottom, cells_down - 1); ++y) {
+                if (y == top || y == bottom) {
+                    for (int x = std::max(left, 0); x <= std::min(right, cells_across - 1); ++x) {
+                        search_cell(x, y, from);
+                    }
+                } else {
+                    if (left >= 0) {
+                        search_cell(left, y, from);
+                    }
+
+                    if (right < cells_across) {
+                        search_cell(right, y, from);
+                    }
+                }
+            }
+
+            // Everything in the next ring is at least this far away
+            if (best_distance <= ring * ring_width) {
+                break;
+            }
+        }
+
+        Stop next = stops[best.stop];
+        plotted[best.stop] = true;
+
+        // Arriving at the curve's end means drawing it backwards
+        if (best.at_end) {
+            std::swap(next.start, next.end);
+            next.reversed = !next.reversed;
+        }
+
+        order.push_back(next);
+    }
+
+    stops.swap(order);
+}
+
+
+/*
+ * 2-opt: nearest neighbour leaves some long trips, usually back to curves it passed by earlier.
+ * Turning a whole run of stops round, stops[i + 1] to stops[j], replaces the trips into and out of
+ * the run with trips between their other ends; keep doing it wherever that is shorter. Checking
+ * every pair of stops would take far too long, so j is only ever up to TWO_OPT_WINDOW after i.
+ */
+const size_t TWO_OPT_WINDOW = 32;
+const int TWO_OPT_PASSES = 8;
+
+static void improve_two_opt(std::vector<Stop>& stops) {
+    for (int pass = 0; pass < TWO_OPT_PASSES; ++pass) {
+        bool improved = false;
+
+        for (size_t i = 0; i + 2 < stops.size(); ++i) {
+            for (size_t j = i + 2; j < stops.size() && j <= i + TWO_OPT_WINDOW; ++j) {
+                bool last = j + 1 == stops.size();
+
+                float before = distance(stops[i].end, stops[i + 1].start)
+                             + (last ? 0 : distance(stops[j].end, stops[j + 1].start));
+                float after = distance(stops[i].end, stops[j].end)
+                            + (last ? 0 : distance(stops[i + 1].start, stops[j + 1].start));
+
+                if (after < before - 1e-4f) {
+                    std::reverse(stops.begin() + i + 1, stops.begin() + j + 1);
+
+                    for (size_t k = i + 1; k <= j; ++k) {
+                        std::swap(stops[k].start, stops[k].end);
+                        stops[k].reversed = !stops[k].reversed;
+                    }
+
+                    improved = true;
+                }
+            }
+        }
+
+        if (!improved) {
+            break;
+        }
+    }
+}
+
+
+/*
+ * Where the pen is, and whether it is down.
+ */
+typedef struct {
+    Point at;
+    bool down;
+} Pen;
+
+
+static void put_move(Output& out, const char *command, const Point& to) {
+    put_text(out, command);
+    put_text(out, " X");
+    put_coordinate(out, to.x);
+    put_text(out, " Y");
+    put_coordinate(out, to.y);
+}
+
+
+static void pen_up(Output& out, Pen& pen) {
+    if (pen.down) {
+        put_text(out, "G0 Z");
+        put_number(out, PEN_UP_Z);
+        put_char(out, '\n');
+        pen.down = false;
+    }
+}
+
+
+static void pen_down(Output& out, Pen& pen) {
+    if (!pen.down) {
+        put_text(out, "G1 Z");
+        put_number(out, PEN_DOWN_Z);
+        put_char(out, '\n');
+        pen.down = true;
+    }
+}
+
+
+/*
+ * The largest distance from some points along part of a curve to a line or circle;
+ * the curve is smooth, so a handful of points is enough once the parts are small.
+ */
+const int FIT_SAMPLES = 4;
+
+static float line_error(const Curve& curve, float t0, float t1, const Point& from, const Point& to) {
+    float dx = to.x - from.x, dy = to.y - from.y;
+    float length_squared = dx * dx + dy * dy;
+    float worst = 0;
+
+    for (int i = 0; i < FIT_SAMPLES; ++i) {
+        Point p = evaluate_curve(curve, t0 + (t1 - t0) * (i + 0.5f) / FIT_SAMPLES);
+
+        // The distance to the nearest point of the line itself, not of the line carried on past its ends,
+        // since a curve which doubles back beyond 'to' must not be drawn as a line that stops short of it
+        float along = length_squared > 0 ? ((p.x - from.x) * dx + (p.y - from.y) * dy) / length_squared : 0;
+        along = std::min(1.0f, std::max(0.0f, along));
+        worst = std::max(worst, distance(p, Point{from.x + dx * along, from.y + dy * along}));
+    }
+
+    return worst;
+}
+
+/*
+ * For an arc the points must also go round the circle in order, between 'from' and 'to',
+ * or G2/G3 would go the other (usually much longer) way round; parts where they don't are
+ * reported as not fitting at all, so that they get split.
+ */
+static float arc_error(const Curve& curve, float t0, float t1, const Point& centre, float radius,
+                       const Point& from, const Point& to, bool anticlockwise) {
+    const float FULL_TURN = 2 * (float) M_PI;
+
+    // How far round from 'from' a point is, in the direction the arc goes, from 0 to a full turn
+    auto around = [&](const Point& p) {
+        float angle = std::atan2(p.y - centre.y, p.x - centre.x) - std::atan2(from.y - centre.y, from.x - centre.x);
+        angle = std::fmod(anticlockwise ? angle : -angle, FULL_TURN);
+        return angle < 0 ? angle + FULL_TURN : angle;
+    };
+
+    float sweep = around(to);
+    float last = 0;
+    float worst = 0;
+
+    for (int i = 0; i < FIT_SAMPLES; ++i) {
+        Point p = evaluate_curve(curve, t0 + (t1 - t0) * (i + 0.5f) / FIT_SAMPLES);
+        float angle = around(p);
+
+        if (angle < last || angle > sweep) {
+            return INFINITY;
+        }
+
+        last = angle;
+        worst = std::max(worst, std::fabs(distance(p, centre) - radius));
+    }
+
+    return worst;
+}
+
+
+/*
+ * Draw part of a curve (already in page positions), from t0 to t1, as a line if that is close enough,
+ * otherwise as an arc of the circle through its ends and middle if that is, otherwise as two halves.
+ */
+static void plot_curve_part(Output& out, Pen& pen, const Curve& curve, float t0, float t1,
+                            const Point& from, const Point& to, bool arcs, int depth) {
+    if (depth == MAX_FIT_DEPTH || line_error(curve, t0, t1, from, to) <= GCODE_TOLERANCE) {
+        put_move(out, "G1", to);
+        put_char(out, '\n');
+        pen.at = to;
+        return;
+    }
+
+    float t_middle = (t0 + t1) / 2;
+    Point middle = evaluate_curve(curve, t_middle);
+
+    if (arcs) {
+        // The centre of the circle through three points is where the lines halfway between them meet.
+        // The machine only sees the ends as written, so start from those, and work in doubles,
+        // since nearly straight parts have huge circles
+        double from_x = rounded(from.x), from_y = rounded(from.y);
+        double ax = middle.x - from_x, ay = middle.y - from_y;
+        double bx = rounded(to.x) - from_x, by = rounded(to.y) - from_y;
+        double turn = 2 * (ax * by - ay * bx);
+
+        // (Arcs whose ends nearly meet are left to be split, since G2 and G3 would go all the way round)
+        if (std::fabs(turn) > 1e-9 && distance(from, to) > GCODE_TOLERANCE) {
+            double a_squared = ax * ax + ay * ay, b_squared = bx * bx + by * by;
+            double centre_x = (by * a_squared - ay * b_squared) / turn;     // From 'from', as I and J are
+            double centre_y = (ax * b_squared - bx * a_squared) / turn;
+            Point centre = Point{(float) (from_x + centre_x), (float) (from_y + centre_y)};
+            float radius = distance(centre, from);
+
+            // Turning left on the way through the middle means going anticlockwise
+            if (arc_error(curve, t0, t1, centre, radius, from, to, turn > 0) <= GCODE_TOLERANCE) {
+                put_move(out, turn > 0 ? "G3" : "G2", to);
+                put_text(out, " I");
+                put_number(out, (float) (std::nearbyint(centre_x * ARC_PRECISION) / ARC_PRECISION));
+                put_text(out, " J");
+                put_number(out, (float) (std::nearbyint(centre_y * ARC_PRECISION) / ARC_PRECISION));
+                put_char(out, '\n');
+                pen.at = to;
+                return;
+            }
+        }
+    }
+
+    plot_curve_part(out, pen, curve, t0, t_middle, from, middle, arcs, depth + 1);
+    plot_curve_part(out, pen, curve, t_middle, t1, middle, to, arcs, depth + 1);
+}
+
+
+static void write_gcode(Output& out, const std::vector<Curve>& curves, const bz_transform& transform,
+                        int width, int height, bool simplify, bool arcs) {
+    // The curves to plot; stops[0] is where the pen starts, in the corner
+    std::vector<Stop> stops;
+    stops.push_back(Stop{Point{0, 0}, Point{0, 0}, 0, false});
+
+    for (size_t i = 0; i < curves.size(); ++i) {
+        if (on_page(curves[i], transform, width, height)) {
+            stops.push_back(Stop{page_point(curves[i].p[0], transform),
+                                 page_point(curves[i].p[curves[i].degree], transform), i, false});
+        }
+    }
+
+    double travel_before = travel_distance(stops);
+
+    {
+        TRACE_SCOPE("nearest neighbour");
+        order_nearest_neighbour(stops);
+    }
+
+    double travel_nearest = travel_distance(stops);
+
+    {
+        TRACE_SCOPE("2-opt");
+        improve_two_opt(stops);
+    }
+
+    cerr << "Pen-up travel for " << stops.size() - 1 << " curves: " << travel_before << " mm in scene order, "
+         << travel_nearest << " mm after nearest neighbour, " << travel_distance(stops) << " mm after 2-opt" << endl;
+
+    put_text(out, "; ");
+    put_integer(out, stops.size() - 1);
+    put_text(out, " curves\nG21 ; millimetres\nG90 ; absolute positions\n");
+
+    Pen pen = {Point{0, 0}, true};
+    pen_up(out, pen);
+    put_text(out, "G1 F");
+    put_integer(out, DRAW_SPEED);
+    put_char(out, '\n');
+
+    for (size_t i = 1; i < stops.size(); ++i) {
+        const Stop& stop = stops[i];
+
+        // Carry straight on (with the pen down) when this curve starts where the last one finished,
+        // or so nearly that the gap can just be drawn over
+        if (!pen.down || distance(pen.at, stop.start) > GCODE_TOLERANCE) {
+            pen_up(out, pen);
+            put_move(out, "G0", stop.start);
+            put_char(out, '\n');
+            pen_down(out, pen);
+        } else if (rounded(pen.at.x) != rounded(stop.start.x) || rounded(pen.at.y) != rounded(stop.start.y)) {
+            put_move(out, "G1", stop.start);
+            put_char(out, '\n');
+        }
+
+        pen.at = stop.start;
+
+        // The curve in page positions, the right way round
+        Curve curve = curves[stop.curve];
+
+        for (int k = 0; k <= curve.degree; ++k) {
+            curve.p[k] = page_point(curve.p[k], transform);
+        }
+
+        if (stop.reversed) {
+            std::reverse(curve.p, curve.p + curve.degree + 1);
+        }
+
+        // (An identity transform, since the curve is already on the page)
+        CurveDetail detail = export_detail(curve, bz_transform{1, 1, 0, 0}, simplify);
+
+        if (detail == DETAIL_POINT) {
+            // Just a dot, made by lowering the pen; lift it again, rather than dragging it on to the next curve
+            pen_up(out, pen);
+            continue;
+        }
+
+        if (detail == DETAIL_LINE) {
+            put_move(out, "G1", stop.end);
+            put_char(out, '\n');
+            pen.at = stop.end;
+            continue;
+        }
+
+        plot_curve_part(out, pen, curve, 0, 1, stop.start, stop.end, arcs, 0);
+    }
+
+    pen_up(out, pen);
+    put_move(out, "G0", Point{0, 0});
+    put_char(out, '\n');
+}
+
+
+bool export_scene(const char *filename, ExportFormat format, const std::vector<Curve>& curves,
+                  const bz_transform& transform, int width, int height, bool simplify, bool arcs) {
+    TRACE_SCOPE("export");
+
+    // (The buffer is too big to keep on the stack)
+    Output *out = new Output;
+    out->file = fopen(filename, "wb");
+    out->used = 0;
+    out->written = 0;
+    out->failed = false;
+
+    if (!out->file) {
+        cerr << "Error: Could not create " << filename << endl;
+        delete out;
+        return false;
+    }
+
+    bz_transform upside_down = {transform.scale_x, -transform.scale_y, transform.offset_x, height - transform.offset_y};
+
+    if (format == EXPORT_SVG) {
+        write_svg(*out, curves, transform, width, height, simplify);
+    } else if (format == EXPORT_PDF) {
+        write_pdf(*out, curves, upside_down, width, height, simplify);
+    } else {
+        write_gcode(*out, curves, upside_down, width, height, simplify, arcs);
+    }
+
+    flush_output(*out);
+    bool closed = fclose(out->file) == 0;
+    bool ok = closed && !out->failed;
+
+    if (!ok) {
+        cerr << "Error: Could not write " << filename << endl;
+    }
+
+    delete out;
+    return ok;
+}
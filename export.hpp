@@ -0,0 +1,42 @@
+/*
+ * Saving the scene as a picture made of curves rather than pixels, which stays sharp at any size;
+ * an SVG file (for web browsers and drawing programs), a PDF file (for printing), or G-code
+ * (instructions for a pen plotter, which moves a pen around to draw each curve).
+ *
+ * The curves are saved as they would appear in a window of the same size; moved and scaled to
+ * page coordinates, leaving out any which are off the page. With 'simplify', curves which would
+ * only cover one pixel are saved as a one pixel dot, and nearly straight curves as a single line
+ * (see curve_detail in bezier.hpp), which makes huge zoomed-out scenes much smaller.
+ *
+ * For G-code, the curves are drawn in whichever order (and direction) keeps the pen's trips between
+ * them short, and each curve is made of arcs of circles, or with 'arcs' false only straight lines,
+ * staying within GCODE_TOLERANCE of the true curve.
+ *
+ * Big scenes mean millions of numbers, so they are written with std::to_chars, which gives the
+ * shortest text that reads back as exactly the same number, rather than with printf, which has
+ * to look at its format string and the locale for every single one.
+ */
+
+#ifndef EXPORT_HPP
+#define EXPORT_HPP
+
+#include <vector>
+
+#include "bezier.hpp"
+
+
+enum ExportFormat {
+    EXPORT_SVG,
+    EXPORT_PDF,
+    EXPORT_GCODE
+};
+
+
+/*
+ * Save the curves to a file, as seen through 'transform' on a page of width by height pixels.
+ * Returns false (after explaining why) if the file could not be written.
+ */
+bool export_scene(const char *filename, ExportFormat format, const std::vector<Curve>& curves,
+                  const bz_transform& transform, int width, int height, bool simplify, bool arcs);
+
+#endif
@@ -0,0 +1,646 @@
+/*
+ * libbezier; filling shapes, with smooth (anti-aliased) edges.
+ *
+ * The shape is a closed outline of straight lines (for instance, a tessellated curve
+ * joined back to where it started). Each pixel is coloured in proportion to how much
+ * of it is inside the shape, so edges fade smoothly instead of being jagged.
+ *
+ * Rather than working out, for every pixel, which lines cross it, every line leaves notes
+ * in a buffer of numbers with one for each pixel: "from here to the right, this much more
+ * of each pixel is inside". Each line going down adds, and each line going up subtracts,
+ * and a line which only partly covers a pixel leaves the exact area it covers. Adding the
+ * notes up along each row (a 'prefix sum') then gives exactly how much of each pixel is
+ * covered, with no need to sort the lines or keep lists of them.
+ *
+ * This is the 'signed area accumulation' method used by font-rs and stb_truetype.
+ * The adding up is done 4 pixels at a time with SIMD instructions.
+ *
+ * It needs a note for every pixel in the box around the shape, though, which for a big
+ * shape is a lot of memory to fill and read back, even where the shape is mostly empty space.
+ * So shapes with a lot of empty space in their box are drawn a second way, a row at a time
+ * (see 'Scanlines' below).
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "bezier.hpp"
+
+
+/*
+ * Four floats, which the compiler keeps together in one SSE or NEON register.
+ */
+typedef float quad_float __attribute__((vector_size(4 * sizeof(float))));
+typedef int32_t quad_int __attribute__((vector_size(4 * sizeof(int32_t))));
+
+
+/*
+ * Shapes are drawn a row at a time when at least this many pixels of the box around them are empty.
+ * Time spent on the notes goes up with the area of the box, full or not, but a row at a time only
+ * spends it where the shape is, so that way is several times quicker for big thin shapes; for shapes
+ * which mostly fill their box, it is only a little quicker, and the notes anti-alias more finely.
+ */
+const float SCANLINE_MIN_EMPTY = 128 * 128;
+
+
+/*
+ * The area notes for the part of the canvas which the shape covers.
+ * Row y, column x is at cells[y * stride + x], with two spare cells at the end of each row
+ * for lines which touch the right-hand edge.
+ */
+typedef struct {
+    float *cells;
+    int width;
+    int height;
+    int stride;
+} Accumulator;
+
+
+size_t bz_fill_buffer_size(int width, int height) {
+    return (size_t) (width + 2) * height;
+}
+
+
+/*
+ * Leave the notes for one line, which must be between x = 0 and x = width.
+ * Rows above and below the accumulator are skipped.
+ *
+ * In each row, the line covers some part of the row's height (row_dy). The pixels entirely
+ * to its right gain all of that, and the pixels it passes through gain the part of it which
+ * is to the right of the line; which is a trapezium, or a triangle at either end of a
+ * shallow line.
+ */
+static void accumulate_line(Accumulator& acc, float x0, float y0, float x1, float y1) {
+    if (y0 == y1) {
+        // Horizontal lines don't cover anything
+        return;
+    }
+
+    // Always walk downwards, remembering whether the line was really going up
+    float direction = 1;
+
+    if (y0 > y1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        direction = -1;
+    }
+
+    float dxdy = (x1 - x0) / (y1 - y0);
+    int row_start = (int) std::max(0.0f, std::floor(y0));
+    int row_end = (int) std::min((float) acc.height, std::ceil(y1));
+
+    // Where the line is at the top of the first row which we can see
+    float x = std::min(std::max(x0 + (std::max(y0, (float) row_start) - y0) * dxdy, 0.0f), (float) acc.width);
+
+    for (int y = row_start; y < row_end; ++y) {
+        float *row = acc.cells + (size_t) y * acc.stride;
+        float row_dy = std::min(y + 1.0f, y1) - std::max((float) y, y0);
+        // (Kept inside the accumulator, in case rounding has drifted just past the edge)
+        float x_next = std::min(std::max(x + dxdy * row_dy, 0.0f), (float) acc.width);
+        float d = row_dy * direction;
+
+        float left = std::min(x, x_next);
+        float right = std::max(x, x_next);
+        float left_floor = std::floor(left);
+        int left_i = (int) left_floor;
+        int right_i = (int) std::ceil(right);
+
+        if (right_i <= left_i + 1) {
+            // Within a single pixel; the part to the right of the line's middle is covered
+            float middle = 0.5f * (x + x_next) - left_floor;
+            row[left_i] += d - d * middle;
+            row[left_i + 1] += d * middle;
+        } else {
+            // Across several pixels; a triangle in the first, a triangle in the last,
+            // and an equal share for each one in between
+            float inv_width = 1 / (right - left);
+            float left_frac = left - left_floor;
+            float first = 0.5f * inv_width * (1 - left_frac) * (1 - left_frac);
+            float right_frac = right - right_i + 1;
+            float last = 0.5f * inv_width * right_frac * right_frac;
+
+            row[left_i] += d * first;
+
+            if (right_i == left_i + 2) {
+                row[left_i + 1] += d * (1 - first - last);
+            } else {
+                float second = inv_width * (1.5f - left_frac);
+                row[left_i + 1] += d * (second - first);
+
+                for (int xi = left_i + 2; xi < right_i - 1; ++xi) {
+                    row[xi] += d * inv_width;
+                }
+
+                float before_last = second + (right_i - left_i - 3) * inv_width;
+                row[right_i - 1] += d * (1 - before_last - last);
+            }
+
+            row[right_i] += d * last;
+        }
+
+        x = x_next;
+    }
+}
+
+
+/*
+ * Leave the notes for any line.
+ *
+ * Parts of the line to the left of the accumulator still count; every pixel in that row
+ * is to their right. So they are slid across onto the left-hand edge, after cutting the line
+ * where it crosses it. Parts to the right are slid onto the right-hand edge in the same way,
+ * where they only affect the spare cells.
+ */
+static void add_line(Accumulator& acc, float x0, float y0, float x1, float y1) {
+    if (x0 >= 0 && x1 >= 0 && x0 <= acc.width && x1 <= acc.width) {
+        accumulate_line(acc, x0, y0, x1, y1);
+        return;
+    }
+
+    // Where (from 0 to 1 along the line) to cut it
+    float cuts[4] = {0, 0, 0, 1};
+    int cut_count = 1;
+
+    if (x0 != x1) {
+        float edges[2] = {0, (float) acc.width};
+
+        for (int edge = 0; edge < 2; ++edge) {
+            float t = (edges[edge] - x0) / (x1 - x0);
+
+            if (t > 0 && t < 1) {
+                cuts[cut_count++] = t;
+            }
+        }
+    }
+
+    cuts[cut_count++] = 1;
+    std::sort(cuts, cuts + cut_count);
+
+    for (int i = 0; i + 1 < cut_count; ++i) {
+        float from_x = x0 + cuts[i] * (x1 - x0);
+        float to_x = x0 + cuts[i + 1] * (x1 - x0);
+
+        accumulate_line(acc,
+                        std::min(std::max(from_x, 0.0f), (float) acc.width), y0 + cuts[i] * (y1 - y0),
+                        std::min(std::max(to_x, 0.0f), (float) acc.width), y0 + cuts[i + 1] * (y1 - y0));
+    }
+}
+
+
+/*
+ * Mix a colour into a pixel, by how much of the pixel is covered.
+ */
+static inline uint32_t blend(uint32_t under, uint32_t colour, float coverage) {
+    if (coverage >= 1) {
+        return colour;
+    }
+
+    uint32_t result = 0xff000000u;
+
+    for (int shift = 0; shift < 24; shift += 8) {
+        float from = (under >> shift) & 0xff;
+        float to = (colour >> shift) & 0xff;
+        result |= (uint32_t) (from + (to - from) * coverage + 0.5f) << shift;
+    }
+
+    return result;
+}
+
+
+/*
+ * Add up 4 notes at once, carrying on from the total so far.
+ * Shifting the four along by one place and adding, then by two places and adding,
+ * leaves each one holding the sum of itself and everything before it.
+ */
+static inline quad_float prefix_sum(quad_float notes, float carry) {
+    quad_float zero = {};
+    notes += __builtin_shufflevector(zero, notes, 0, 4, 5, 6);
+    notes += __builtin_shufflevector(zero, notes, 0, 1, 4, 5);
+    return notes + carry;
+}
+
+
+/*
+ * How much of each pixel is inside, from the added-up notes.
+ *
+ * The total is the 'winding number'; how many more times the outline goes round the pixel
+ * one way than the other, blurred between whole numbers at the edges. With the non-zero rule
+ * anything but 0 is inside. With the even-odd rule, odd numbers are inside and even ones are
+ * outside, so a shape drawn inside another one cuts a hole in it.
+ */
+static inline quad_float coverage_for(quad_float sums, bz_fill_rule rule) {
+    quad_float coverage = sums < 0 ? -sums : sums;
+
+    if (rule == BZ_FILL_EVEN_ODD) {
+        // How far past the last even number, folded back down after each odd one
+        quad_float pairs = __builtin_convertvector(__builtin_convertvector(coverage * 0.5f, quad_int), quad_float);
+        coverage -= 2 * pairs;
+        return coverage > 1 ? 2 - coverage : coverage;
+    }
+
+    return coverage > 1 ? 1 : coverage;
+}
+
+
+/*
+ * Turn one row of notes, from 'from' up to (not including) 'to', into pixels,
+ * and set the notes back to zero ready for the next shape.
+ */
+static void resolve_row(float *row, uint32_t *pixels, int from, int to, bz_fill_rule rule, uint32_t colour) {
+    float total = 0;
+    int x = from;
+
+    for (; x + 4 <= to; x += 4) {
+        quad_float notes;
+        memcpy(&notes, row + x, sizeof(notes));
+        memset(row + x, 0, sizeof(notes));
+
+        quad_float sums = prefix_sum(notes, total);
+        total = sums[3];
+
+        quad_float coverage = coverage_for(sums, rule);
+
+        for (int lane = 0; lane < 4; ++lane) {
+            if (coverage[lane] > 0) {
+                pixels[x + lane] = blend(pixels[x + lane], colour, coverage[lane]);
+            }
+        }
+    }
+
+    // The last few pixels, with 0s after them
+    if (x < to) {
+        quad_float notes = {};
+        memcpy(&notes, row + x, (to - x) * sizeof(float));
+        memset(row + x, 0, (to - x) * sizeof(float));
+
+        quad_float coverage = coverage_for(prefix_sum(notes, total), rule);
+
+        for (int lane = 0; x + lane < to; ++lane) {
+            if (coverage[lane] > 0) {
+                pixels[x + lane] = blend(pixels[x + lane], colour, coverage[lane]);
+            }
+        }
+    }
+}
+
+
+/*
+ * Turn the notes into pixels, and set them back to zero ready for the next shape.
+ */
+static void resolve(Accumulator& acc, bz_canvas *canvas, int left, int top, bz_fill_rule rule, uint32_t colour) {
+    for (int y = 0; y < acc.height; ++y) {
+        float *row = acc.cells + (size_t) y * acc.stride;
+        resolve_row(row, canvas->pixels + (size_t) (top + y) * canvas->pitch + left, 0, acc.width, rule, colour);
+
+        // The spare cells too
+        std::fill(row + acc.width, row + acc.stride, 0.0f);
+    }
+}
+
+
+/*
+ * Scanlines.
+ *
+ * Instead of a note for every pixel in the box, this only keeps one row of notes, and a list
+ * of the shape's edges. Each row of pixels is sampled along SAMPLES_PER_ROW horizontal lines
+ * (the 'scanlines'); on each one, we find where the edges cross it, sort the crossings from
+ * left to right, and count the winding number up and down between them to find the stretches
+ * (the 'spans') which are inside. Each span leaves two notes, where it starts and where it ends,
+ * and only the part of the row between the first and last span is ever looked at.
+ *
+ * The edges are sorted by where they start, so that each scanline only has to think about
+ * the 'active' edges which cross it. Edges are added to the active list as the scanlines
+ * reach their tops, and dropped once they pass their bottoms.
+ *
+ * The edges are sorted with a 'radix sort'; sorting by the lowest 8 bits of each edge's
+ * first scanline, then the next 8 bits, and so on, which takes a fixed number of passes
+ * rather than comparing edges with each other.
+ *
+ * Sampling a few scanlines per row means that the anti-aliasing is exact across the row,
+ * but only SAMPLES_PER_ROW levels deep up and down it.
+ */
+const int SAMPLES_PER_ROW = 4;
+
+
+typedef struct {
+    float x;            // Where the edge crosses its first scanline
+    float dxdy;         // How far it moves across for each scanline
+    uint32_t first;     // The first and last scanlines which it crosses, counting from the top of the canvas
+    uint32_t last;
+    int winding;        // 1 going down, -1 going up
+} Edge;
+
+
+typedef struct {
+    float x;            // Where the edge crosses the current scanline
+    uint32_t edge;
+} Crossing;
+
+
+size_t bz_scanline_buffer_size(int width, size_t count) {
+    return (width + 2) * sizeof(float) + count * (2 * sizeof(Edge) + sizeof(Crossing));
+}
+
+
+/*
+ * Sort the edges by their first scanline.
+ * Each pass counts how many edges have each value of one byte of the key, which says where
+ * each value's edges start in the output; then every edge is copied to its place, in the same
+ * order as they were in. The sorted edges end up back in 'edges'.
+ */
+static void radix_sort(Edge *edges, Edge *spare, size_t count, uint32_t max_key) {
+    Edge *from = edges;
+    Edge *to = spare;
+
+    for (int shift = 0; shift < 32 && (max_key >> shift) != 0; shift += 8) {
+        size_t starts[257] = {};
+
+        for (size_t i = 0; i < count; ++i) {
+            ++starts[((from[i].first >> shift) & 0xff) + 1];
+        }
+
+        for (int value = 0; value < 256; ++value) {
+            starts[value + 1] += starts[value];
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            to[starts[(from[i].first >> shift) & 0xff]++] = from[i];
+        }
+
+        std::swap(from, to);
+    }
+
+    if (from != edges) {
+        std::copy(from, from + count, edges);
+    }
+}
+
+
+/*
+ * Leave the notes for one span of one scanline; weight at its start, and the same taken away at its end,
+ * each shared between the two pixels nearest to it.
+ */
+static inline void add_span(float *row, float start, float end, float weight) {
+    float start_floor = std::floor(start);
+    float start_frac = start - start_floor;
+    row[(int) start_floor] += weight * (1 - start_frac);
+    row[(int) start_floor + 1] += weight * start_frac;
+
+    float end_floor = std::floor(end);
+    float end_frac = end - end_floor;
+    row[(int) end_floor] -= weight * (1 - end_frac);
+    row[(int) end_floor + 1] -= weight * end_frac;
+}
+
+
+static inline bool inside(int winding, bz_fill_rule rule) {
+    return rule == BZ_FILL_EVEN_ODD ? (winding & 1) != 0 : winding != 0;
+}
+
+
+void bz_fill_polygon_scanline(bz_canvas *canvas, void *buffer, const bz_transform *transform,
+                              const bz_point *points, size_t count, bz_fill_rule rule, uint32_t colour) {
+    if (count < 3 || canvas->width <= 0 || canvas->height <= 0) {
+        return;
+    }
+
+    // Share out the buffer
+    float *row = (float *) buffer;
+    Edge *edges = (Edge *) (row + canvas->width + 2);
+    Edge *spare = edges + count;
+    Crossing *active = (Crossing *) (spare + count);
+
+    const float scanlines = (float) canvas->height * SAMPLES_PER_ROW;
+    const float width = canvas->width;
+    size_t edge_count = 0;
+    uint32_t max_first = 0;
+
+    // Every line, including the one from the last point back to the first, which crosses a scanline
+    for (size_t i = 0; i < count; ++i) {
+        const bz_point& from = points[i];
+        const bz_point& to = points[(i + 1) % count];
+
+        float x0 = from.x * transform->scale_x + transform->offset_x;
+        float y0 = (from.y * transform->scale_y + transform->offset_y) * SAMPLES_PER_ROW;
+        float x1 = to.x * transform->scale_x + transform->offset_x;
+        float y1 = (to.y * transform->scale_y + transform->offset_y) * SAMPLES_PER_ROW;
+        int winding = 1;
+
+        if (y0 > y1) {
+            std::swap(x0, x1);
+            std::swap(y0, y1);
+            winding = -1;
+        }
+
+        // Scanline j is at j + 0.5, and the line covers y0 <= y < y1
+        float first = std::max(0.0f, std::ceil(y0 - 0.5f));
+        float last = std::min(scanlines - 1, std::ceil(y1 - 0.5f) - 1);
+
+        if (!(first <= last)) {
+            continue;
+        }
+
+        Edge& edge = edges[edge_count++];
+        edge.dxdy = (x1 - x0) / (y1 - y0);
+        edge.x = x0 + (first + 0.5f - y0) * edge.dxdy;
+        edge.first = (uint32_t) first;
+        edge.last = (uint32_t) last;
+        edge.winding = winding;
+        max_first = std::max(max_first, edge.first);
+    }
+
+    if (edge_count == 0) {
+        return;
+    }
+
+    radix_sort(edges, spare, edge_count, max_first);
+
+    const float weight = 1.0f / SAMPLES_PER_ROW;
+    size_t next_edge = 0;
+    size_t active_count = 0;
+    int row_from = canvas->width + 2;
+    int row_to = 0;
+    uint32_t scanline = edges[0].first;
+
+    while (active_count > 0 || next_edge < edge_count) {
+        // Drop the edges which ended above this scanline, and add the ones which start on it
+        size_t kept = 0;
+
+        for (size_t i = 0; i < active_count; ++i) {
+            if (edges[active[i].edge].last >= scanline) {
+                active[kept++] = active[i];
+            }
+        }
+
+        active_count = kept;
+
+        while (next_edge < edge_count && edges[next_edge].first <= scanline) {
+            active[active_count++] = Crossing{0, (uint32_t) next_edge++};
+        }
+
+        // Where each edge crosses this scanline, from left to right. They were in order on the
+        // last scanline, and edges rarely cross each other, so this is nearly sorted already
+        // and sorting by insertion hardly has to move anything.
+        for (size_t i = 0; i < active_count; ++i) {
+            const Edge& edge = edges[active[i].edge];
+            float x = edge.x + (float) (scanline - edge.first) * edge.dxdy;
+            active[i].x = std::min(std::max(x, 0.0f), width);
+        }
+
+        for (size_t i = 1; i < active_count; ++i) {
+            Crossing crossing = active[i];
+            size_t j = i;
+
+            for (; j > 0 && active[j - 1].x > crossing.x; --j) {
+                active[j] = active[j - 1];
+            }
+
+            active[j] = crossing;
+        }
+
+        // Count the winding number across the scanline, and note down each span which is inside
+        int winding = 0;
+        float span_start = 0;
+
+        for (size_t i = 0; i < active_count; ++i) {
+            bool was_inside = inside(winding, rule);
+            winding += edges[active[i].edge].winding;
+            bool now_inside = inside(winding, rule);
+
+            if (!was_inside && now_inside) {
+                span_start = active[i].x;
+            } else if (was_inside && !now_inside && active[i].x > span_start) {
+                add_span(row, span_start, active[i].x, weight);
+                row_from = std::min(row_from, (int) span_start);
+                row_to = std::max(row_to, (int) active[i].x + 2);
+            }
+        }
+
+        // Skip straight past any gap with no edges at all
+        uint32_t next = scanline + 1;
+
+        if (active_count == 0 && next_edge < edge_count) {
+            next = edges[next_edge].first;
+        }
+
+        // Once the row's scanlines are done, turn its notes into pixels
+        int y = scanline / SAMPLES_PER_ROW;
+
+        if (next / SAMPLES_PER_ROW != (uint32_t) y || (active_count == 0 && next_edge == edge_count)) {
+            if (row_from < row_to) {
+                uint32_t *pixels = canvas->pixels + (size_t) y * canvas->pitch;
+                resolve_row(row, pixels, row_from, std::min(row_to, canvas->width), rule, colour);
+                std::fill(row + std::min(row_to, canvas->width), row + row_to, 0.0f);
+            }
+
+            row_from = canvas->width + 2;
+            row_to = 0;
+        }
+
+        scanline = next;
+    }
+}
+
+
+/*
+ * How a shape is going to be filled: the part of the canvas which its box covers, whether it goes
+ * a row at a time, and how many bytes of buffer that needs. 'visible' is false if none of it is on the canvas.
+ */
+typedef struct {
+    bool visible;
+    bool scanline;
+    int left, top, right, bottom;
+    size_t bytes;
+} FillPlan;
+
+
+static FillPlan plan_fill(const bz_canvas *canvas, const bz_transform *transform, const bz_point *points, size_t count) {
+    FillPlan plan = {};
+
+    if (count < 3) {
+        return plan;
+    }
+
+    // Only the part of the canvas which the shape covers needs any notes.
+    // The shape's own area is found on the way (twice over, by the 'shoelace formula'),
+    // to see how much of that is empty
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    float last_x = points[count - 1].x * transform->scale_x + transform->offset_x;
+    float last_y = points[count - 1].y * transform->scale_y + transform->offset_y;
+    float twice_area = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        float x = points[i].x * transform->scale_x + transform->offset_x;
+        float y = points[i].y * transform->scale_y + transform->offset_y;
+        min_x = std::min(min_x, x);
+        max_x = std::max(max_x, x);
+        min_y = std::min(min_y, y);
+        max_y = std::max(max_y, y);
+        twice_area += last_x * y - x * last_y;
+        last_x = x;
+        last_y = y;
+    }
+
+    if (!(max_x > 0 && max_y > 0 && min_x < canvas->width && min_y < canvas->height)) {
+        return plan;
+    }
+
+    plan.visible = true;
+    plan.left = (int) std::max(0.0f, std::floor(min_x));
+    plan.top = (int) std::max(0.0f, std::floor(min_y));
+    plan.right = (int) std::min((float) canvas->width, std::ceil(max_x));
+    plan.bottom = (int) std::min((float) canvas->height, std::ceil(max_y));
+
+    // Big, mostly empty shapes are quicker a row at a time, as long as their edges take less memory than the notes would.
+    // (Where the outline crosses itself the area partly cancels out, which only makes the shape look emptier)
+    size_t notes_size = (size_t) (plan.right - plan.left + 2) * (plan.bottom - plan.top) * sizeof(float);
+    size_t scanline_size = bz_scanline_buffer_size(canvas->width, count);
+
+    plan.scanline = (max_x - min_x) * (max_y - min_y) - 0.5f * std::fabs(twice_area) >= SCANLINE_MIN_EMPTY
+                    && scanline_size <= notes_size;
+    plan.bytes = plan.scanline ? scanline_size : notes_size;
+    return plan;
+}
+
+
+size_t bz_fill_polygon_size(const bz_canvas *canvas, const bz_transform *transform, const bz_point *points, size_t count) {
+    return plan_fill(canvas, transform, points, count).bytes;
+}
+
+
+void bz_fill_polygon(bz_canvas *canvas, float *buffer, const bz_transform *transform,
+                     const bz_point *points, size_t count, bz_fill_rule rule, uint32_t colour) {
+    FillPlan plan = plan_fill(canvas, transform, points, count);
+
+    if (!plan.visible) {
+        return;
+    }
+
+    // Only the part of the buffer which the scanlines use for notes is left at zero, so the rest is cleared
+    if (plan.scanline) {
+        size_t notes_size = (canvas->width + 2) * sizeof(float);
+
+        bz_fill_polygon_scanline(canvas, buffer, transform, points, count, rule, colour);
+        memset((char *) buffer + notes_size, 0, plan.bytes - notes_size);
+        return;
+    }
+
+    int left = plan.left, top = plan.top, right = plan.right, bottom = plan.bottom;
+
+    Accumulator acc = {buffer, right - left, bottom - top, right - left + 2};
+
+    // Every line, including the one from the last point back to the first
+    for (size_t i = 0; i < count; ++i) {
+        const bz_point& from = points[i];
+        const bz_point& to = points[(i + 1) % count];
+
+        add_line(acc,
+                 from.x * transform->scale_x + transform->offset_x - left,
+                 from.y * transform->scale_y + transform->offset_y - top,
+                 to.x * transform->scale_x + transform->offset_x - left,
+                 to.y * transform->scale_y + transform->offset_y - top);
+    }
+
+    resolve(acc, canvas, left, top, rule, colour);
+}
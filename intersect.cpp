@@ -0,0 +1,481 @@
+/*
+ * libbezier; where straight lines cross curves.
+ *
+ * Turning the picture round so that the line lies along the x axis, the line crosses a curve
+ * wherever the curve's y is 0. Rather than actually turning anything, we work out how far
+ * each control point is from the line (using the 'cross product', as curve_detail does);
+ * those distances are the control points of a curve of the distance from the line, and the
+ * crossings are wherever that is zero. It is a polynomial in t (quadratic or cubic), and
+ * finding its roots gives the crossings.
+ *
+ * Cubic polynomials can be solved with a formula, but it needs cube roots and cosines, which
+ * don't work 4 at a time in SIMD registers. Instead we find where the distance stops going up
+ * and starts going down (where its slope, a quadratic, is zero; that needs only a square root),
+ * which splits the curve into at most three parts which each cross the line at most once, and
+ * then narrow each crossing down by halving the part it is in, finishing off with Newton's method.
+ * Every curve takes exactly the same steps, so 4 curves are solved at once, one in each SIMD lane.
+ *
+ * To avoid solving for every curve in the scene, the curves are kept in a 'bounding volume
+ * hierarchy' (BVH); a tree of boxes, each around everything beneath it, with up to 4 curves in
+ * each box at the bottom. A line which misses a box misses everything in it, and once a crossing
+ * has been found, boxes further away than it can be skipped too.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "bezier.hpp"
+
+
+typedef float quad_float __attribute__((vector_size(4 * sizeof(float))));
+typedef int32_t quad_int __attribute__((vector_size(4 * sizeof(int32_t))));
+
+
+/*
+ * How many times each part of a curve is halved, and then improved with Newton's method.
+ * 8 halvings leave the crossing within 1/256 of the part; each Newton step then roughly squares
+ * the error. Where the curve is nearly parallel to the line, Newton's method can overshoot, and
+ * those steps halve the part again instead, so a few more are needed than floats would suggest.
+ */
+const int BISECTION_STEPS = 8;
+const int NEWTON_STEPS = 4;
+
+
+/*
+ * The deepest a BVH can be; each level halves the curves, so this is far more than enough.
+ */
+const int MAX_BVH_DEPTH = 64;
+
+
+size_t bz_bvh_nodes(size_t count) {
+    return count > 0 ? 2 * count - 1 : 1;
+}
+
+
+/*
+ * The box around a curve's control points, which the curve never leaves.
+ */
+static void control_box(const bz_curve& curve, float *min_x, float *min_y, float *max_x, float *max_y) {
+    *min_x = *max_x = curve.p[0].x;
+    *min_y = *max_y = curve.p[0].y;
+
+    for (int i = 1; i <= curve.degree; ++i) {
+        *min_x = std::min(*min_x, curve.p[i].x);
+        *max_x = std::max(*max_x, curve.p[i].x);
+        *min_y = std::min(*min_y, curve.p[i].y);
+        *max_y = std::max(*max_y, curve.p[i].y);
+    }
+}
+
+
+/*
+ * Build the tree from the top down. Each box's curves are split in two at the middle one along
+ * the box's longer side (sorting them only as far as finding that middle, with nth_element),
+ * until there are few enough to go in one box at the bottom. The two halves' boxes are always
+ * next to each other in 'nodes', so each box only needs to know where the first one is.
+ */
+bz_bvh bz_bvh_build(const bz_curve *curves, size_t count, bz_bvh_node *nodes, uint32_t *order) {
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = (uint32_t) i;
+    }
+
+    bz_bvh bvh = {nodes, order, 1, curves};
+    nodes[0] = bz_bvh_node{0, 0, 0, 0, 0, (uint32_t) count};
+
+    // The boxes still to be split, as indexes into 'nodes'
+    uint32_t pending[MAX_BVH_DEPTH];
+    int pending_count = 0;
+    pending[pending_count++] = 0;
+
+    while (pending_count > 0) {
+        bz_bvh_node& node = nodes[pending[--pending_count]];
+        uint32_t first = node.first;
+        uint32_t node_curves = node.count;
+
+        float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+
+        for (uint32_t i = first; i < first + node_curves; ++i) {
+            float curve_min_x, curve_min_y, curve_max_x, curve_max_y;
+            control_box(curves[order[i]], &curve_min_x, &curve_min_y, &curve_max_x, &curve_max_y);
+            min_x = std::min(min_x, curve_min_x);
+            min_y = std::min(min_y, curve_min_y);
+            max_x = std::max(max_x, curve_max_x);
+            max_y = std::max(max_y, curve_max_y);
+        }
+
+        node.min_x = min_x;
+        node.min_y = min_y;
+        node.max_x = max_x;
+        node.max_y = max_y;
+
+        if (node_curves <= BZ_BVH_LEAF_SIZE || pending_count + 2 > MAX_BVH_DEPTH) {
+            continue;
+        }
+
+        // Sort by the middle of each curve's box, across or down
+        bool across = max_x - min_x >= max_y - min_y;
+        uint32_t half = node_curves / 2;
+
+        std::nth_element(order + first, order + first + half, order + first + node_curves,
+                         [curves, across](uint32_t a, uint32_t b) {
+            float a_min_x, a_min_y, a_max_x, a_max_y, b_min_x, b_min_y, b_max_x, b_max_y;
+            control_box(curves[a], &a_min_x, &a_min_y, &a_max_x, &a_max_y);
+            control_box(curves[b], &b_min_x, &b_min_y, &b_max_x, &b_max_y);
+            return across ? a_min_x + a_max_x < b_min_x + b_max_x : a_min_y + a_max_y < b_min_y + b_max_y;
+        });
+
+        uint32_t children = (uint32_t) bvh.node_count;
+        bvh.node_count += 2;
+
+        nodes[children] = bz_bvh_node{0, 0, 0, 0, first, half};
+        nodes[children + 1] = bz_bvh_node{0, 0, 0, 0, first + half, node_curves - half};
+
+        // (node is a reference into 'nodes', which has only been added to, so it is still good)
+        node.first = children;
+        node.count = 0;
+
+        pending[pending_count++] = children;
+        pending[pending_count++] = children + 1;
+    }
+
+    return bvh;
+}
+
+
+/*
+ * The polynomial a t^3 + b t^2 + c t + d for 4 curves at once, and its slope.
+ */
+typedef struct {
+    quad_float a, b, c, d;
+} Cubic;
+
+static inline quad_float evaluate(const Cubic& f, quad_float t) {
+    return ((f.a * t + f.b) * t + f.c) * t + f.d;
+}
+
+static inline quad_float slope(const Cubic& f, quad_float t) {
+    return (3 * f.a * t + 2 * f.b) * t + f.c;
+}
+
+
+/*
+ * The polynomial for a cubic curve's control points p0 to p3 (one coordinate each, or the
+ * distances from the line). A quadratic curve is the same as the cubic whose middle control points
+ * are two thirds of the way from its ends to its middle one, so everything can be treated as cubic.
+ */
+static inline Cubic power_basis(quad_float p0, quad_float p1, quad_float p2, quad_float p3) {
+    return Cubic{p3 - 3 * p2 + 3 * p1 - p0, 3 * (p2 - 2 * p1 + p0), 3 * (p1 - p0), p0};
+}
+
+
+static inline quad_float select(quad_int mask, quad_float yes, quad_float no) {
+    return mask ? yes : no;
+}
+
+
+static inline bool any(quad_int mask) {
+    return mask[0] | mask[1] | mask[2] | mask[3];
+}
+
+
+/*
+ * Square roots, 4 at a time (the compiler turns this into a single instruction).
+ */
+static inline quad_float square_root(quad_float x) {
+    quad_float result = {};
+
+    for (int lane = 0; lane < 4; ++lane) {
+        result[lane] = __builtin_sqrtf(x[lane]);
+    }
+
+    return result;
+}
+
+
+/*
+ * Find where a ray crosses up to 4 curves, order[first] onwards,
+ * calling found(distance along the ray, t, curve) for each crossing.
+ */
+template <typename Found>
+static void intersect_four(const bz_bvh& bvh, uint32_t first, uint32_t count, const bz_ray& ray, float max_distance,
+                           Found found) {
+    quad_float x[4] = {}, y[4] = {};
+
+    for (int lane = 0; lane < 4; ++lane) {
+        if ((uint32_t) lane >= count) {
+            // Empty lanes get a curve which stays a long way from the line, so they never cross it
+            for (int i = 0; i < 4; ++i) {
+                x[i][lane] = ray.origin.x - ray.direction.y;
+                y[i][lane] = ray.origin.y + ray.direction.x;
+            }
+
+            continue;
+        }
+
+        const bz_curve& curve = bvh.curves[bvh.order[first + lane]];
+
+        if (curve.degree == 2) {
+            Point middle_from_start = lerp(2.0f / 3, curve.p[0], curve.p[1]);
+            Point middle_from_end = lerp(2.0f / 3, curve.p[2], curve.p[1]);
+            x[0][lane] = curve.p[0].x;        y[0][lane] = curve.p[0].y;
+            x[1][lane] = middle_from_start.x; y[1][lane] = middle_from_start.y;
+            x[2][lane] = middle_from_end.x;   y[2][lane] = middle_from_end.y;
+            x[3][lane] = curve.p[2].x;        y[3][lane] = curve.p[2].y;
+        } else {
+            for (int i = 0; i < 4; ++i) {
+                x[i][lane] = curve.p[i].x;
+                y[i][lane] = curve.p[i].y;
+            }
+        }
+    }
+
+    // How far each control point is to the left of the line (times the length of 'direction')
+    quad_float e[4];
+
+    for (int i = 0; i < 4; ++i) {
+        e[i] = ray.direction.x * (y[i] - ray.origin.y) - ray.direction.y * (x[i] - ray.origin.x);
+    }
+
+    // And how far along the ray each one is
+    float direction_squared = ray.direction.x * ray.direction.x + ray.direction.y * ray.direction.y;
+    quad_float a[4];
+
+    for (int i = 0; i < 4; ++i) {
+        a[i] = ((x[i] - ray.origin.x) * ray.direction.x + (y[i] - ray.origin.y) * ray.direction.y) / direction_squared;
+    }
+
+    // A curve whose control points are all on one side of the line can't cross it,
+    // and one whose control points are all behind the ray's start, or all past its end, can't cross the ray
+    quad_int all_left = (e[0] > 0) & (e[1] > 0) & (e[2] > 0) & (e[3] > 0);
+    quad_int all_right = (e[0] < 0) & (e[1] < 0) & (e[2] < 0) & (e[3] < 0);
+    quad_int all_behind = (a[0] < 0) & (a[1] < 0) & (a[2] < 0) & (a[3] < 0);
+    quad_int all_past = (a[0] > max_distance) & (a[1] > max_distance) & (a[2] > max_distance) & (a[3] > max_distance);
+    quad_int missed = all_left | all_right | all_behind | all_past;
+
+    if (!any(~missed)) {
+        return;
+    }
+
+    Cubic f = power_basis(e[0], e[1], e[2], e[3]);
+
+    // Where the slope 3a t^2 + 2b t + c is zero, worked out in the way which loses the least precision.
+    // Anything which isn't between 0 and 1 (or doesn't exist) becomes 1, which just makes an empty part.
+    quad_float qa = 3 * f.a, qb = 2 * f.b, qc = f.c;
+    quad_float discriminant = qb * qb - 4 * qa * qc;
+    quad_float root = square_root(select(discriminant > 0, discriminant, quad_float{} + 0));
+    quad_float q = -0.5f * (qb + select(qb < 0, -root, root));
+    quad_float turn0 = qc / q;
+    quad_float turn1 = q / qa;
+
+    turn0 = select((discriminant >= 0) & (turn0 > 0) & (turn0 < 1), turn0, quad_float{} + 1);
+    turn1 = select((discriminant >= 0) & (turn1 > 0) & (turn1 < 1), turn1, quad_float{} + 1);
+
+    quad_float bounds[4] = {quad_float{} + 0, turn0 < turn1 ? turn0 : turn1, turn0 < turn1 ? turn1 : turn0,
+                            quad_float{} + 1};
+
+    // How far along the ray each point on the curve is
+    Cubic along_curve = power_basis(a[0], a[1], a[2], a[3]);
+
+    // The three parts are independent, so they are narrowed down side by side;
+    // each step has to wait for the one before, but the CPU can work on all three parts at once
+    quad_float low[3], high[3];
+    quad_int crosses[3], rising[3];
+    quad_int any_crosses = quad_int{};
+
+    for (int part = 0; part < 3; ++part) {
+        low[part] = bounds[part];
+        high[part] = bounds[part + 1];
+        quad_float f_low = evaluate(f, low[part]), f_high = evaluate(f, high[part]);
+
+        // The distance goes only one way within each part, so it crosses zero if the ends differ in sign.
+        // (A crossing exactly at a part's start is left to the part before, so it isn't found twice.)
+        crosses[part] = ~missed & (low[part] < high[part])
+                      & (((f_low < 0) & (f_high >= 0)) | ((f_low > 0) & (f_high <= 0)) | (part == 0 ? f_low == 0 : quad_int{}));
+        rising[part] = f_low < f_high;
+        any_crosses |= crosses[part];
+    }
+
+    if (!any(any_crosses)) {
+        return;
+    }
+
+    for (int step = 0; step < BISECTION_STEPS; ++step) {
+        for (int part = 0; part < 3; ++part) {
+            quad_float middle = (low[part] + high[part]) * 0.5f;
+            quad_int below = evaluate(f, middle) < 0;
+            quad_int move_low = rising[part] ? below : ~below;
+            low[part] = select(move_low, middle, low[part]);
+            high[part] = select(move_low, high[part], middle);
+        }
+    }
+
+    quad_float t[3];
+
+    for (int part = 0; part < 3; ++part) {
+        t[part] = (low[part] + high[part]) * 0.5f;
+    }
+
+    // Newton's method can step outside the part (where the slope is nearly flat), so each step
+    // also keeps narrowing the part, and halves it instead wherever Newton's step would leave it
+    for (int step = 0; step < NEWTON_STEPS; ++step) {
+        for (int part = 0; part < 3; ++part) {
+            quad_float value = evaluate(f, t[part]);
+            quad_int below = value < 0;
+            quad_int move_low = rising[part] ? below : ~below;
+            low[part] = select(move_low, t[part], low[part]);
+            high[part] = select(move_low, high[part], t[part]);
+
+            quad_float d = slope(f, t[part]);
+            quad_float better = t[part] - value / d;
+            quad_int inside = (d != 0) & (better >= low[part]) & (better <= high[part]);
+            t[part] = select(inside, better, (low[part] + high[part]) * 0.5f);
+        }
+    }
+
+    for (int part = 0; part < 3; ++part) {
+        quad_float along = evaluate(along_curve, t[part]);
+        quad_int hit = crosses[part] & (along >= 0) & (along <= max_distance);
+
+        for (int lane = 0; lane < 4; ++lane) {
+            if (hit[lane]) {
+                found(along[lane], t[part][lane], bvh.order[first + lane]);
+            }
+        }
+    }
+}
+
+
+/*
+ * The same for every curve in a box at the bottom of the tree (which normally has no more than 4).
+ */
+template <typename Found>
+static void intersect_leaf(const bz_bvh& bvh, const bz_bvh_node& leaf, const bz_ray& ray, float max_distance,
+                           Found found) {
+    for (uint32_t done = 0; done < leaf.count; done += 4) {
+        intersect_four(bvh, leaf.first + done, std::min(leaf.count - done, 4u), ray, max_distance, found);
+    }
+}
+
+
+/*
+ * Where a ray enters and leaves a box, as distances along it ('slabs': the distances between
+ * which it is between the box's left and right sides, and between its top and bottom sides,
+ * overlapped). Returns false if it misses, or only meets the box beyond max_distance.
+ */
+static inline bool ray_meets_box(const bz_bvh_node& node, const bz_point& origin, const bz_point& inverse,
+                                 float max_distance, float *enter) {
+    float x0 = (node.min_x - origin.x) * inverse.x, x1 = (node.max_x - origin.x) * inverse.x;
+    float y0 = (node.min_y - origin.y) * inverse.y, y1 = (node.max_y - origin.y) * inverse.y;
+
+    float near = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), 0.0f);
+    float far = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), max_distance);
+
+    *enter = near;
+    return near <= far;
+}
+
+
+/*
+ * Go down the tree, calling visit_leaf for each box at the bottom which the ray meets,
+ * nearest boxes first. visit_leaf returns the distance beyond which nothing is wanted any more.
+ */
+template <typename VisitLeaf>
+static void walk_bvh(const bz_bvh& bvh, const bz_ray& ray, VisitLeaf visit_leaf) {
+    // (Dividing by a zero part of the direction gives infinity, which the box test copes with)
+    bz_point inverse = {1.0f / ray.direction.x, 1.0f / ray.direction.y};
+    float max_distance = ray.max_distance;
+
+    uint32_t stack[MAX_BVH_DEPTH];
+    int depth = 0;
+    float enter;
+
+    if (!ray_meets_box(bvh.nodes[0], ray.origin, inverse, max_distance, &enter)) {
+        return;
+    }
+
+    stack[depth++] = 0;
+
+    while (depth > 0) {
+        const bz_bvh_node& node = bvh.nodes[stack[--depth]];
+
+        if (node.count > 0) {
+            max_distance = visit_leaf(node, max_distance);
+            continue;
+        }
+
+        if (node.first == 0) {
+            // An empty tree
+            continue;
+        }
+
+        float enter_first, enter_second;
+        bool first = ray_meets_box(bvh.nodes[node.first], ray.origin, inverse, max_distance, &enter_first);
+        bool second = ray_meets_box(bvh.nodes[node.first + 1], ray.origin, inverse, max_distance, &enter_second);
+
+        // Push the further one first, so the nearer one is looked at first
+        if (first && second && enter_first < enter_second) {
+            stack[depth++] = node.first + 1;
+            stack[depth++] = node.first;
+        } else {
+            if (first) {
+                stack[depth++] = node.first;
+            }
+
+            if (second) {
+                stack[depth++] = node.first + 1;
+            }
+        }
+    }
+}
+
+
+void bz_intersect_rays(const bz_bvh *bvh, const bz_ray *rays, size_t count, bz_hit *hits) {
+    for (size_t i = 0; i < count; ++i) {
+        const bz_ray& ray = rays[i];
+        bz_hit nearest = {INFINITY, 0, BZ_NO_HIT};
+
+        walk_bvh(*bvh, ray, [&](const bz_bvh_node& leaf, float max_distance) {
+            intersect_leaf(*bvh, leaf, ray, max_distance, [&](float distance, float t, uint32_t curve) {
+                if (distance < nearest.distance) {
+                    nearest = bz_hit{distance, t, curve};
+                }
+            });
+
+            // Nothing further away than the nearest crossing so far matters
+            return std::min(max_distance, nearest.distance);
+        });
+
+        hits[i] = nearest;
+    }
+}
+
+
+size_t bz_intersect_ray_all(const bz_bvh *bvh, const bz_ray *ray, bz_hit *hits, size_t max_hits) {
+    size_t found = 0;
+
+    if (max_hits == 0) {
+        return 0;
+    }
+
+    walk_bvh(*bvh, *ray, [&](const bz_bvh_node& leaf, float max_distance) {
+        intersect_leaf(*bvh, leaf, *ray, max_distance, [&](float distance, float t, uint32_t curve) {
+            // The hits are kept nearest first; once there's no more room, a new one pushes the furthest out
+            if (found == max_hits && distance >= hits[found - 1].distance) {
+                return;
+            }
+
+            size_t i = found < max_hits ? found++ : found - 1;
+
+            for (; i > 0 && hits[i - 1].distance > distance; --i) {
+                hits[i] = hits[i - 1];
+            }
+
+            hits[i] = bz_hit{distance, t, curve};
+        });
+
+        // Once there's no more room, nothing further away than the furthest hit kept matters
+        return found == max_hits ? std::min(max_distance, hits[found - 1].distance) : max_distance;
+    });
+
+    return found;
+}
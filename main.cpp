@@ -16,6 +16,30 @@
  *
  * This program draws two curves - quadratic line at the top (green), and a cubic line underneath (red).
  *
+ * The curves are shown in two windows at once; an overview of the whole scene, and a zoomed-in detail view.
+ * Use + and - to zoom the window which has focus, and the arrow keys to move around.
+ * Click to add another copy of the quadratic curve, and drag to move it (see curve_at_pixel).
+ *
+ * Instead of the two curves below, a whole scene of curves can be loaded from a file:
+ *   ./bezier scene.txt
+ * (see scene.hpp for what goes in the file).
+ *
+ * Adding --trace out.json records a timeline of where the time goes (see trace.hpp),
+ * and --perf prints the CPU's own counts of cycles, cache misses and so on for each stage (see perf.hpp).
+ *
+ * --bench 100 draws 100 frames without opening a window and reports how fast it went (see run_benchmark),
+ * and --rays 1000000 does the same for finding where lines cross the curves (see run_rays in bench.cpp).
+ * --inside 1000000 finds whether random points are inside the curves' shapes (see run_inside in bench.cpp),
+ * --collide 1000000 finds when moving circles first touch the curves (see run_collide in bench.cpp),
+ * --msdf 1000 makes textures for drawing that many of the curves' shapes at any size (see run_msdf in bench.cpp),
+ * --ease 10000 works out where that many animations should be with easing curves (see run_easing in bench.cpp), and
+ * --moments works out the area of the curves' shapes, and where their middle is (see run_moments in bench.cpp).
+ *
+ * --svg out.svg, --pdf out.pdf or --gcode out.gcode saves the whole scene as curves instead of pixels (see export.hpp).
+ *
+ * The curve maths itself lives in libbezier (bezier.hpp, and bezier.h for other programs);
+ * this file just shows the results in a window.
+ *
  * This video gives an excellent and short visual description:
  * https://www.youtube.com/watch?v=pnYccz1Ha34
  *
@@ -23,10 +47,28 @@
 
 
 #include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
 
 #include "SDL2/SDL.h"
 
+#include "bench.hpp"
+#include "bezier.hpp"
+#include "export.hpp"
+#include "numa.hpp"
+#include "perf.hpp"
+#include "scene.hpp"
+#include "trace.hpp"
+#include "video.hpp"
+
 
 // Quadratic fixed-point parameters.
 // 0,0 is the upper-left of the window and 1,1 is the lower-right.
@@ -81,202 +123,1462 @@ const int STEPS = 20;
 
 
 /*
- * Data type to represent a position on the screen.
- * To make this easier to think about, in this program, we take x and y to be between 0 and 1.
- * 0,0 is the upper-left of the window and 1,1 is the lower-right.
+ * Level of detail.
+ *
+ * A window which is zoomed in shows each curve bigger on the screen, so it needs
+ * more line segments for the curve to still look smooth.
+ *
+ * Rather than working out an exact number of segments for every possible zoom,
+ * we round the zoom up to a 'level'. Level 0 uses STEPS segments, level 1 uses
+ * twice as many, level 2 four times as many, and so on.
+ *
+ * This means that two windows which are zoomed by similar amounts end up asking
+ * for exactly the same points, so we only need to compute them once.
+ */
+const int MAX_LOD = 6;
+
+
+/*
+ * The level of detail needed to draw curves smoothly at a given zoom.
+ */
+int lod_for_zoom(float zoom) {
+    int lod = 0;
+
+    while (lod < MAX_LOD && (1 << lod) < zoom) {
+        ++lod;
+    }
+
+    return lod;
+}
+
+
+/*
+ * The number of line segments we draw each curve with at a given level of detail.
+ */
+int steps_for_lod(int lod) {
+    return STEPS << lod;
+}
+
+
+/*
+ * Points computed for every curve in the scene, shared between all of the windows.
+ *
+ * levels[lod] holds the points for every curve one after the other, with
+ * steps_for_lod(lod) + 1 points per curve. It stays empty until some window
+ * actually needs that level of detail.
+ *
+ * Big scenes are tessellated by a thread on every CPU (see numa.hpp),
+ * working from their own copy of the curves in numa_curves.
+ * Unless 'quiet' is set, they report how that went, though no more than once
+ * every REPORT_INTERVAL milliseconds (dragging a curve about can make a lot of frames).
  */
 typedef struct {
-    float x;
-    float y;
-} Point;
+    VertexArray levels[MAX_LOD + 1];
+    size_t count;           // How many curves the levels hold
+    NumaCurves numa_curves;
+    bool quiet;
+    Uint32 next_report;     // When the next report is allowed (from SDL_GetTicks)
+} TessellationCache;
+
+const Uint32 REPORT_INTERVAL = 1000;
+
+
+/*
+ * How a window's curves are turned into pixels.
+ */
+enum RasterMode {
+    RASTER_SDL,         // Line segments, drawn by SDL
+    RASTER_LINES,       // Line segments, drawn into our own tiled canvas by libbezier, several at once
+    RASTER_DIRECT,      // Quadratic curves drawn straight into our own canvas, pixel by pixel, with no line segments
+    RASTER_FILL         // Each curve filled in, up to the straight line between its ends, with smooth edges
+};
+
+
+/*
+ * A window onto the scene.
+ *
+ * Each window can look at a different part of the scene at a different zoom.
+ * A zoom of 1 shows the whole scene, exactly as the original single window did.
+ */
+typedef struct {
+    SDL_Window *window;
+    SDL_Renderer *renderer;
+    Uint32 window_id;
+    Point centre;       // The position in the scene which appears in the middle of the window
+    float zoom;
+    int width;          // The size of the window, in pixels
+    int height;
+    RasterMode raster;
+    bz_canvas canvas;   // Where RASTER_DIRECT and RASTER_FILL draw to, and where RASTER_LINES' picture ends up
+    bz_tiled_canvas tiled;  // Where RASTER_LINES draws to
+    std::vector<float> *coverage;   // RASTER_FILL's working space (see bz_fill_polygon), grown as shapes need it
+    bz_occlusion occlusion; // Which parts of the window RASTER_FILL has found to be hidden
+    SDL_Texture *texture;   // How the canvas gets onto the screen
+    uint32_t *shown;    // What the texture holds at the moment
+    bool texture_ready; // False until the whole canvas has been copied into the texture once
+    size_t uploaded;    // How many pixels have been copied into the texture so far
+} Viewport;
+
+
+/*
+ * Memory for a window which libbezier draws into (anything but RASTER_SDL).
+ */
+typedef struct {
+    std::vector<uint32_t> pixels;   // The canvas
+    std::vector<uint32_t> shown;
+    std::vector<uint32_t> tiles;
+    std::vector<float> coverage;
+    std::vector<uint8_t> occlusion;
+} FrameMemory;
+
+
+/*
+ * Give a window which libbezier draws the memory it needs. The size must already be set.
+ */
+void attach_memory(Viewport& viewport, FrameMemory& memory) {
+    size_t pixels = (size_t) viewport.width * viewport.height;
+
+    memory.pixels.assign(pixels, 0);
+    memory.shown.assign(pixels, 0);
+    memory.tiles.resize(viewport.raster == RASTER_LINES ? bz_tiled_canvas_pixels(viewport.width, viewport.height) : 0);
+    memory.coverage.clear();
+    memory.occlusion.resize(viewport.raster == RASTER_FILL ? bz_occlusion_tiles(viewport.width, viewport.height) : 0);
+
+    viewport.canvas = bz_canvas{memory.pixels.data(), viewport.width, viewport.height, viewport.width};
+    viewport.tiled = bz_tiled_canvas_make(memory.tiles.data(), viewport.width, viewport.height);
+    viewport.coverage = &memory.coverage;
+    viewport.occlusion = bz_occlusion_make(memory.occlusion.data(), viewport.width, viewport.height);
+    viewport.shown = memory.shown.data();
+    viewport.texture = NULL;
+}
+
+
+/*
+ * The same, and a texture to show the canvas with. The renderer must already be set.
+ * Returns false if the texture could not be created.
+ */
+bool attach_frame(Viewport& viewport, FrameMemory& memory) {
+    attach_memory(viewport, memory);
+    viewport.texture_ready = false;
+    viewport.uploaded = 0;
+
+    // 'Streaming' textures are meant to be written to by the CPU on every frame
+    viewport.texture = SDL_CreateTexture(viewport.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING,
+                                         viewport.width, viewport.height);
+    return viewport.texture != NULL;
+}
 
 
 /*
  * Clear the window
  */
-void clear(SDL_Renderer *renderer) {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(renderer);
+void clear(Viewport& viewport) {
+    TRACE_SCOPE("clear");
+    PERF_SCOPE(PERF_CLEAR);
+
+    if (viewport.raster == RASTER_LINES) {
+        bz_tiled_canvas_clear(&viewport.tiled, 0xff000000u);
+        return;
+    }
+
+    if (viewport.raster == RASTER_DIRECT || viewport.raster == RASTER_FILL) {
+        bz_canvas_clear(&viewport.canvas, 0xff000000u);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(viewport.renderer, 0, 0, 0, SDL_ALPHA_OPAQUE);
+    SDL_RenderClear(viewport.renderer);
+}
+
+
+/*
+ * Copy the parts of the canvas which have changed since the last frame into the window's texture.
+ *
+ * The texture usually lives in the graphics card's memory, and sending a whole frame there
+ * every time uses up memory bandwidth which the drawing needs, when often only a few curves
+ * have changed (or none, when a window is just uncovered). So the canvas is compared with
+ * a copy of what the texture already holds, in tiles of DIRTY_TILE_WIDTH by DIRTY_TILE_HEIGHT
+ * pixels, and each row of tiles only sends the span from its first changed tile to its last.
+ *
+ * SDL only lets us write to a locked part of a texture, not read it, so every pixel
+ * in the span is written even if some of the tiles in the middle haven't changed.
+ */
+const int DIRTY_TILE_WIDTH = 64;
+const int DIRTY_TILE_HEIGHT = 16;
+
+void upload_changes(Viewport& viewport) {
+    const bz_canvas& canvas = viewport.canvas;
+
+    for (int top = 0; top < canvas.height; top += DIRTY_TILE_HEIGHT) {
+        int bottom = std::min(top + DIRTY_TILE_HEIGHT, canvas.height);
+        int span_left = canvas.width;
+        int span_right = 0;
+
+        for (int left = 0; left < canvas.width; left += DIRTY_TILE_WIDTH) {
+            int right = std::min(left + DIRTY_TILE_WIDTH, canvas.width);
+            bool changed = !viewport.texture_ready;
+
+            for (int y = top; y < bottom && !changed; ++y) {
+                size_t row = (size_t) y * canvas.pitch;
+                changed = memcmp(&canvas.pixels[row + left], &viewport.shown[row + left],
+                                 (right - left) * sizeof(uint32_t)) != 0;
+            }
+
+            if (changed) {
+                span_left = std::min(span_left, left);
+                span_right = right;
+            }
+        }
+
+        if (span_left >= span_right) {
+            continue;
+        }
+
+        SDL_Rect rect = {span_left, top, span_right - span_left, bottom - top};
+        void *locked;
+        int pitch;
+
+        if (SDL_LockTexture(viewport.texture, &rect, &locked, &pitch) != 0) {
+            continue;
+        }
+
+        for (int y = top; y < bottom; ++y) {
+            const uint32_t *from = &canvas.pixels[(size_t) y * canvas.pitch + span_left];
+            std::copy(from, from + rect.w, (uint32_t *) ((char *) locked + (size_t) (y - top) * pitch));
+            std::copy(from, from + rect.w, &viewport.shown[(size_t) y * canvas.pitch + span_left]);
+        }
+
+        SDL_UnlockTexture(viewport.texture);
+        viewport.uploaded += (size_t) rect.w * rect.h;
+    }
+
+    viewport.texture_ready = true;
+}
+
+
+/*
+ * Display everything that we have drawn on the screen.
+ * When libbezier did the drawing, the tiled canvas has to be put back into rows first,
+ * and then whatever changed goes into the texture (if there is one), which SDL draws to the screen.
+ */
+void present(Viewport& viewport) {
+    TRACE_SCOPE("present");
+    PERF_SCOPE(PERF_PRESENT);
+
+    if (viewport.raster == RASTER_LINES) {
+        bz_tiled_canvas_copy(&viewport.tiled, &viewport.canvas);
+    }
+
+    if (viewport.texture) {
+        upload_changes(viewport);
+        SDL_RenderCopy(viewport.renderer, viewport.texture, NULL, NULL);
+    }
+
+    SDL_RenderPresent(viewport.renderer);
+}
+
+
+// The two curves from the top of this file
+constexpr Curve QUAD_CURVE = {2, {Point{QUAD_P0_X, QUAD_P0_Y},
+                                  Point{QUAD_P1_X, QUAD_P1_Y},
+                                  Point{QUAD_P2_X, QUAD_P2_Y}},
+                              0, 255, 0};
+
+constexpr Curve CUBIC_CURVE = {3, {Point{CUBIC_P0_X, CUBIC_P0_Y},
+                                   Point{CUBIC_P1_X, CUBIC_P1_Y},
+                                   Point{CUBIC_P2_X, CUBIC_P2_Y},
+                                   Point{CUBIC_P3_X, CUBIC_P3_Y}},
+                               255, 0, 0};
+
+// ...and their points, worked out by the compiler.
+// Being 'constexpr' means that the compiler has to work these out; it isn't allowed to leave them until later.
+constexpr std::array<Point, STEPS + 1> QUAD_POINTS = tessellate_static<STEPS>(QUAD_CURVE);
+constexpr std::array<Point, STEPS + 1> CUBIC_POINTS = tessellate_static<STEPS>(CUBIC_CURVE);
+
+static_assert(QUAD_POINTS[STEPS].x == QUAD_CURVE.p[2].x && QUAD_POINTS[STEPS].y == QUAD_CURVE.p[2].y,
+              "A curve should end at its last control point");
+
+
+/*
+ * Every curve which the compiler has already tessellated (with STEPS line segments).
+ * Add any other constant curves (icons, shapes and so on) here.
+ */
+typedef struct {
+    const Curve *curve;
+    const Point *points;
+} BakedCurve;
+
+const BakedCurve BAKED_CURVES[] = {
+    {&QUAD_CURVE, QUAD_POINTS.data()},
+    {&CUBIC_CURVE, CUBIC_POINTS.data()},
+};
+
+
+/*
+ * Find the points which the compiler worked out for a curve, if it is one of the constant ones.
+ * Returns NULL for any other curve.
+ */
+const Point *find_baked_points(const Curve& curve) {
+    for (const BakedCurve& baked : BAKED_CURVES) {
+        bool same = baked.curve->degree == curve.degree;
+
+        for (int i = 0; same && i <= curve.degree; ++i) {
+            same = baked.curve->p[i].x == curve.p[i].x && baked.curve->p[i].y == curve.p[i].y;
+        }
+
+        if (same) {
+            return baked.points;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Get the points for every curve at a level of detail.
+ *
+ * The first window to ask for a level pays for computing it;
+ * every other window at the same level gets the same points for free.
+ * Returns NULL only if there wasn't enough memory.
+ */
+const Point *tessellation_for_lod(TessellationCache& cache, const std::vector<Curve>& curves, int lod) {
+    VertexArray& level = cache.levels[lod];
+    int steps = steps_for_lod(lod);
+
+    if (level.points) {
+        return level.points;
+    }
+
+    // An empty scene has no points, but there's no need to allocate anything for that
+    if (curves.empty()) {
+        static const Point NO_POINTS[1] = {};
+        return NO_POINTS;
+    }
+
+    TRACE_SCOPE("tessellate");
+    PERF_SCOPE(PERF_TESSELLATE);
+
+    cache.count = curves.size();
+
+    if (curves.size() < PARALLEL_MIN_CURVES) {
+        level.bytes = curves.size() * (steps + 1) * sizeof(Point);
+        level.points = (Point *) huge_alloc(level.bytes);
+
+        if (level.points) {
+            for (size_t i = 0; i < curves.size(); ++i) {
+                Point *out = level.points + i * (steps + 1);
+                const Point *baked = steps == STEPS ? find_baked_points(curves[i]) : NULL;
+
+                if (baked) {
+                    std::copy(baked, baked + steps + 1, out);
+                } else {
+                    tessellate_curve(curves[i], steps, out);
+                }
+            }
+        }
+
+        return level.points;
+    }
+
+    // The copy of the curves is shared by every level, so it is only made once
+    if (!cache.numa_curves.curves &&
+        !build_numa_curves(cache.numa_curves, curves, std::thread::hardware_concurrency())) {
+        return NULL;
+    }
+
+    NumaStats stats;
+
+    if (parallel_tessellate(cache.numa_curves, steps, level, &stats) && !cache.quiet
+        && SDL_GetTicks() >= cache.next_report) {
+        cache.next_report = SDL_GetTicks() + REPORT_INTERVAL;
+        cerr << "Tessellated " << curves.size() << " curves with " << steps << " steps on "
+             << stats.threads << " threads across " << stats.nodes << " NUMA nodes; pages sampled: "
+             << stats.local_pages << " local, " << stats.remote_pages << " remote, "
+             << stats.unknown_pages << " unknown" << endl;
+    }
+
+    return level.points;
+}
+
+
+/*
+ * Throw away everything in the cache.
+ * This needs to happen whenever the curves change.
+ */
+void invalidate_tessellation(TessellationCache& cache) {
+    for (int lod = 0; lod <= MAX_LOD; ++lod) {
+        huge_free(cache.levels[lod].points, cache.levels[lod].bytes);
+        cache.levels[lod].points = NULL;
+        cache.levels[lod].bytes = 0;
+    }
+
+    free_numa_curves(cache.numa_curves);
+    cache.count = 0;
+}
+
+
+/*
+ * Bring the cache up to date after one curve has moved, without throwing anything else away.
+ * Only the levels which have already been made are tessellated again, and only for that curve.
+ * Curves which have been added, or moved somewhere else in the array, still need invalidate_tessellation.
+ */
+void update_tessellated_curve(TessellationCache& cache, const std::vector<Curve>& curves, size_t index) {
+    if (index >= cache.count) {
+        return;
+    }
+
+    if (cache.numa_curves.curves) {
+        cache.numa_curves.curves[index] = curves[index];
+    }
+
+    for (int lod = 0; lod <= MAX_LOD; ++lod) {
+        int steps = steps_for_lod(lod);
+
+        if (cache.levels[lod].points) {
+            tessellate_curve(curves[index], steps, cache.levels[lod].points + index * (steps + 1));
+        }
+    }
+}
+
+
+/*
+ * Convert a position in the scene to a pixel in a window.
+ * The window's centre position ends up in the middle of the window,
+ * and everything else is spread out around it by the zoom.
+ */
+void scene_to_window(const Viewport& viewport, const Point& p, int *x, int *y) {
+    *x = viewport.width * ((p.x - viewport.centre.x) * viewport.zoom + 0.5f);
+    *y = viewport.height * ((p.y - viewport.centre.y) * viewport.zoom + 0.5f);
+}
+
+
+/*
+ * Can a window see any of a curve?
+ *
+ * We skip curves which are completely outside the window.
+ * Because the scene is in Morton order, the curves which we do draw
+ * tend to sit next to each other in memory.
+ */
+bool curve_visible(const Viewport& viewport, const Curve& curve) {
+    // The part of the scene which this window can see
+    Point view_min = Point{viewport.centre.x - 0.5f / viewport.zoom, viewport.centre.y - 0.5f / viewport.zoom};
+    Point view_max = Point{viewport.centre.x + 0.5f / viewport.zoom, viewport.centre.y + 0.5f / viewport.zoom};
+
+    Point min, max;
+    curve_bounds(curve, &min, &max);
+
+    return !(max.x < view_min.x || min.x > view_max.x || max.y < view_min.y || min.y > view_max.y);
+}
+
+
+/*
+ * The same conversion as scene_to_window, in the form which libbezier takes.
+ */
+bz_transform viewport_transform(const Viewport& viewport) {
+    return bz_transform{viewport.width * viewport.zoom,
+                        viewport.height * viewport.zoom,
+                        viewport.width * (0.5f - viewport.centre.x * viewport.zoom),
+                        viewport.height * (0.5f - viewport.centre.y * viewport.zoom)};
+}
+
+
+/*
+ * Draw every curve which a window can see without tessellating anything first (see raster_direct.cpp).
+ * Returns the number of line segments drawn, which is only for the cubic curves.
+ */
+size_t rasterize_direct(Viewport& viewport, const std::vector<Curve>& curves, int cubic_steps) {
+    TRACE_SCOPE("rasterize");
+    PERF_SCOPE(PERF_RASTERIZE);
+
+    bz_transform transform = viewport_transform(viewport);
+    size_t segments = 0;
+
+    for (size_t i = 0; i < curves.size(); ++i) {
+        if (curve_visible(viewport, curves[i])) {
+            segments += bz_rasterize_direct(&viewport.canvas, &transform, &curves[i], 1, cubic_steps);
+        }
+    }
+
+    return segments;
 }
 
 
 /*
- * Linear interpolation between two points.
- * When interp is 0, the result is the first point, p0.
- * When interp is 1, the result is the first point, p1.
- * As interp moves from 0 to 1, the result moves smoothly from p0 to p1.
- * If interp is 0.8, the result is 80% of the way from p0 to p1.
+ * Find the filled curves which a window can see, and which aren't completely hidden
+ * behind others drawn after them (see occlusion.cpp). Returns them from front to back.
  */
-Point lerp(float interp, const Point &p0, const Point &p1) {
-    return Point{(1 - interp) * p0.x + interp * p1.x,
-                 (1 - interp) * p0.y + interp * p1.y};
+std::vector<size_t> cull_hidden_fills(Viewport& viewport, const std::vector<Curve>& curves,
+                                      const Point *points, int stride) {
+    TRACE_SCOPE("cull");
+
+    bz_transform transform = viewport_transform(viewport);
+    std::vector<char> working(bz_occlusion_buffer_size(stride));
+    std::vector<size_t> shown;
+
+    bz_occlusion_clear(&viewport.occlusion);
+
+    for (size_t i = curves.size(); i-- > 0;) {
+        const Point *curve_points = &points[i * stride];
+
+        if (!curve_visible(viewport, curves[i])
+            || bz_occlusion_hidden(&viewport.occlusion, &transform, curve_points, stride)) {
+            continue;
+        }
+
+        bz_occlusion_add(&viewport.occlusion, working.data(), &transform, curve_points, stride, BZ_FILL_NONZERO);
+        shown.push_back(i);
+    }
+
+    return shown;
 }
 
 
 /*
- * Draw a quadratic Bezier curve based on 3 control points.
- * The curve will be drawn in green.
+ * Draw the lines between the points of every curve which a window can see.
+ * Returns the number of lines drawn.
  */
-void draw_bezier_quadratic(SDL_Renderer *renderer, const Point& p0, const Point& p1, const Point& p2) {
-    Point p0_p1_interp;
-    Point p1_p2_interp;
+size_t rasterize_curves(Viewport& viewport, const std::vector<Curve>& curves, const Point *points, int stride) {
+    size_t segments = 0;
 
-    // We already know that the curve will start at p0.
-    // Later, this will keep track of the end of the line which we drew most recently,
-    // and where we should therefore start drawng the next line from.
-    Point curve_prev = p0;
+    TRACE_SCOPE("rasterize");
+    PERF_SCOPE(PERF_RASTERIZE);
 
-    // This will keep track of the next point which we need to draw to.
-    Point curve_current;
+    // libbezier draws a batch of curves at a time, so hand it each run of visible curves in one go.
+    // The scene is in Morton order, so most of the curves a window can see come in long runs.
+    if (viewport.raster == RASTER_LINES) {
+        bz_transform transform = viewport_transform(viewport);
+        size_t run_start = 0;
 
-    // Set the colour for the quadratic curve
-    SDL_SetRenderDrawColor(renderer, 0, 255, 0, SDL_ALPHA_OPAQUE);
+        for (size_t i = 0; i <= curves.size(); ++i) {
+            if (i < curves.size() && curve_visible(viewport, curves[i])) {
+                continue;
+            }
 
-    // Loop through the number of line segments which we need to draw
-    for (int i = 1; i <= STEPS; ++i) {
-        // Work out our interpolation value for this line segment.
-        // It will be between 0 and 1.
-        float interp = (float) i / STEPS;
+            if (i > run_start) {
+                segments += bz_tiled_rasterize(&viewport.tiled, &transform, &curves[run_start], i - run_start,
+                                               stride - 1, &points[run_start * stride]);
+            }
 
-        // Interpolate between p0 and p1.
-        p0_p1_interp = lerp(interp, p0, p1);
+            run_start = i + 1;
+        }
+
+        return segments;
+    }
+
+    // Each curve's points, with the line back from its end to its start, make a closed shape
+    if (viewport.raster == RASTER_FILL) {
+        bz_transform transform = viewport_transform(viewport);
+        std::vector<size_t> shown = cull_hidden_fills(viewport, curves, points, stride);
+        size_t needed = 0;
 
-        // Interpolate between p1 and p2 by the same amount again.
-        p1_p2_interp = lerp(interp, p1, p2);
+        // Big, mostly empty shapes are drawn a row at a time, which needs far less than notes for the whole window,
+        // so the working space is only made as big as the shapes actually drawn need
+        for (size_t i : shown) {
+            needed = std::max(needed, bz_fill_polygon_size(&viewport.canvas, &transform, &points[i * stride], stride));
+        }
 
-        // Now interpolate between the two points we just calculated,
-        // again by the same amount.
-        // This will give us the next point in our curve.
-        curve_current = lerp(interp, p0_p1_interp, p1_p2_interp);
+        if (viewport.coverage->size() * sizeof(float) < needed) {
+            viewport.coverage->resize((needed + sizeof(float) - 1) / sizeof(float), 0);
+        }
 
-        // Draw this line segment, from the end of the previous line
-        // to the point we just calculated.
-        SDL_RenderDrawLine(renderer,
-                           W * curve_prev.x,    H * curve_prev.y,
-                           W * curve_current.x, H * curve_current.y);
+        // cull_hidden_fills went from front to back, so this is back to front again
+        for (size_t k = shown.size(); k-- > 0;) {
+            size_t i = shown[k];
+            uint32_t colour = 0xff000000u | (curves[i].r << 16) | (curves[i].g << 8) | curves[i].b;
+            bz_fill_polygon(&viewport.canvas, viewport.coverage->data(), &transform, &points[i * stride], stride,
+                            BZ_FILL_NONZERO, colour);
+            segments += stride;
+        }
 
-        // Make a note of where the line we just drew ends, because
-        // we need to start drawing from here next time.
-        curve_prev = curve_current;
+        return segments;
     }
+
+    bz_transform transform = viewport_transform(viewport);
+
+    for (size_t i = 0; i < curves.size(); ++i) {
+        const Point *curve_points = &points[i * stride];
+
+        if (!curve_visible(viewport, curves[i])) {
+            continue;
+        }
+
+        // This will keep track of the end of the line which we drew most recently,
+        // and where we should therefore start drawng the next line from.
+        int prev_x, prev_y;
+        scene_to_window(viewport, curve_points[0], &prev_x, &prev_y);
+
+        SDL_SetRenderDrawColor(viewport.renderer, curves[i].r, curves[i].g, curves[i].b, SDL_ALPHA_OPAQUE);
+
+        // Zoomed out, most curves are a single pixel or a single straight line (see curve_detail)
+        CurveDetail detail = curve_detail(curves[i], transform, COLLAPSE_TOLERANCE);
+
+        if (detail == DETAIL_POINT) {
+            SDL_RenderDrawPoint(viewport.renderer, prev_x, prev_y);
+            ++segments;
+            continue;
+        }
+
+        if (detail == DETAIL_LINE) {
+            int x, y;
+            scene_to_window(viewport, curve_points[stride - 1], &x, &y);
+            SDL_RenderDrawLine(viewport.renderer, prev_x, prev_y, x, y);
+            ++segments;
+            continue;
+        }
+
+        for (int j = 1; j < stride; ++j) {
+            int x, y;
+            scene_to_window(viewport, curve_points[j], &x, &y);
+
+            // Draw this line segment, from the end of the previous line
+            // to the point we just calculated.
+            SDL_RenderDrawLine(viewport.renderer, prev_x, prev_y, x, y);
+
+            prev_x = x;
+            prev_y = y;
+        }
+
+        segments += stride - 1;
+    }
+
+    return segments;
+}
+
+
+/*
+ * Draw every curve in the scene into one window.
+ * Returns the number of lines drawn.
+ */
+size_t draw_viewport(Viewport& viewport, TessellationCache& cache, const std::vector<Curve>& curves) {
+    int lod = lod_for_zoom(viewport.zoom);
+    int stride = steps_for_lod(lod) + 1;
+
+    // Drawing directly doesn't need the tessellated points at all
+    if (viewport.raster == RASTER_DIRECT) {
+        clear(viewport);
+
+        size_t segments = rasterize_direct(viewport, curves, stride - 1);
+
+        present(viewport);
+        perf_end_frame("frame");
+        return segments;
+    }
+
+    const Point *points = tessellation_for_lod(cache, curves, lod);
+    size_t segments = 0;
+
+    clear(viewport);
+
+    // (Without the points, the frame is still finished as usual, so it is counted like the others)
+    if (points) {
+        segments = rasterize_curves(viewport, curves, points, stride);
+    } else {
+        cerr << "Error: Not enough memory to draw the curves" << endl;
+    }
+
+    present(viewport);
+    perf_end_frame("frame");
+    return segments;
 }
 
 
 /*
- * Draw a cubic Bezier curve based on 4 control points.
- * The curve will be drawn in red.
- */
-void draw_bezier_cubic(SDL_Renderer *renderer, const Point& p0, const Point& p1, const Point& p2, const Point& p3) {
-    Point p0_p1_interp;
-    Point p1_p2_interp;
-    Point p2_p3_interp;
-
-    Point p0p1_p1p2_interp;
-    Point p1p2_p2p3_interp;
-
-    // We already know that the curve will start at p0.
-    // Later, this will keep track of the end of the line which we drew most recently,
-    // and where we should therefore start drawng the next line from.
-    Point curve_prev = p0;
-
-    // This will keep track of the next point which we need to draw to.
-    Point curve_current;
-
-    // Set the colour for the cubic curve
-    SDL_SetRenderDrawColor(renderer, 255, 0, 0, SDL_ALPHA_OPAQUE);
-
-    // Loop through the number of line segments which we need to draw
-    for (int i = 1; i <= STEPS; ++i) {
-        // Work out our interpolation value for this line segment.
-        // It will be between 0 and 1.
-        float interp = (float) i / STEPS;
-
-        // In the quadratic curve, we interpolated between two pairs of points;
-        // p0 and p1, and then p1 and p2.
-        // For a cubic curve, we interpolate between three pairs;
-        // p0 and p1, p1 and p2, and finally p2 and p3.
-        p0_p1_interp = lerp(interp, p0, p1);
-        p1_p2_interp = lerp(interp, p1, p2);
-        p2_p3_interp = lerp(interp, p2, p3);
-
-        // Next, we interpolate each pair of values which we just computed,
-        // again using the same interpolation vaule.
-        p0p1_p1p2_interp = lerp(interp, p0_p1_interp, p1_p2_interp);
-        p1p2_p2p3_interp = lerp(interp, p1_p2_interp, p2_p3_interp);
-
-        // We perform one final interpolation on the previous two points to get
-        // our next position in the curve, with the same interpolation again.
-        //
-        // Note that all we have done differently from the quadratic curve
-        // is to use 3 'layers' of interpolation instead of 2.
-        //
-        // We needed 4 control points instead of 3 in order to have enough
-        // data to perform this many interpolations.
-        curve_current = lerp(interp, p0p1_p1p2_interp, p1p2_p2p3_interp);
-
-        // Draw this line segment, from the end of the previous line
-        // to the point we just calculated.
-        SDL_RenderDrawLine(renderer,
-                           W * curve_prev.x,    H * curve_prev.y,
-                           W * curve_current.x, H * curve_current.y);
-
-        // Make a note of where the line we just drew ends, because
-        // we need to start drawing from here next time.
-        curve_prev = curve_current;
+ * Close a window and tidy up its renderer (and texture).
+ */
+void close_viewport(Viewport& viewport) {
+    if (viewport.texture) {
+        SDL_DestroyTexture(viewport.texture);
+        viewport.texture = NULL;
+    }
+
+    if (viewport.renderer) {
+        SDL_DestroyRenderer(viewport.renderer);
+        viewport.renderer = NULL;
+    }
+
+    if (viewport.window) {
+        SDL_DestroyWindow(viewport.window);
+        viewport.window = NULL;
     }
 }
 
 
+/*
+ * Open a new window looking at the scene, drawn by 'raster' (using 'memory' if it isn't SDL).
+ * Returns false if the window could not be created.
+ */
+bool open_viewport(Viewport& viewport, const char *title, const Point& centre, float zoom,
+                   RasterMode raster, FrameMemory& memory) {
+    viewport.window = SDL_CreateWindow(title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, W, H, 0);
+
+    if (!viewport.window) {
+        return false;
+    }
+
+    viewport.renderer = SDL_CreateRenderer(viewport.window, -1, 0);
+
+    if (!viewport.renderer) {
+        SDL_DestroyWindow(viewport.window);
+        viewport.window = NULL;
+        return false;
+    }
+
+    viewport.window_id = SDL_GetWindowID(viewport.window);
+    viewport.centre = centre;
+    viewport.zoom = zoom;
+    viewport.width = W;
+    viewport.height = H;
+    viewport.raster = raster;
+    viewport.texture = NULL;
+
+    if (raster != RASTER_SDL && !attach_frame(viewport, memory)) {
+        close_viewport(viewport);
+        return false;
+    }
+
+    return true;
+}
+
+
+/*
+ * Find the window which an event was sent to.
+ * Returns NULL if it isn't one of ours (or it has already been closed).
+ */
+Viewport *find_viewport(std::vector<Viewport>& viewports, Uint32 window_id) {
+    for (size_t i = 0; i < viewports.size(); ++i) {
+        if (viewports[i].window && viewports[i].window_id == window_id) {
+            return &viewports[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Clicking in a window adds a copy of the quadratic curve from the top of this file, a fifth as wide
+ * as the window shows, with its middle where the mouse is; dragging moves it until the button is let go.
+ */
+Curve curve_at_pixel(const Viewport& viewport, int x, int y) {
+    bz_transform transform = viewport_transform(viewport);
+    Point at = Point{(x + 0.5f - transform.offset_x) / transform.scale_x, (y + 0.5f - transform.offset_y) / transform.scale_y};
+    Point min, max;
+    curve_bounds(QUAD_CURVE, &min, &max);
+
+    float scale = 0.2f / viewport.zoom / std::max(max.x - min.x, 1e-6f);
+    Curve curve = QUAD_CURVE;
+
+    for (int i = 0; i <= curve.degree; ++i) {
+        curve.p[i] = Point{at.x + (QUAD_CURVE.p[i].x - 0.5f * (min.x + max.x)) * scale,
+                           at.y + (QUAD_CURVE.p[i].y - 0.5f * (min.y + max.y)) * scale};
+    }
+
+    return curve;
+}
+
+
+/*
+ * For --bench with --raster direct; how far from the exact curves the pixels drawn by libbezier's
+ * direct drawing are, which is more than half a pixel, since it rounds the control points off and
+ * only roughly picks the nearer of two pixels (see raster_direct.cpp).
+ *
+ * The first DIRECT_CHECK_CURVES quadratic curves are each drawn on their own, as they are and
+ * again as rational curves with a weight of DIRECT_CHECK_WEIGHT, and every pixel near points no
+ * more than DIRECT_CHECK_SPACING apart along the exact curve is given its distance from the nearest
+ * of them. Returns the furthest any drawn pixel is; infinity means more than DIRECT_CHECK_REACH.
+ */
+const size_t DIRECT_CHECK_CURVES = 1000;
+const float DIRECT_CHECK_WEIGHT = 0.5f;
+const float DIRECT_CHECK_SPACING = 0.05f;   // In pixels
+const int DIRECT_CHECK_REACH = 3;           // In pixels
+const float DIRECT_TOLERANCE = 2;           // In pixels
+
+float direct_pixels_off_curve(const std::vector<Curve>& curves, const bz_transform& transform, int width, int height) {
+    std::vector<uint32_t> pixels((size_t) width * height, 0);
+    std::vector<float> distances((size_t) width * height, INFINITY);
+    bz_canvas canvas = {pixels.data(), width, height, width};
+    float furthest = 0;
+    size_t checked = 0;
+
+    for (const Curve& curve : curves) {
+        if (curve.degree != 2) {
+            continue;
+        }
+
+        if (checked++ == DIRECT_CHECK_CURVES) {
+            break;
+        }
+
+        Point p[3];
+
+        for (int i = 0; i < 3; ++i) {
+            p[i] = Point{curve.p[i].x * transform.scale_x + transform.offset_x,
+                         curve.p[i].y * transform.scale_y + transform.offset_y};
+        }
+
+        // The pixels which any of it could be drawn in, or be near
+        int left = std::max((int) std::floor(std::min({p[0].x, p[1].x, p[2].x})) - DIRECT_CHECK_REACH, 0);
+        int top = std::max((int) std::floor(std::min({p[0].y, p[1].y, p[2].y})) - DIRECT_CHECK_REACH, 0);
+        int right = std::min((int) std::ceil(std::max({p[0].x, p[1].x, p[2].x})) + DIRECT_CHECK_REACH, width - 1);
+        int bottom = std::min((int) std::ceil(std::max({p[0].y, p[1].y, p[2].y})) + DIRECT_CHECK_REACH, height - 1);
+
+        // (It's never longer than the lines between its control points)
+        float length = std::hypot(p[1].x - p[0].x, p[1].y - p[0].y) + std::hypot(p[2].x - p[1].x, p[2].y - p[1].y);
+        int samples = (int) std::ceil(length / DIRECT_CHECK_SPACING) + 1;
+
+        for (float w : {1.0f, DIRECT_CHECK_WEIGHT}) {
+            if (w == 1) {
+                bz_draw_quadratic(&canvas, p[0].x, p[0].y, p[1].x, p[1].y, p[2].x, p[2].y, 1);
+            } else {
+                bz_draw_rational_quadratic(&canvas, p[0].x, p[0].y, p[1].x, p[1].y, p[2].x, p[2].y, w, 1);
+            }
+
+            // A lower weight only makes the curve shorter, so the same number of points is enough
+            for (int i = 0; i <= samples; ++i) {
+                float t = (float) i / samples;
+                float a = (1 - t) * (1 - t), b = 2 * t * (1 - t) * w, c = t * t;
+                float x = (a * p[0].x + b * p[1].x + c * p[2].x) / (a + b + c);
+                float y = (a * p[0].y + b * p[1].y + c * p[2].y) / (a + b + c);
+
+                for (int near_y = std::max((int) std::lround(y) - DIRECT_CHECK_REACH, top);
+                     near_y <= std::min((int) std::lround(y) + DIRECT_CHECK_REACH, bottom); ++near_y) {
+                    for (int near_x = std::max((int) std::lround(x) - DIRECT_CHECK_REACH, left);
+                         near_x <= std::min((int) std::lround(x) + DIRECT_CHECK_REACH, right); ++near_x) {
+                        float& distance = distances[(size_t) near_y * width + near_x];
+                        distance = std::min(distance, std::hypot(near_x - x, near_y - y));
+                    }
+                }
+            }
+
+            // Then clean up for the next one
+            for (int y = top; y <= bottom; ++y) {
+                for (int x = left; x <= right; ++x) {
+                    size_t pixel = (size_t) y * width + x;
+
+                    if (pixels[pixel]) {
+                        furthest = std::max(furthest, distances[pixel]);
+                    }
+
+                    pixels[pixel] = 0;
+                    distances[pixel] = INFINITY;
+                }
+            }
+        }
+    }
+
+    return furthest;
+}
+
+
+/*
+ * Benchmark; draw the scene over and over without a window, and report how fast it went.
+ *
+ * The frames are drawn by SDL's software renderer into a picture in memory, using exactly
+ * the same drawing code as the windows do, so the cost of handing every line to SDL is included.
+ * No display is needed, so this works on machines without one.
+ *
+ * Normally the curves are only tessellated for the first frame, just like redrawing a window.
+ * With 'cold', they are tessellated again for every frame.
+ *
+ * 'raster' picks who draws the pixels; SDL, or libbezier drawing into its own canvas, which is shown
+ * through a texture just as it is in a window. Drawing directly also checks that the pixels are
+ * no more than DIRECT_TOLERANCE from the curves, and returns 1 if not.
+ */
+int run_benchmark(Scene& scene, int frames, int width, int height, bool cold, RasterMode raster) {
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+
+    if (!renderer) {
+        cerr << "Error: Could not create a software renderer (" << SDL_GetError() << ")" << endl;
+
+        if (surface) {
+            SDL_FreeSurface(surface);
+        }
+
+        return 5;
+    }
+
+    Viewport viewport = {NULL, renderer, 0, Point{0.5, 0.5}, 1, width, height, raster};
+    FrameMemory memory;
+
+    if (raster != RASTER_SDL && !attach_frame(viewport, memory)) {
+        cerr << "Error: Could not create a texture (" << SDL_GetError() << ")" << endl;
+        SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+        return 5;
+    }
+    TessellationCache cache = {};
+    size_t segments = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < frames; ++frame) {
+        if (cold) {
+            invalidate_tessellation(cache);
+        }
+
+        segments += draw_viewport(viewport, cache, scene.curves);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Where the time went
+    PerfCounts stages[PERF_STAGES];
+    perf_totals(stages);
+
+    const char *raster_names[] = {"SDL", "libbezier lines", "libbezier direct", "libbezier fill"};
+
+    cout << "Benchmark: " << scene.curves.size() << " curves, " << frames << " frames at "
+         << width << "x" << height << " drawn by " << raster_names[raster]
+         << (cold ? ", tessellating every frame" : "") << endl;
+    cout << "  " << frames / seconds << " frames/sec, " << segments / seconds << " segments/sec, "
+         << segments / std::max(frames, 1) << " segments/frame" << endl;
+
+    for (int stage = 0; stage < PERF_STAGES; ++stage) {
+        double stage_ms = stages[stage].nanoseconds / 1e6;
+
+        cout << "  " << perf_stage_name((PerfStage) stage) << ": " << stage_ms / std::max(frames, 1) << " ms/frame ("
+             << 100 * stage_ms / (seconds * 1000) << "%)" << endl;
+    }
+
+    // Only what changed goes into the texture (see upload_changes)
+    if (raster != RASTER_SDL) {
+        size_t uploaded = viewport.uploaded / std::max(frames, 1);
+
+        cout << "  uploaded: " << uploaded << " pixels/frame ("
+             << 100.0 * uploaded / ((size_t) width * height) << "% of each frame)" << endl;
+        SDL_DestroyTexture(viewport.texture);
+    }
+
+    int result = 0;
+
+    if (raster == RASTER_DIRECT) {
+        float furthest = direct_pixels_off_curve(scene.curves, viewport_transform(viewport), width, height);
+        cout << "  pixels up to " << furthest << " from the exact curves" << endl;
+
+        if (furthest > DIRECT_TOLERANCE) {
+            cerr << "Error: Curves were drawn further from where they are than they should be" << endl;
+            result = 1;
+        }
+    }
+
+    invalidate_tessellation(cache);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    return result;
+}
+
+
+/*
+ * Animation for --video; every control point drifts round a small circle, so the curves
+ * bend back and forth. Each point starts from a different place on its circle (spread out
+ * by the 'golden ratio', so that no two are close), so they don't all move together.
+ */
+const float WOBBLE_RADIUS = 0.01f;      // In scene units
+const float WOBBLE_SECONDS = 4;         // How long one trip round the circle takes
+
+void animate_curves(const std::vector<Curve>& curves, float seconds, std::vector<Curve>& out) {
+    const float TWO_PI = 6.2831853f;
+    out = curves;
+
+    for (size_t i = 0; i < out.size(); ++i) {
+        for (int j = 0; j <= out[i].degree; ++j) {
+            float angle = TWO_PI * (seconds / WOBBLE_SECONDS + (i * 4 + j) * 0.618034f);
+            out[i].p[j].x += WOBBLE_RADIUS * std::cos(angle);
+            out[i].p[j].y += WOBBLE_RADIUS * std::sin(angle);
+        }
+    }
+}
+
+
+/*
+ * Video; draw an animation of the scene without a window, and write it to standard output
+ * (see video.hpp). Frames are drawn here while earlier ones are converted and written by
+ * other threads. Drawing is done just as in the benchmark, except that libbezier draws
+ * straight into the video's frames, and there is no texture.
+ */
+int run_video(Scene& scene, int frames, int fps, int width, int height, RasterMode raster) {
+    SDL_Surface *surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer *renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+
+    if (!renderer) {
+        cerr << "Error: Could not create a software renderer (" << SDL_GetError() << ")" << endl;
+
+        if (surface) {
+            SDL_FreeSurface(surface);
+        }
+
+        return 5;
+    }
+
+    if (!video_start(width, height, fps)) {
+        cerr << "Error: --video writes the video to standard output; send it to a file or another program" << endl;
+        SDL_DestroyRenderer(renderer);
+        SDL_FreeSurface(surface);
+        return 4;
+    }
+
+    Viewport viewport = {NULL, renderer, 0, Point{0.5, 0.5}, 1, width, height, raster};
+    FrameMemory memory;
+
+    if (raster != RASTER_SDL) {
+        attach_memory(viewport, memory);
+    }
+
+    std::vector<Curve> curves;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int frame = 0; frame < frames; ++frame) {
+        // The curves move, so they have to be tessellated again every frame;
+        // too often to say so every time
+        TessellationCache cache = {};
+        cache.quiet = true;
+        animate_curves(scene.curves, (float) frame / fps, curves);
+
+        uint32_t *pixels = video_frame();
+
+        if (raster != RASTER_SDL) {
+            viewport.canvas.pixels = pixels;
+        }
+
+        draw_viewport(viewport, cache, curves);
+        invalidate_tessellation(cache);
+
+        if (raster == RASTER_SDL) {
+            for (int y = 0; y < height; ++y) {
+                const uint32_t *row = (const uint32_t *) ((const char *) surface->pixels + (size_t) y * surface->pitch);
+                std::copy(row, row + width, pixels + (size_t) y * width);
+            }
+        }
+
+        video_submit();
+    }
+
+    bool written = video_finish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+
+    if (!written) {
+        cerr << "Error: Could not write the video" << endl;
+        return 6;
+    }
+
+    cerr << "Wrote " << frames << " frames at " << width << "x" << height << " in " << seconds << " seconds ("
+         << frames / seconds << " frames/sec)" << endl;
+    return 0;
+}
+
+
+/*
+ * Read a number from the command line which has to be above 0 and no more than 'most', such as
+ * a number of frames. (atoi would quietly read a typo as 0, and open the windows instead, and
+ * strtoul would read -1 as the biggest number there is.) Returns false if it isn't one.
+ */
+bool read_positive(const char *text, long most, long *number) {
+    char *end;
+    errno = 0;
+    *number = strtol(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && *number > 0 && *number <= most;
+}
+
+
 int main(int argc, char** argv) {
     SDL_Surface* w;
     Uint32* pixels;
 
+    const char *scene_file = NULL;
+    const char *trace_file = NULL;
+    bool count_perf = false;
+    int bench_frames = 0;
+    size_t ray_count = 0;
+    size_t inside_points = 0;
+    size_t collide_count = 0;
+    size_t msdf_count = 0;
+    size_t ease_count = 0;
+    bool find_moments = false;
+    int video_frames = 0;
+    int video_fps = 30;
+    int bench_width = W;
+    int bench_height = H;
+    bool bench_cold = false;
+    RasterMode raster = RASTER_SDL;
+    const char *export_file = NULL;
+    ExportFormat export_format = EXPORT_SVG;
+    bool export_simplify = false;
+    bool export_arcs = true;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            count_perf = true;
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            long frames;
+
+            if (!read_positive(argv[++i], INT_MAX, &frames)) {
+                cerr << "Error: --bench needs a number of frames, above 0" << endl;
+                return 4;
+            }
+
+            bench_frames = (int) frames;
+        } else if (strcmp(argv[i], "--rays") == 0 && i + 1 < argc) {
+            long count;
+
+            if (!read_positive(argv[++i], LONG_MAX, &count)) {
+                cerr << "Error: --rays needs a number of rays, above 0" << endl;
+                return 4;
+            }
+
+            ray_count = (size_t) count;
+        } else if (strcmp(argv[i], "--inside") == 0 && i + 1 < argc) {
+            long count;
+
+            if (!read_positive(argv[++i], LONG_MAX, &count)) {
+                cerr << "Error: --inside needs a number of points, above 0" << endl;
+                return 4;
+            }
+
+            inside_points = (size_t) count;
+        } else if (strcmp(argv[i], "--collide") == 0 && i + 1 < argc) {
+            long count;
+
+            if (!read_positive(argv[++i], LONG_MAX, &count)) {
+                cerr << "Error: --collide needs a number of circles, above 0" << endl;
+                return 4;
+            }
+
+            collide_count = (size_t) count;
+        } else if (strcmp(argv[i], "--msdf") == 0 && i + 1 < argc) {
+            long count;
+
+            if (!read_positive(argv[++i], LONG_MAX, &count)) {
+                cerr << "Error: --msdf needs a number of shapes, above 0" << endl;
+                return 4;
+            }
+
+            msdf_count = (size_t) count;
+        } else if (strcmp(argv[i], "--ease") == 0 && i + 1 < argc) {
+            long count;
+
+            if (!read_positive(argv[++i], LONG_MAX, &count)) {
+                cerr << "Error: --ease needs a number of animations, above 0" << endl;
+                return 4;
+            }
+
+            ease_count = (size_t) count;
+        } else if (strcmp(argv[i], "--moments") == 0) {
+            find_moments = true;
+        } else if (strcmp(argv[i], "--video") == 0 && i + 1 < argc) {
+            long frames;
+
+            if (!read_positive(argv[++i], INT_MAX, &frames)) {
+                cerr << "Error: --video needs a number of frames, above 0" << endl;
+                return 4;
+            }
+
+            video_frames = (int) frames;
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            long fps;
+
+            if (!read_positive(argv[++i], INT_MAX, &fps)) {
+                cerr << "Error: --fps needs a number of frames per second, above 0" << endl;
+                return 4;
+            }
+
+            video_fps = (int) fps;
+        } else if ((strcmp(argv[i], "--svg") == 0 || strcmp(argv[i], "--pdf") == 0 || strcmp(argv[i], "--gcode") == 0)
+                   && i + 1 < argc) {
+            export_format = strcmp(argv[i], "--svg") == 0 ? EXPORT_SVG : strcmp(argv[i], "--pdf") == 0 ? EXPORT_PDF : EXPORT_GCODE;
+            export_file = argv[++i];
+        } else if (strcmp(argv[i], "--simplify") == 0) {
+            export_simplify = true;
+        } else if (strcmp(argv[i], "--no-arcs") == 0) {
+            export_arcs = false;
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            // Only used by --bench, --video and the exports; the windows are always W by H
+            if (sscanf(argv[++i], "%dx%d", &bench_width, &bench_height) != 2 || bench_width <= 0 || bench_height <= 0) {
+                cerr << "Error: --size should look like 1920x1080" << endl;
+                return 4;
+            }
+        } else if (strcmp(argv[i], "--cold") == 0) {
+            bench_cold = true;
+        } else if (strcmp(argv[i], "--raster") == 0 && i + 1 < argc) {
+            ++i;
+
+            if (strcmp(argv[i], "sdl") == 0) {
+                raster = RASTER_SDL;
+            } else if (strcmp(argv[i], "lines") == 0) {
+                raster = RASTER_LINES;
+            } else if (strcmp(argv[i], "direct") == 0) {
+                raster = RASTER_DIRECT;
+            } else if (strcmp(argv[i], "fill") == 0) {
+                raster = RASTER_FILL;
+            } else {
+                cerr << "Error: --raster should be sdl, lines, direct or fill" << endl;
+                return 4;
+            }
+        } else if (argv[i][0] == '-') {
+            cerr << "Usage: " << argv[0] << " [--trace out.json] [--perf]"
+                 << " [--raster sdl|lines|direct|fill] [--bench frames [--size WxH] [--cold]] [--rays count] [--inside count] [--collide count] [--msdf count] [--ease count] [--moments]"
+                 << " [--video frames [--fps N] [--size WxH]]"
+                 << " [--svg out.svg | --pdf out.pdf | --gcode out.gcode [--size WxH] [--simplify] [--no-arcs]]"
+                 << " [scene.txt]" << endl;
+            return 4;
+        } else {
+            scene_file = argv[i];
+        }
+    }
+
+    // The counters are reported on standard output, which is where the video goes
+    if (video_frames > 0 && count_perf) {
+        cerr << "Error: --perf can't be used with --video" << endl;
+        return 4;
+    }
+
+    // The benchmark, videos and exports don't need a display, so use SDL's 'dummy' video driver
+    // rather than failing on a machine which doesn't have one.
+    if (bench_frames > 0 || video_frames > 0 || export_file || ray_count > 0 || inside_points > 0 || collide_count > 0 || msdf_count > 0 || ease_count > 0 || find_moments) {
+        SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+    }
+
     // Initialise SDL
     if (SDL_Init(SDL_INIT_VIDEO) != 0) {
         cerr << "Error: Could not initialise SDL" << endl;
         return 1;
     }
 
-    SDL_Window *window = NULL;
-    SDL_Renderer *renderer = NULL;
+    if (trace_file) {
+        trace_start(trace_file);
+    }
+
+    // The benchmark always needs the time each stage takes
+    if (count_perf || bench_frames > 0) {
+        perf_start(count_perf);
+    }
 
-    // Create the window
-    if (SDL_CreateWindowAndRenderer(W, H, 0, &window, &renderer) != 0) {
-        cerr << "Error: Could not create window" << endl;
-        return 2;
+    Scene scene = {};
+
+    if (scene_file) {
+        // Load the scene from a file
+        TRACE_SCOPE("load scene");
+
+        if (!load_scene(scene_file, scene)) {
+            return 3;
+        }
+    } else {
+        // The scene; a quadratic bezier curve based on 3 fixed points (green),
+        // and a cubic bezier curve based on 4 fixed points (red).
+        add_curve(scene, QUAD_CURVE);
+        add_curve(scene, CUBIC_CURVE);
+        rebuild_scene(scene);
     }
 
-    // Clear the screen
-    clear(renderer);
+    if (export_file) {
+        // The whole scene, as the overview window shows it
+        Viewport page = {NULL, NULL, 0, Point{0.5, 0.5}, 1, bench_width, bench_height};
+        bool saved = export_scene(export_file, export_format, scene.curves, viewport_transform(page),
+                                  bench_width, bench_height, export_simplify, export_arcs);
 
-    // Draw a quadratic bezier curve based on 3 fixed points
-    draw_bezier_quadratic(renderer, Point{QUAD_P0_X, QUAD_P0_Y},
-                                    Point{QUAD_P1_X, QUAD_P1_Y},
-                                    Point{QUAD_P2_X, QUAD_P2_Y});
+        trace_finish();
+        SDL_Quit();
+        return saved ? 0 : 6;
+    }
 
-    // Draw a cubic bezier curve based on 4 fixed points
-    draw_bezier_cubic(renderer, Point{CUBIC_P0_X, CUBIC_P0_Y},
-                                Point{CUBIC_P1_X, CUBIC_P1_Y},
-                                Point{CUBIC_P2_X, CUBIC_P2_Y},
-                                Point{CUBIC_P3_X, CUBIC_P3_Y});
+    if (ray_count > 0) {
+        int result = run_rays(scene, ray_count);
 
-    // Display everything that we have drawn on the screen
-    SDL_RenderPresent(renderer);
+        trace_finish();
+        SDL_Quit();
+        return result;
+    }
+
+    if (inside_points > 0) {
+        int result = run_inside(scene, inside_points);
+
+        trace_finish();
+        SDL_Quit();
+        return result;
+    }
+
+    if (collide_count > 0) {
+        int result = run_collide(scene, collide_count, STEPS);
+
+        trace_finish();
+        SDL_Quit();
+        return result;
+    }
+
+    if (msdf_count > 0) {
+        int result = run_msdf(scene, msdf_count);
+
+        trace_finish();
+        SDL_Quit();
+        return result;
+    }
+
+    if (ease_count > 0) {
+        int result = run_easing(ease_count);
+
+        trace_finish();
+        SDL_Quit();
+        return result;
+    }
+
+    if (find_moments) {
+        int result = run_moments(scene, STEPS);
+
+        trace_finish();
+        SDL_Quit();
+        return result;
+    }
+
+    if (bench_frames > 0) {
+        int result = run_benchmark(scene, bench_frames, bench_width, bench_height, bench_cold, raster);
+
+        trace_finish();
+
+        // With --perf, also show the hardware counts for the whole benchmark
+        if (count_perf) {
+            perf_report_totals("benchmark");
+        }
+
+        perf_stop();
+        SDL_Quit();
+        return result;
+    }
+
+    if (video_frames > 0) {
+        int result = run_video(scene, video_frames, video_fps, bench_width, bench_height, raster);
+
+        trace_finish();
+        SDL_Quit();
+        return result;
+    }
+
+    std::vector<Curve>& curves = scene.curves;
+
+    TessellationCache cache = {};
+
+    // Create the windows; an overview of the whole scene,
+    // and a closer look at where the two curves cross.
+    std::vector<Viewport> viewports(2);
+
+    std::vector<FrameMemory> frames(viewports.size());
+
+    if (!open_viewport(viewports[0], "Overview", Point{0.5, 0.5}, 1, raster, frames[0]) ||
+        !open_viewport(viewports[1], "Detail", Point{0.45, 0.6}, 3, raster, frames[1])) {
+        cerr << "Error: Could not create window" << endl;
+        return 2;
+    }
+
+    // Draw the scene in every window
+    for (size_t i = 0; i < viewports.size(); ++i) {
+        draw_viewport(viewports[i], cache, curves);
+    }
 
     /*
-     * Nothing interesting from this point on;
-     * We just wait until we're told to quit, and then tidy up.
+     * From this point on, we wait until we're told to quit, and redraw
+     * any window which has moved around or been zoomed.
      */
 
     SDL_Event event;
     SDL_bool quit = SDL_FALSE;
+    size_t open_windows = viewports.size();
+
+    // The curve being dragged about, if any (see curve_at_pixel)
+    bool dragging = false;
+    size_t dragged = 0;
 
     while (!quit) {
+        bool scene_changed = false;
+        bool cache_stale = false;       // Curves have been added or reordered, not just moved
+
         while (SDL_PollEvent(&event)) {
+            Viewport *viewport;
+
             switch (event.type) {
+                case SDL_MOUSEBUTTONDOWN:
+                    viewport = find_viewport(viewports, event.button.windowID);
+
+                    if (!viewport || event.button.button != SDL_BUTTON_LEFT) {
+                        break;
+                    }
+
+                    add_curve(scene, curve_at_pixel(*viewport, event.button.x, event.button.y));
+                    dragging = true;
+                    dragged = curves.size() - 1;
+                    scene_changed = true;
+                    cache_stale = true;
+                    break;
+                case SDL_MOUSEMOTION:
+                    viewport = find_viewport(viewports, event.motion.windowID);
+
+                    if (!viewport || !dragging) {
+                        break;
+                    }
+
+                    // Only this one curve's points change, so the rest of the cache is kept
+                    edit_curve(scene, dragged, curve_at_pixel(*viewport, event.motion.x, event.motion.y));
+                    update_tessellated_curve(cache, curves, dragged);
+                    scene_changed = true;
+                    break;
+                case SDL_MOUSEBUTTONUP:
+                    // Only re-sort once the curve has been let go of, since that moves it somewhere else in the array
+                    if (dragging && event.button.button == SDL_BUTTON_LEFT) {
+                        dragging = false;
+
+                        if (rebuild_scene_if_needed(scene)) {
+                            scene_changed = true;
+                            cache_stale = true;
+                        }
+                    }
+                    break;
                 case SDL_KEYDOWN:
                     if (event.key.keysym.sym == SDLK_ESCAPE) {
                         quit = SDL_TRUE;
+                        break;
+                    }
+
+                    viewport = find_viewport(viewports, event.key.windowID);
+
+                    if (!viewport) {
+                        break;
+                    }
+
+                    // Move by a tenth of whatever the window currently shows
+                    switch (event.key.keysym.sym) {
+                        case SDLK_PLUS:
+                        case SDLK_EQUALS:
+                        case SDLK_KP_PLUS:  viewport->zoom *= 1.25f;                     break;
+                        case SDLK_MINUS:
+                        case SDLK_KP_MINUS: viewport->zoom /= 1.25f;                     break;
+                        case SDLK_LEFT:     viewport->centre.x -= 0.1f / viewport->zoom; break;
+                        case SDLK_RIGHT:    viewport->centre.x += 0.1f / viewport->zoom; break;
+                        case SDLK_UP:       viewport->centre.y -= 0.1f / viewport->zoom; break;
+                        case SDLK_DOWN:     viewport->centre.y += 0.1f / viewport->zoom; break;
+                    }
+
+                    draw_viewport(*viewport, cache, curves);
+                    break;
+                case SDL_WINDOWEVENT:
+                    viewport = find_viewport(viewports, event.window.windowID);
+
+                    if (!viewport) {
+                        break;
+                    }
+
+                    if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                        // Nothing has changed, so this is drawn straight from the cache
+                        draw_viewport(*viewport, cache, curves);
+                    } else if (event.window.event == SDL_WINDOWEVENT_CLOSE) {
+                        close_viewport(*viewport);
+
+                        if (--open_windows == 0) {
+                            quit = SDL_TRUE;
+                        }
                     }
                     break;
                 case SDL_QUIT:
@@ -285,16 +1587,30 @@ int main(int argc, char** argv) {
             }
         }
 
+        // If the cache holds the old curves' points (in the old order), throw it away, then draw everything again
+        if (cache_stale) {
+            invalidate_tessellation(cache);
+        }
+
+        if (scene_changed) {
+            for (size_t i = 0; i < viewports.size(); ++i) {
+                if (viewports[i].window) {
+                    draw_viewport(viewports[i], cache, curves);
+                }
+            }
+        }
+
         SDL_Delay(5);
     }
 
-    if (renderer) {
-        SDL_DestroyRenderer(renderer);
+    for (size_t i = 0; i < viewports.size(); ++i) {
+        close_viewport(viewports[i]);
     }
 
-    if (window) {
-        SDL_DestroyWindow(window);
-    }
+    invalidate_tessellation(cache);
+    trace_finish();
+    perf_report_totals("total");
+    perf_stop();
 
     SDL_Quit();
     return 0;
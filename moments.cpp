@@ -0,0 +1,169 @@
+/*
+ * libbezier; the area of shapes made of curves, where their middle is, and how it is spread out.
+ *
+ * Green's theorem turns an integral over the inside of a shape into one around its outline:
+ * for instance, the area is half of the integral of (x dy - y dx) all the way round. Along a
+ * Bezier curve, x and y are polynomials in t, so everything being integrated is a polynomial
+ * too, and polynomials can be integrated exactly (t^k becomes 1 / (k + 1) between 0 and 1).
+ * So the answers come straight from the control points, with no tessellating, and are exact
+ * apart from rounding; tessellating first always cuts the corners off curves, and needs
+ * a lot of points to get close.
+ *
+ * Every integral is a sum over the curves, so the results for several paths, or several parts
+ * of one, can be added together; which is what lets a big sum be split between threads.
+ */
+
+#include "bezier.hpp"
+
+
+/*
+ * Multiplying out all of those polynomials takes a lot of sums, though. There is a shortcut:
+ * 'Gauss-Legendre quadrature' adds up what is being integrated at a few carefully chosen
+ * positions, with carefully chosen weights, and with n positions the answer is exactly right
+ * for any polynomial up to degree 2n - 1. The biggest one needed here is x^3 dy/dt for a cubic
+ * curve, which has degree 3 * 3 + 2 = 11, so 6 positions are enough for all of them.
+ *
+ * These are the usual positions and weights, moved from -1..1 to 0..1.
+ */
+const int GAUSS_POINTS = 6;
+
+const double GAUSS_T[GAUSS_POINTS] = {
+    0.0337652428984239861, 0.169395306766867743, 0.380690406958401546,
+    0.619309593041598454, 0.830604693233132257, 0.966234757101576014
+};
+
+const double GAUSS_WEIGHT[GAUSS_POINTS] = {
+    0.0856622461895851725, 0.180380786524069303, 0.233956967286345524,
+    0.233956967286345524, 0.180380786524069303, 0.0856622461895851725
+};
+
+
+/*
+ * One coordinate of a curve as a polynomial c[0] + c[1] t + c[2] t^2 + c[3] t^3, from its control
+ * points (with 'degree' 1 for a straight line). These are the curves from tessellate_quadratic and
+ * tessellate_cubic in bezier.hpp, multiplied out.
+ */
+static void coefficients(const double *p, int degree, double *c) {
+    c[0] = p[0];
+
+    if (degree == 1) {
+        c[1] = p[1] - p[0];
+        c[2] = c[3] = 0;
+    } else if (degree == 2) {
+        c[1] = 2 * (p[1] - p[0]);
+        c[2] = p[2] - 2 * p[1] + p[0];
+        c[3] = 0;
+    } else {
+        c[1] = 3 * (p[1] - p[0]);
+        c[2] = 3 * (p[2] - 2 * p[1] + p[0]);
+        c[3] = p[3] - 3 * p[2] + 3 * p[1] - p[0];
+    }
+}
+
+
+/*
+ * Add one piece of outline (a curve, or a straight line with degree 1) to the integrals.
+ *
+ *   area = 1/2 of the integral of (x dy - y dx)
+ *   x    = 1/2 of the integral of x^2 dy
+ *   y    = -1/2 of the integral of y^2 dx
+ *   xx   = 1/3 of the integral of x^3 dy
+ *   yy   = -1/3 of the integral of y^3 dx
+ *   xy   = 1/4 of the integral of (x^2 y dy - x y^2 dx)
+ */
+static void add_piece(const bz_point *points, int degree, bz_moments& m) {
+    double px[4] = {}, py[4] = {}, cx[4], cy[4];
+
+    for (int i = 0; i <= degree; ++i) {
+        px[i] = points[i].x;
+        py[i] = points[i].y;
+    }
+
+    coefficients(px, degree, cx);
+    coefficients(py, degree, cy);
+
+    double area = 0, mx = 0, my = 0, mxx = 0, myy = 0, mxy = 0;
+
+    for (int i = 0; i < GAUSS_POINTS; ++i) {
+        double t = GAUSS_T[i], w = GAUSS_WEIGHT[i];
+        double x = ((cx[3] * t + cx[2]) * t + cx[1]) * t + cx[0];
+        double y = ((cy[3] * t + cy[2]) * t + cy[1]) * t + cy[0];
+        double dx = w * ((3 * cx[3] * t + 2 * cx[2]) * t + cx[1]);
+        double dy = w * ((3 * cy[3] * t + 2 * cy[2]) * t + cy[1]);
+        double xx_dy = x * x * dy, yy_dx = y * y * dx;
+
+        area += x * dy - y * dx;
+        mx += xx_dy;
+        my += yy_dx;
+        mxx += x * xx_dy;
+        myy += y * yy_dx;
+        mxy += y * xx_dy - x * yy_dx;
+    }
+
+    m.area += 0.5 * area;
+    m.x += 0.5 * mx;
+    m.y -= 0.5 * my;
+    m.xx += mxx / 3;
+    m.yy -= myy / 3;
+    m.xy += 0.25 * mxy;
+}
+
+
+void bz_path_moments(const bz_curve *curves, const size_t *path_ends, size_t path_count, bz_moments *out) {
+    size_t first = 0;
+
+    for (size_t path = 0; path < path_count; ++path) {
+        size_t end = path_ends[path];
+        bz_moments m = {};
+
+        for (size_t i = first; i < end; ++i) {
+            add_piece(curves[i].p, curves[i].degree, m);
+
+            // Join the end of each curve to the start of the next (or of the first, to close the path)
+            // with a straight line, if they don't already meet
+            const bz_curve& next = curves[i + 1 < end ? i + 1 : first];
+            bz_point join[2] = {curves[i].p[curves[i].degree], next.p[0]};
+
+            if (join[0].x != join[1].x || join[0].y != join[1].y) {
+                add_piece(join, 1, m);
+            }
+        }
+
+        out[path] = m;
+        first = end;
+    }
+}
+
+
+static void add_moments(bz_moments& total, const bz_moments& m) {
+    total.area += m.area;
+    total.x += m.x;
+    total.y += m.y;
+    total.xx += m.xx;
+    total.xy += m.xy;
+    total.yy += m.yy;
+}
+
+
+/*
+ * Adding up a long list one after another lets rounding errors pile up as the total grows
+ * much bigger than each thing being added. Adding the two halves separately (and each of
+ * their halves, and so on) keeps the numbers being added about the same size.
+ */
+const size_t PAIRWISE_MIN_COUNT = 16;
+
+bz_moments bz_moments_sum(const bz_moments *moments, size_t count) {
+    bz_moments total = {};
+
+    if (count <= PAIRWISE_MIN_COUNT) {
+        for (size_t i = 0; i < count; ++i) {
+            add_moments(total, moments[i]);
+        }
+
+        return total;
+    }
+
+    total = bz_moments_sum(moments, count / 2);
+    add_moments(total, bz_moments_sum(moments + count / 2, count - count / 2));
+    return total;
+}
@@ -0,0 +1,558 @@
+/*
+ * libbezier; multi-channel signed distance fields (MSDFs), for drawing shapes sharply at any size
+ * from one small texture.
+ *
+ * A signed distance field stores, in each texel, how far the texel is from the shape's outline
+ * (more than 0.5 inside, less outside). Drawing it at any size, with the GPU blending between
+ * texels, and keeping what is over 0.5, gives smooth outlines; but blending distances rounds off
+ * sharp corners. An MSDF keeps three distances instead, in red, green and blue, each to only some
+ * of the outline's curves, and the shape is wherever the middle one of the three (the 'median')
+ * is over 0.5. Each corner is where two curves of different colours meet, so the corner is kept
+ * by the channels which only see one of them; this is Viktor Chlumsky's method (msdfgen).
+ *
+ * Near a corner, the channel which doesn't see a curve would otherwise measure to the curve's end,
+ * and go round it; instead, past the end of a curve, the distance is to the straight line going on
+ * from its end (the 'pseudo-distance'), which keeps the corner sharp.
+ *
+ * The distances are all worked out in pixels, so any bz_transform works. Every texel only depends
+ * on the curves, so rows can be shared out between threads, as can shapes.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "bezier.hpp"
+
+
+/*
+ * The nearest point on a curve is found with Newton's method from NEAREST_STARTS places along it,
+ * NEAREST_STEPS steps each, as well as both ends; as msdfgen does for cubic curves.
+ */
+const int NEAREST_STARTS = 4;
+const int NEAREST_STEPS = 4;
+
+
+/*
+ * Each row is done SPAN_TEXELS texels at a time, and the curves are turned into pixels EDGE_BLOCK
+ * at a time for all of those texels together, rather than again for every texel. Both only need
+ * a few KB on the stack.
+ */
+const int SPAN_TEXELS = 32;
+const int EDGE_BLOCK = 32;
+
+
+/*
+ * The colours an edge can have, as which of red (1), green (2) and blue (4) see it.
+ */
+const uint8_t BLACK = 0;
+const uint8_t RED = 1;
+const uint8_t GREEN = 2;
+const uint8_t BLUE = 4;
+const uint8_t YELLOW = RED | GREEN;
+const uint8_t MAGENTA = RED | BLUE;
+const uint8_t CYAN = GREEN | BLUE;
+const uint8_t WHITE = RED | GREEN | BLUE;
+
+
+static inline float dot(bz_point a, bz_point b) {
+    return a.x * b.x + a.y * b.y;
+}
+
+
+static inline float cross(bz_point a, bz_point b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+
+static inline bz_point normalize(bz_point v) {
+    float length = std::sqrt(dot(v, v));
+    return length > 0 ? bz_point{v.x / length, v.y / length} : bz_point{0, 0};
+}
+
+
+/*
+ * Which way a curve goes as it leaves its start, or arrives at its end; from the next control
+ * point along which isn't on top of the end (so the direction is still right if it is).
+ */
+static bz_point start_direction(const bz_curve& curve) {
+    for (int i = 1; i <= curve.degree; ++i) {
+        bz_point d = {curve.p[i].x - curve.p[0].x, curve.p[i].y - curve.p[0].y};
+
+        if (d.x != 0 || d.y != 0) {
+            return normalize(d);
+        }
+    }
+
+    return bz_point{0, 0};
+}
+
+
+static bz_point end_direction(const bz_curve& curve) {
+    const bz_point& end = curve.p[curve.degree];
+
+    for (int i = curve.degree - 1; i >= 0; --i) {
+        bz_point d = {end.x - curve.p[i].x, end.y - curve.p[i].y};
+
+        if (d.x != 0 || d.y != 0) {
+            return normalize(d);
+        }
+    }
+
+    return bz_point{0, 0};
+}
+
+
+/*
+ * The next colour, from 'seed' (which changes each time, so that the colours don't follow
+ * a pattern), never 'banned' (if it is one of the two-channel colours); the same as msdfgen.
+ */
+static void switch_colour(uint8_t& colour, unsigned& seed, uint8_t banned = BLACK) {
+    uint8_t combined = colour & banned;
+
+    if (combined == RED || combined == GREEN || combined == BLUE) {
+        colour = combined ^ WHITE;
+        return;
+    }
+
+    if (colour == BLACK || colour == WHITE) {
+        const uint8_t start[3] = {CYAN, MAGENTA, YELLOW};
+        colour = start[seed % 3];
+        seed /= 3;
+        return;
+    }
+
+    int shifted = colour << (1 + (seed & 1));
+    colour = (shifted | shifted >> 3) & WHITE;
+    seed >>= 1;
+}
+
+
+/*
+ * -1, 0 or 1 for the first, middle and last third of n things.
+ */
+static int third(size_t position, size_t n) {
+    return (int) (3 + 2.875 * position / (n - 1) - 1.4375 + 0.5) - 3;
+}
+
+
+void bz_msdf_colour_edges(const bz_curve *curves, const size_t *path_ends, size_t path_count, float corner_angle,
+                          uint8_t *colours) {
+    float cross_threshold = std::sin(corner_angle);
+    unsigned seed = 0;
+    size_t first = 0;
+
+    for (size_t path = 0; path < path_count; ++path) {
+        size_t end = path_ends[path], count = end - first;
+        size_t corner_count = 0, first_corner = 0;
+
+        // A corner is where one curve arrives going a different way from the next one leaving:
+        // turning by more than pi - corner_angle, compared by their sines as msdfgen does
+        // (or by any amount at all, if they go back on each other)
+        for (size_t i = 0; i < count; ++i) {
+            bz_point arriving = end_direction(curves[first + (i + count - 1) % count]);
+            bz_point leaving = start_direction(curves[first + i]);
+
+            if (dot(arriving, leaving) <= 0 || std::fabs(cross(arriving, leaving)) > cross_threshold) {
+                if (corner_count++ == 0) {
+                    first_corner = i;
+                }
+            }
+        }
+
+        if (corner_count == 0 || (corner_count == 1 && count < 3)) {
+            // Smooth all the way round (or too few curves to colour a single corner), so every channel sees everything
+            std::fill(colours + first, colours + end, WHITE);
+        } else if (corner_count == 1) {
+            // A teardrop; the curves either side of its one corner need different colours, with a
+            // third one in the middle, so that they don't touch the other way round
+            uint8_t thirds[3] = {WHITE, WHITE, WHITE};
+            switch_colour(thirds[0], seed);
+            thirds[2] = thirds[0];
+            switch_colour(thirds[2], seed);
+
+            for (size_t i = 0; i < count; ++i) {
+                colours[first + (first_corner + i) % count] = thirds[1 + third(i, count)];
+            }
+        } else {
+            // A new colour at every corner, with the last one different from the first as well
+            uint8_t colour = WHITE;
+            switch_colour(colour, seed);
+            uint8_t first_colour = colour;
+            size_t corners_passed = 0;
+
+            for (size_t i = 0; i < count; ++i) {
+                size_t index = (first_corner + i) % count;
+                bz_point arriving = end_direction(curves[first + (index + count - 1) % count]);
+                bz_point leaving = start_direction(curves[first + index]);
+                bool corner = dot(arriving, leaving) <= 0 || std::fabs(cross(arriving, leaving)) > cross_threshold;
+
+                if (i > 0 && corner) {
+                    ++corners_passed;
+                    switch_colour(colour, seed, corners_passed == corner_count - 1 ? first_colour : BLACK);
+                }
+
+                colours[first + index] = colour;
+            }
+        }
+
+        first = end;
+    }
+}
+
+
+/*
+ * A curve in pixels, as polynomials in t, and the box around its control points.
+ */
+typedef struct {
+    float x[4], y[4];
+    float min_x, min_y, max_x, max_y;
+} Edge;
+
+
+static Edge edge_in_pixels(const bz_curve& curve, const bz_transform& transform) {
+    Edge edge;
+    float px[4], py[4];
+
+    for (int i = 0; i <= curve.degree; ++i) {
+        px[i] = curve.p[i].x * transform.scale_x + transform.offset_x;
+        py[i] = curve.p[i].y * transform.scale_y + transform.offset_y;
+    }
+
+    edge.min_x = *std::min_element(px, px + curve.degree + 1);
+    edge.max_x = *std::max_element(px, px + curve.degree + 1);
+    edge.min_y = *std::min_element(py, py + curve.degree + 1);
+    edge.max_y = *std::max_element(py, py + curve.degree + 1);
+
+    // The same sums as in moments.cpp
+    edge.x[0] = px[0];
+    edge.y[0] = py[0];
+
+    if (curve.degree == 2) {
+        edge.x[1] = 2 * (px[1] - px[0]);
+        edge.y[1] = 2 * (py[1] - py[0]);
+        edge.x[2] = px[2] - 2 * px[1] + px[0];
+        edge.y[2] = py[2] - 2 * py[1] + py[0];
+        edge.x[3] = edge.y[3] = 0;
+    } else {
+        edge.x[1] = 3 * (px[1] - px[0]);
+        edge.y[1] = 3 * (py[1] - py[0]);
+        edge.x[2] = 3 * (px[2] - 2 * px[1] + px[0]);
+        edge.y[2] = 3 * (py[2] - 2 * py[1] + py[0]);
+        edge.x[3] = px[3] - 3 * px[2] + 3 * px[1] - px[0];
+        edge.y[3] = py[3] - 3 * py[2] + 3 * py[1] - py[0];
+    }
+
+    return edge;
+}
+
+
+static inline bz_point point_at(const Edge& edge, float t) {
+    return bz_point{((edge.x[3] * t + edge.x[2]) * t + edge.x[1]) * t + edge.x[0],
+                    ((edge.y[3] * t + edge.y[2]) * t + edge.y[1]) * t + edge.y[0]};
+}
+
+
+static inline bz_point slope_at(const Edge& edge, float t) {
+    return bz_point{(3 * edge.x[3] * t + 2 * edge.x[2]) * t + edge.x[1],
+                    (3 * edge.y[3] * t + 2 * edge.y[2]) * t + edge.y[1]};
+}
+
+
+/*
+ * Which way the curve goes at t; if it stops there for a moment (as it can at the ends,
+ * when a control point is on top of the end), the way it goes just after.
+ */
+static bz_point direction_at(const Edge& edge, float t) {
+    bz_point slope = slope_at(edge, t);
+
+    if (slope.x == 0 && slope.y == 0) {
+        bz_point ahead = point_at(edge, t < 0.5f ? t + 1e-3f : t - 1e-3f), here = point_at(edge, t);
+        slope = t < 0.5f ? bz_point{ahead.x - here.x, ahead.y - here.y} : bz_point{here.x - ahead.x, here.y - ahead.y};
+    }
+
+    return normalize(slope);
+}
+
+
+/*
+ * How far a texel is from a curve, positive on the right of the way the curve goes (which is
+ * inside for outlines going clockwise on the screen), and how square the line to the nearest point
+ * meets the curve ('dot' is 0 when it is exactly square). Two curves meeting at a corner are
+ * exactly as far from a texel beyond the corner, and then the squarer one is the one it is
+ * really beyond, so it decides which side the texel is on.
+ */
+typedef struct {
+    float distance;
+    float dot;
+    float t;
+} Nearest;
+
+
+static inline bool closer(const Nearest& a, const Nearest& b) {
+    float a_distance = std::fabs(a.distance), b_distance = std::fabs(b.distance);
+    return a_distance < b_distance || (a_distance == b_distance && a.dot < b.dot);
+}
+
+
+static Nearest nearest(const Edge& edge, bz_point p) {
+    float best_t = 0, best = INFINITY;
+
+    for (int start = -1; start <= NEAREST_STARTS; ++start) {
+        // The two ends, and then Newton's method from evenly spaced places in between
+        float t = start < 0 ? 0 : start == NEAREST_STARTS ? 1 : (start + 0.5f) / NEAREST_STARTS;
+
+        for (int step = 0; step < (start < 0 || start == NEAREST_STARTS ? 0 : NEAREST_STEPS); ++step) {
+            bz_point q = point_at(edge, t), d = slope_at(edge, t);
+            bz_point dd = {6 * edge.x[3] * t + 2 * edge.x[2], 6 * edge.y[3] * t + 2 * edge.y[2]};
+            bz_point away = {q.x - p.x, q.y - p.y};
+
+            // (q - p) . dq/dt is 0 at the nearest point, and this is its slope
+            float f = dot(away, d), slope = dot(d, d) + dot(away, dd);
+
+            if (!(slope > 0)) {
+                break;
+            }
+
+            t = std::min(std::max(t - f / slope, 0.0f), 1.0f);
+        }
+
+        bz_point q = point_at(edge, t);
+        float distance2 = (q.x - p.x) * (q.x - p.x) + (q.y - p.y) * (q.y - p.y);
+
+        if (distance2 < best) {
+            best = distance2;
+            best_t = t;
+        }
+    }
+
+    bz_point q = point_at(edge, best_t), direction = direction_at(edge, best_t);
+    bz_point to_texel = {p.x - q.x, p.y - q.y};
+    float distance = std::sqrt(best);
+    float square = distance > 0 ? std::fabs(dot(direction, to_texel)) / distance : 0;
+
+    return Nearest{cross(direction, to_texel) >= 0 ? distance : -distance, square, best_t};
+}
+
+
+/*
+ * Past the end of a curve, the distance to the straight line going on from that end instead,
+ * if that is nearer (see the top of this file).
+ */
+static float pseudo_distance(const Edge& edge, bz_point p, const Nearest& near) {
+    if (near.t > 0 && near.t < 1) {
+        return near.distance;
+    }
+
+    bz_point end = point_at(edge, near.t), direction = direction_at(edge, near.t);
+    bz_point to_texel = {p.x - end.x, p.y - end.y};
+    float along = dot(to_texel, direction);
+
+    if ((near.t == 0 && along < 0) || (near.t == 1 && along > 0)) {
+        float across = cross(direction, to_texel);
+
+        if (std::fabs(across) <= std::fabs(near.distance)) {
+            return across;
+        }
+    }
+
+    return near.distance;
+}
+
+
+/*
+ * How far a point is from a box (0 inside it), which no curve inside the box can be nearer than.
+ */
+static inline float box_distance(const Edge& edge, bz_point p) {
+    float dx = std::max(std::max(edge.min_x - p.x, p.x - edge.max_x), 0.0f);
+    float dy = std::max(std::max(edge.min_y - p.y, p.y - edge.max_y), 0.0f);
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+
+static inline float median(float a, float b, float c) {
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+
+static inline uint32_t channel(float distance, float range) {
+    float value = std::min(std::max(0.5f + 0.5f * distance / range, 0.0f), 1.0f);
+    return (uint32_t) (value * 255 + 0.5f);
+}
+
+
+void bz_msdf_rows(bz_canvas *canvas, const bz_transform *transform, float range,
+                  const bz_curve *curves, const uint8_t *colours, size_t count,
+                  const bz_winding_grid *grid, int first_row, int row_count) {
+    int last_row = std::min(first_row + row_count, canvas->height);
+
+    for (int y = std::max(first_row, 0); y < last_row; ++y) {
+        uint32_t *row = canvas->pixels + (size_t) y * canvas->pitch;
+
+        for (int left = 0; left < canvas->width; left += SPAN_TEXELS) {
+            int span = std::min(SPAN_TEXELS, canvas->width - left);
+
+            // The nearest curve of each colour, and (in case a channel sees no curves at all) of any colour.
+            // The paths are closed, so the curves are the whole outline; there are no gaps to measure to
+            Nearest best[SPAN_TEXELS][4];
+            size_t best_edge[SPAN_TEXELS][4] = {};
+
+            for (int i = 0; i < span; ++i) {
+                for (int c = 0; c < 4; ++c) {
+                    best[i][c] = Nearest{INFINITY, 1, 0};
+                }
+            }
+
+            for (size_t first = 0; first < count; first += EDGE_BLOCK) {
+                size_t block = std::min(count - first, (size_t) EDGE_BLOCK);
+                Edge edges[EDGE_BLOCK];
+
+                for (size_t i = 0; i < block; ++i) {
+                    edges[i] = edge_in_pixels(curves[first + i], *transform);
+                }
+
+                for (int i = 0; i < span; ++i) {
+                    bz_point p = {left + i + 0.5f, y + 0.5f};
+
+                    for (size_t j = 0; j < block; ++j) {
+                        uint8_t colour = colours[first + j];
+                        float furthest = std::fabs(best[i][3].distance);
+
+                        for (int c = 0; c < 3; ++c) {
+                            if (colour & (1 << c)) {
+                                furthest = std::max(furthest, std::fabs(best[i][c].distance));
+                            }
+                        }
+
+                        // Further away than every channel's nearest curve so far, so it can't be nearer to any of them
+                        if (box_distance(edges[j], p) > furthest) {
+                            continue;
+                        }
+
+                        Nearest near = nearest(edges[j], p);
+
+                        for (int c = 0; c < 4; ++c) {
+                            if ((c == 3 || (colour & (1 << c))) && closer(near, best[i][c])) {
+                                best[i][c] = near;
+                                best_edge[i][c] = first + j;
+                            }
+                        }
+                    }
+                }
+            }
+
+            for (int i = 0; i < span; ++i) {
+                bz_point p = {left + i + 0.5f, y + 0.5f};
+                float distance[3];
+
+                for (int c = 0; c < 3; ++c) {
+                    int from = best[i][c].distance != INFINITY ? c : 3;
+                    distance[c] = count > 0 ? pseudo_distance(edge_in_pixels(curves[best_edge[i][from]], *transform), p, best[i][from])
+                                            : -INFINITY;
+                }
+
+                // Where outlines overlap or go round the wrong way, the nearest curve can say the wrong
+                // side; the winding number says the right one. As bezier.h says, the shape is wherever
+                // the paths go round clockwise more times than anticlockwise, so anticlockwise paths make holes
+                if (grid && count > 0) {
+                    bz_point point = {(p.x - transform->offset_x) / transform->scale_x, (p.y - transform->offset_y) / transform->scale_y};
+                    int32_t winding;
+                    bz_winding_numbers(grid, &point, 1, &winding);
+
+                    if ((median(distance[0], distance[1], distance[2]) > 0) != (winding > 0)) {
+                        for (int c = 0; c < 3; ++c) {
+                            distance[c] = -distance[c];
+                        }
+                    }
+                }
+
+                row[left + i] = 0xff000000 | channel(distance[0], range) << 16 | channel(distance[1], range) << 8
+                              | channel(distance[2], range);
+            }
+        }
+    }
+}
+
+
+/*
+ * Whether blending between two neighbouring texels would make the median go the wrong way
+ * somewhere in between; when two channels change by a lot at once, in opposite directions,
+ * they can both be wrong together. Only the texel further from the outline is picked out.
+ * The same test as msdfgen's.
+ */
+static bool clash(const float *a, const float *b, float threshold) {
+    float a0 = a[0], a1 = a[1], a2 = a[2];
+    float b0 = b[0], b1 = b[1], b2 = b[2];
+
+    // Sorted so that the channels which change most come first
+    if (std::fabs(b0 - a0) < std::fabs(b1 - a1)) {
+        std::swap(a0, a1);
+        std::swap(b0, b1);
+    }
+
+    if (std::fabs(b1 - a1) < std::fabs(b2 - a2)) {
+        std::swap(a1, a2);
+        std::swap(b1, b2);
+
+        if (std::fabs(b0 - a0) < std::fabs(b1 - a1)) {
+            std::swap(a0, a1);
+            std::swap(b0, b1);
+        }
+    }
+
+    return std::fabs(b1 - a1) >= threshold && !(b0 == b1 && b0 == b2) && std::fabs(a2 - 0.5f) >= std::fabs(b2 - 0.5f);
+}
+
+
+static inline void unpack(uint32_t pixel, float *rgb) {
+    rgb[0] = ((pixel >> 16) & 0xff) / 255.0f;
+    rgb[1] = ((pixel >> 8) & 0xff) / 255.0f;
+    rgb[2] = (pixel & 0xff) / 255.0f;
+}
+
+
+void bz_msdf_correct(bz_canvas *canvas, float range) {
+    // A bit over one texel's worth of change (each texel changes the distance by at most 1 pixel)
+    float threshold = 1.001f * 0.5f / range;
+
+    // First mark every texel which clashes with one of its neighbours, by clearing its alpha
+    // (which the test doesn't look at), so that fixing one doesn't change whether the next clashes
+    for (int y = 0; y < canvas->height; ++y) {
+        uint32_t *row = canvas->pixels + (size_t) y * canvas->pitch;
+
+        for (int x = 0; x < canvas->width; ++x) {
+            float here[3], there[3];
+            bool clashes = false;
+            unpack(row[x], here);
+
+            const int dx[4] = {-1, 1, 0, 0}, dy[4] = {0, 0, -1, 1};
+
+            for (int n = 0; n < 4 && !clashes; ++n) {
+                int nx = x + dx[n], ny = y + dy[n];
+
+                if (nx < 0 || ny < 0 || nx >= canvas->width || ny >= canvas->height) {
+                    continue;
+                }
+
+                unpack(canvas->pixels[(size_t) ny * canvas->pitch + nx], there);
+                clashes = clash(here, there, threshold);
+            }
+
+            if (clashes) {
+                row[x] &= 0x00ffffff;
+            }
+        }
+    }
+
+    // Then make every marked texel the same in all three channels (like a plain signed distance field)
+    for (int y = 0; y < canvas->height; ++y) {
+        uint32_t *row = canvas->pixels + (size_t) y * canvas->pitch;
+
+        for (int x = 0; x < canvas->width; ++x) {
+            if ((row[x] >> 24) == 0) {
+                uint32_t m = std::max(std::min((row[x] >> 16) & 0xff, (row[x] >> 8) & 0xff),
+                                      std::min(std::max((row[x] >> 16) & 0xff, (row[x] >> 8) & 0xff), row[x] & 0xff));
+                row[x] = 0xff000000 | m << 16 | m << 8 | m;
+            }
+        }
+    }
+}
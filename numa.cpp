@@ -0,0 +1,317 @@
+/*
+ * Pinned worker threads, huge pages and first-touch memory placement.
+ */
+
+#include "numa.hpp"
+#include "trace.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// Don't bother starting a thread for fewer curves than this
+const size_t MIN_CURVES_PER_THREAD = 4096;
+
+
+void *huge_alloc(size_t bytes) {
+    void *memory = MAP_FAILED;
+
+    if (bytes == 0) {
+        return NULL;
+    }
+
+#ifdef MAP_HUGETLB
+    // Pages which the administrator has set aside as huge pages.
+    // There usually aren't any, in which case we carry on below.
+    if (bytes >= HUGE_PAGE_SIZE && bytes % HUGE_PAGE_SIZE == 0) {
+        memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+
+    if (memory == MAP_FAILED) {
+        memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED) {
+            return NULL;
+        }
+
+#ifdef MADV_HUGEPAGE
+        // Ask the kernel to use 'transparent' huge pages for this memory instead
+        if (bytes >= HUGE_PAGE_SIZE) {
+            madvise(memory, bytes, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    return memory;
+}
+
+
+void huge_free(void *memory, size_t bytes) {
+    if (memory) {
+        munmap(memory, bytes);
+    }
+}
+
+
+/*
+ * Huge page mappings must be a whole number of huge pages long.
+ */
+static size_t round_up_bytes(size_t bytes) {
+    if (bytes < HUGE_PAGE_SIZE) {
+        return bytes;
+    }
+
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+
+/*
+ * Read a list of CPUs in the kernel's format, e.g. "0-7,16-23".
+ */
+static std::vector<int> parse_cpu_list(const char *text) {
+    std::vector<int> cpus;
+
+    while (*text) {
+        char *end;
+        int first = strtol(text, &end, 10);
+        int last = first;
+
+        if (end == text) {
+            break;
+        }
+
+        if (*end == '-') {
+            text = end + 1;
+            last = strtol(text, &end, 10);
+        }
+
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+
+        text = (*end == ',') ? end + 1 : end;
+    }
+
+    return cpus;
+}
+
+
+/*
+ * Find the CPUs which we are allowed to run on, along with the NUMA node of each.
+ * The list comes out grouped by node.
+ * On a machine without NUMA (or if we can't tell), everything is on node 0.
+ */
+static void find_cpus(std::vector<int>& cpus, std::vector<int>& nodes, int *node_count) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    *node_count = 0;
+
+    for (int node = 0; ; ++node) {
+        char path[64];
+        char text[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+
+        FILE *file = fopen(path, "r");
+
+        if (!file) {
+            break;
+        }
+
+        size_t length = fread(text, 1, sizeof(text) - 1, file);
+        text[length] = '\0';
+        fclose(file);
+
+        std::vector<int> node_cpus = parse_cpu_list(text);
+
+        for (size_t i = 0; i < node_cpus.size(); ++i) {
+            if (node_cpus[i] < CPU_SETSIZE && CPU_ISSET(node_cpus[i], &allowed)) {
+                cpus.push_back(node_cpus[i]);
+                nodes.push_back(node);
+            }
+        }
+
+        *node_count = node + 1;
+    }
+
+    if (cpus.empty()) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+                nodes.push_back(0);
+            }
+        }
+
+        *node_count = 1;
+    }
+}
+
+
+/*
+ * Keep the calling thread on one CPU, so that it always uses the same node's memory.
+ */
+static void pin_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+
+/*
+ * Run a job on every worker thread at once, and wait for them all to finish.
+ */
+template <typename Job>
+static void run_workers(const std::vector<NumaWorker>& workers, Job job) {
+    std::vector<std::thread> threads;
+
+    for (size_t w = 0; w < workers.size(); ++w) {
+        threads.push_back(std::thread([&workers, &job, w]() {
+            TRACE_THREAD_NAME("worker");
+            pin_to_cpu(workers[w].cpu);
+            job(workers[w]);
+        }));
+    }
+
+    for (size_t w = 0; w < threads.size(); ++w) {
+        threads[w].join();
+    }
+}
+
+
+/*
+ * Ask the kernel which node each page of a worker's memory is on, and count how many match the worker's node.
+ * We only look at a sample of the pages so that this stays quick for huge arrays.
+ */
+static void count_pages(const NumaWorker& worker, const void *start, size_t bytes, NumaStats *stats) {
+    const size_t MAX_SAMPLES = 256;
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t stride = std::max(page_size, bytes / MAX_SAMPLES);
+
+    void *pages[MAX_SAMPLES + 1];
+    int status[MAX_SAMPLES + 1];
+    unsigned long count = 0;
+
+    for (size_t offset = 0; offset < bytes && count <= MAX_SAMPLES; offset += stride) {
+        pages[count++] = (void *) (((size_t) start + offset) & ~(page_size - 1));
+    }
+
+#ifdef SYS_move_pages
+    // Passing no target nodes just asks where the pages are now, without moving them
+    if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0)
+#endif
+    {
+        stats->unknown_pages += count;
+        return;
+    }
+
+    for (unsigned long i = 0; i < count; ++i) {
+        if (status[i] < 0) {
+            stats->unknown_pages += 1;
+        } else if (status[i] == worker.node) {
+            stats->local_pages += 1;
+        } else {
+            stats->remote_pages += 1;
+        }
+    }
+}
+
+
+bool build_numa_curves(NumaCurves& numa_curves, const std::vector<Curve>& curves, int max_threads) {
+    std::vector<int> cpus;
+    std::vector<int> nodes;
+    find_cpus(cpus, nodes, &numa_curves.nodes);
+
+    // One thread per CPU, as long as each one gets a decent amount of work
+    size_t threads = std::min(cpus.size(), (size_t) std::max(max_threads, 1));
+    threads = std::max((size_t) 1, std::min(threads, curves.size() / MIN_CURVES_PER_THREAD));
+
+    // Pick CPUs spread evenly through the list, so that every node gets its share of threads.
+    // Neighbouring workers get neighbouring curves, which (thanks to the Morton order) are also
+    // neighbours on the screen.
+    numa_curves.workers.resize(threads);
+
+    for (size_t w = 0; w < threads; ++w) {
+        size_t c = w * cpus.size() / threads;
+
+        numa_curves.workers[w].cpu = cpus[c];
+        numa_curves.workers[w].node = nodes[c];
+        numa_curves.workers[w].first = w * curves.size() / threads;
+        numa_curves.workers[w].last = (w + 1) * curves.size() / threads;
+    }
+
+    numa_curves.count = curves.size();
+    numa_curves.bytes = round_up_bytes(curves.size() * sizeof(Curve));
+    numa_curves.curves = (Curve *) huge_alloc(numa_curves.bytes);
+
+    if (!numa_curves.curves) {
+        return false;
+    }
+
+    // Each worker copies in its own curves, so that they are placed in its node's memory
+    Curve *copy = numa_curves.curves;
+
+    run_workers(numa_curves.workers, [copy, &curves](const NumaWorker& worker) {
+        TRACE_SCOPE("copy curves");
+        std::copy(curves.begin() + worker.first, curves.begin() + worker.last, copy + worker.first);
+    });
+
+    return true;
+}
+
+
+void free_numa_curves(NumaCurves& numa_curves) {
+    huge_free(numa_curves.curves, numa_curves.bytes);
+    numa_curves.curves = NULL;
+    numa_curves.count = 0;
+    numa_curves.bytes = 0;
+    numa_curves.workers.clear();
+}
+
+
+bool parallel_tessellate(const NumaCurves& numa_curves, int steps, VertexArray& out, NumaStats *stats) {
+    size_t stride = steps + 1;
+
+    out.bytes = round_up_bytes(numa_curves.count * stride * sizeof(Point));
+    out.points = (Point *) huge_alloc(out.bytes);
+
+    if (!out.points) {
+        return false;
+    }
+
+    const Curve *curves = numa_curves.curves;
+    Point *points = out.points;
+
+    // Nothing has written to out.points yet, so every page lands on the node of
+    // the worker which fills it in.
+    run_workers(numa_curves.workers, [=](const NumaWorker& worker) {
+        TRACE_SCOPE("tessellate share");
+        bz_tessellate(curves + worker.first, worker.last - worker.first, steps, points + worker.first * stride);
+    });
+
+    if (stats) {
+        *stats = NumaStats{(int) numa_curves.workers.size(), numa_curves.nodes, 0, 0, 0};
+
+        for (size_t w = 0; w < numa_curves.workers.size(); ++w) {
+            const NumaWorker& worker = numa_curves.workers[w];
+
+            count_pages(worker, curves + worker.first, (worker.last - worker.first) * sizeof(Curve), stats);
+            count_pages(worker, points + worker.first * stride, (worker.last - worker.first) * stride * sizeof(Point), stats);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,102 @@
+/*
+ * Tessellating big scenes on every CPU at once.
+ *
+ * Large machines are often built from several 'NUMA nodes'; each node is a group of CPUs
+ * with its own memory attached. Any CPU can read any memory, but reading memory which belongs
+ * to another node ('remote' memory) is slower, and all of that traffic has to squeeze through
+ * the link between the nodes.
+ *
+ * Linux puts each page of memory on the node of the CPU which first writes to it ('first touch').
+ * So, if the thread which is going to work on part of an array is also the first one to write to it,
+ * and that thread stays on the same CPU, then all of its reads and writes stay on its own node.
+ *
+ * We also ask for 'huge pages' (2MB instead of 4KB) for the big arrays, so that the CPU needs far
+ * fewer entries in its address translation cache (the TLB) to walk through them.
+ */
+
+#ifndef NUMA_HPP
+#define NUMA_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "scene.hpp"
+
+
+/*
+ * Scenes smaller than this are tessellated on one thread;
+ * starting threads would take longer than the work itself.
+ */
+const size_t PARALLEL_MIN_CURVES = 16384;
+
+
+/*
+ * One thread's share of the work; the curves from first up to (but not including) last.
+ */
+typedef struct {
+    int cpu;
+    int node;
+    size_t first;
+    size_t last;
+} NumaWorker;
+
+
+/*
+ * A copy of the scene's curves, split between worker threads.
+ *
+ * Each worker's share of the curves was copied in by that worker, pinned to its CPU,
+ * so it lives in that worker's node's memory.
+ */
+typedef struct {
+    std::vector<NumaWorker> workers;
+    int nodes;
+    Curve *curves;
+    size_t count;
+    size_t bytes;
+} NumaCurves;
+
+
+/*
+ * Points for every curve in the scene, one curve after another.
+ */
+typedef struct {
+    Point *points;
+    size_t bytes;
+} VertexArray;
+
+
+/*
+ * Where the memory used by the last parallel tessellation actually ended up.
+ * A page is 'local' if it is on the same node as the worker which used it.
+ */
+typedef struct {
+    int threads;
+    int nodes;
+    size_t local_pages;
+    size_t remote_pages;
+    size_t unknown_pages;   // The kernel couldn't tell us (e.g. not running on Linux)
+} NumaStats;
+
+
+/*
+ * Memory which is only set up when it is first written to, on huge pages where possible.
+ * Returns NULL if there is no memory left.
+ */
+void *huge_alloc(size_t bytes);
+void huge_free(void *memory, size_t bytes);
+
+/*
+ * Copy the scene's curves and share them between worker threads; one per CPU (up to max_threads),
+ * spread evenly over the NUMA nodes. Returns false if there wasn't enough memory.
+ */
+bool build_numa_curves(NumaCurves& numa_curves, const std::vector<Curve>& curves, int max_threads);
+void free_numa_curves(NumaCurves& numa_curves);
+
+/*
+ * Tessellate every curve, with 'steps' line segments each, using all of the worker threads.
+ * Each worker writes the points for its own curves, so they end up in its own node's memory.
+ * Returns false if there wasn't enough memory.
+ */
+bool parallel_tessellate(const NumaCurves& numa_curves, int steps, VertexArray& out, NumaStats *stats);
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * libbezier; occlusion culling, or not drawing what can't be seen.
+ *
+ * When opaque shapes are drawn one on top of another, anything completely hidden behind
+ * shapes drawn later never shows up in the picture, but still costs as much to draw.
+ * So we go through the shapes backwards (front to back), keeping a rough map of which parts
+ * of the canvas are already hidden, and any shape which lands entirely on hidden parts can be
+ * skipped. The rest are then drawn forwards as usual.
+ *
+ * The map is kept in tiles of BZ_OCCLUSION_TILE pixels square, and a tile only counts as
+ * hidden once a single shape covers all of it. A shape covers a whole tile when none of its
+ * edges go near the tile and the middle of the tile is inside it; so for each row of tiles
+ * we mark the tiles which edges touch, then walk across the row's middle, counting the winding
+ * number (as in fill.cpp) to find the tiles which are inside.
+ *
+ * This never hides anything which would have shown; it only ever misses some chances
+ * to skip shapes, for instance where two shapes meet in the middle of a tile.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "bezier.hpp"
+
+
+// What each tile's byte means
+const uint8_t TILE_HIDDEN = 1;      // Completely covered by something in front
+const uint8_t TILE_TOUCHED = 2;     // An edge of the shape being added goes through it
+
+
+typedef struct {
+    float x;
+    int winding;
+} Crossing;
+
+
+size_t bz_occlusion_tiles(int width, int height) {
+    size_t tiles_across = (width + BZ_OCCLUSION_TILE - 1) / BZ_OCCLUSION_TILE;
+    size_t tiles_down = (height + BZ_OCCLUSION_TILE - 1) / BZ_OCCLUSION_TILE;
+    return tiles_across * tiles_down;
+}
+
+
+bz_occlusion bz_occlusion_make(uint8_t *tiles, int width, int height) {
+    return bz_occlusion{tiles,
+                        (width + BZ_OCCLUSION_TILE - 1) / BZ_OCCLUSION_TILE,
+                        (height + BZ_OCCLUSION_TILE - 1) / BZ_OCCLUSION_TILE};
+}
+
+
+void bz_occlusion_clear(bz_occlusion *occlusion) {
+    std::fill(occlusion->tiles, occlusion->tiles + (size_t) occlusion->tiles_across * occlusion->tiles_down, 0);
+}
+
+
+size_t bz_occlusion_buffer_size(size_t count) {
+    return count * sizeof(Crossing);
+}
+
+
+/*
+ * The range of tiles which a box (in canvas pixels) overlaps, clipped to the canvas.
+ * Returns false if it is entirely off the canvas.
+ */
+static bool tile_range(const bz_occlusion *occlusion, float min_x, float min_y, float max_x, float max_y,
+                       int *left, int *top, int *right, int *bottom) {
+    if (!(max_x >= 0 && max_y >= 0
+          && min_x < occlusion->tiles_across * BZ_OCCLUSION_TILE
+          && min_y < occlusion->tiles_down * BZ_OCCLUSION_TILE)) {
+        return false;
+    }
+
+    *left = (int) std::max(0.0f, std::floor(min_x / BZ_OCCLUSION_TILE));
+    *top = (int) std::max(0.0f, std::floor(min_y / BZ_OCCLUSION_TILE));
+    *right = (int) std::min((float) occlusion->tiles_across - 1, std::floor(max_x / BZ_OCCLUSION_TILE));
+    *bottom = (int) std::min((float) occlusion->tiles_down - 1, std::floor(max_y / BZ_OCCLUSION_TILE));
+    return true;
+}
+
+
+/*
+ * The box around a shape, in canvas pixels.
+ */
+static void shape_bounds(const bz_transform *transform, const bz_point *points, size_t count,
+                         float *min_x, float *min_y, float *max_x, float *max_y) {
+    *min_x = *min_y = INFINITY;
+    *max_x = *max_y = -INFINITY;
+
+    for (size_t i = 0; i < count; ++i) {
+        float x = points[i].x * transform->scale_x + transform->offset_x;
+        float y = points[i].y * transform->scale_y + transform->offset_y;
+        *min_x = std::min(*min_x, x);
+        *max_x = std::max(*max_x, x);
+        *min_y = std::min(*min_y, y);
+        *max_y = std::max(*max_y, y);
+    }
+}
+
+
+int bz_occlusion_hidden(const bz_occlusion *occlusion, const bz_transform *transform,
+                        const bz_point *points, size_t count) {
+    float min_x, min_y, max_x, max_y;
+    shape_bounds(transform, points, count, &min_x, &min_y, &max_x, &max_y);
+
+    int left, top, right, bottom;
+
+    if (!tile_range(occlusion, min_x, min_y, max_x, max_y, &left, &top, &right, &bottom)) {
+        // Nothing of it would be drawn anyway
+        return 1;
+    }
+
+    for (int ty = top; ty <= bottom; ++ty) {
+        const uint8_t *row = occlusion->tiles + (size_t) ty * occlusion->tiles_across;
+
+        for (int tx = left; tx <= right; ++tx) {
+            if (!(row[tx] & TILE_HIDDEN)) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+
+void bz_occlusion_add(bz_occlusion *occlusion, void *buffer, const bz_transform *transform,
+                      const bz_point *points, size_t count, bz_fill_rule rule) {
+    if (count < 3) {
+        return;
+    }
+
+    float min_x, min_y, max_x, max_y;
+    shape_bounds(transform, points, count, &min_x, &min_y, &max_x, &max_y);
+
+    int left, top, right, bottom;
+
+    if (!tile_range(occlusion, min_x, min_y, max_x, max_y, &left, &top, &right, &bottom)) {
+        return;
+    }
+
+    // Mark every tile in the box around each edge; some of them may not really be touched,
+    // but that only means missing the chance to hide them
+    for (size_t i = 0; i < count; ++i) {
+        const bz_point& from = points[i];
+        const bz_point& to = points[(i + 1) % count];
+
+        float x0 = from.x * transform->scale_x + transform->offset_x;
+        float y0 = from.y * transform->scale_y + transform->offset_y;
+        float x1 = to.x * transform->scale_x + transform->offset_x;
+        float y1 = to.y * transform->scale_y + transform->offset_y;
+
+        int edge_left, edge_top, edge_right, edge_bottom;
+
+        if (tile_range(occlusion, std::min(x0, x1), std::min(y0, y1), std::max(x0, x1), std::max(y0, y1),
+                       &edge_left, &edge_top, &edge_right, &edge_bottom)) {
+            for (int ty = edge_top; ty <= edge_bottom; ++ty) {
+                uint8_t *row = occlusion->tiles + (size_t) ty * occlusion->tiles_across;
+
+                for (int tx = edge_left; tx <= edge_right; ++tx) {
+                    row[tx] |= TILE_TOUCHED;
+                }
+            }
+        }
+    }
+
+    Crossing *crossings = (Crossing *) buffer;
+
+    for (int ty = top; ty <= bottom; ++ty) {
+        uint8_t *row = occlusion->tiles + (size_t) ty * occlusion->tiles_across;
+        float middle_y = (ty + 0.5f) * BZ_OCCLUSION_TILE;
+        size_t crossing_count = 0;
+
+        // Where the edges cross the middle of this row of tiles, from left to right
+        for (size_t i = 0; i < count; ++i) {
+            const bz_point& from = points[i];
+            const bz_point& to = points[(i + 1) % count];
+
+            float x0 = from.x * transform->scale_x + transform->offset_x;
+            float y0 = from.y * transform->scale_y + transform->offset_y;
+            float x1 = to.x * transform->scale_x + transform->offset_x;
+            float y1 = to.y * transform->scale_y + transform->offset_y;
+
+            if ((y0 <= middle_y) != (y1 <= middle_y)) {
+                float x = x0 + (middle_y - y0) * (x1 - x0) / (y1 - y0);
+                crossings[crossing_count++] = Crossing{x, y1 > y0 ? 1 : -1};
+            }
+        }
+
+        std::sort(crossings, crossings + crossing_count,
+                  [](const Crossing& a, const Crossing& b) { return a.x < b.x; });
+
+        // Walk across, counting the winding number up to the middle of each tile
+        size_t next = 0;
+        int winding = 0;
+
+        for (int tx = left; tx <= right; ++tx) {
+            float middle_x = (tx + 0.5f) * BZ_OCCLUSION_TILE;
+
+            while (next < crossing_count && crossings[next].x < middle_x) {
+                winding += crossings[next++].winding;
+            }
+
+            bool inside = rule == BZ_FILL_EVEN_ODD ? (winding & 1) != 0 : winding != 0;
+
+            if (inside && !(row[tx] & TILE_TOUCHED)) {
+                row[tx] |= TILE_HIDDEN;
+            }
+
+            row[tx] &= ~TILE_TOUCHED;
+        }
+    }
+}
@@ -0,0 +1,200 @@
+/*
+ * Reading the hardware performance counters with perf_event_open.
+ */
+
+#include "perf.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using std::cerr;
+using std::endl;
+
+
+bool perf_enabled = false;
+
+
+static const char *STAGE_NAMES[PERF_STAGES] = {"tessellate", "clear", "rasterize", "present"};
+
+// One counter for each field of PerfCounts, in the same order
+static const uint64_t COUNTER_CONFIGS[4] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+static int counter_fds[4] = {-1, -1, -1, -1};
+static bool hardware_open = false;
+
+static PerfCounts frame_counts[PERF_STAGES];
+static PerfCounts total_counts[PERF_STAGES];
+
+
+const char *perf_stage_name(PerfStage stage) {
+    return STAGE_NAMES[stage];
+}
+
+
+/*
+ * Open the CPU's counters. Returns false if any of them can't be opened.
+ */
+static bool open_counters() {
+    for (int i = 0; i < 4; ++i) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = COUNTER_CONFIGS[i];
+
+        // Only count our own code, which is all that most users are allowed to see
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        // Include worker threads started from now on
+        attr.inherit = 1;
+
+        // This process (0), on any CPU (-1)
+        counter_fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+        if (counter_fds[i] < 0) {
+            cerr << "Warning: Could not open performance counters (" << strerror(errno) << "); only timing stages" << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static void close_counters() {
+    for (int i = 0; i < 4; ++i) {
+        if (counter_fds[i] >= 0) {
+            close(counter_fds[i]);
+            counter_fds[i] = -1;
+        }
+    }
+}
+
+
+bool perf_start(bool hardware) {
+    hardware_open = hardware && open_counters();
+
+    if (hardware && !hardware_open) {
+        close_counters();
+    }
+
+    memset(frame_counts, 0, sizeof(frame_counts));
+    memset(total_counts, 0, sizeof(total_counts));
+    perf_enabled = true;
+    return hardware_open || !hardware;
+}
+
+
+void perf_stop() {
+    close_counters();
+    hardware_open = false;
+    perf_enabled = false;
+}
+
+
+PerfCounts perf_read() {
+    uint64_t values[4] = {0, 0, 0, 0};
+
+    if (hardware_open) {
+        for (int i = 0; i < 4; ++i) {
+            if (read(counter_fds[i], &values[i], sizeof(values[i])) != sizeof(values[i])) {
+                values[i] = 0;
+            }
+        }
+    }
+
+    uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                               std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    return PerfCounts{nanoseconds, values[0], values[1], values[2], values[3]};
+}
+
+
+void perf_add(PerfStage stage, const PerfCounts& start) {
+    PerfCounts end = perf_read();
+    PerfCounts delta = PerfCounts{end.nanoseconds - start.nanoseconds,
+                                  end.cycles - start.cycles,
+                                  end.instructions - start.instructions,
+                                  end.cache_misses - start.cache_misses,
+                                  end.branch_misses - start.branch_misses};
+
+    for (PerfCounts *counts : {&frame_counts[stage], &total_counts[stage]}) {
+        counts->nanoseconds += delta.nanoseconds;
+        counts->cycles += delta.cycles;
+        counts->instructions += delta.instructions;
+        counts->cache_misses += delta.cache_misses;
+        counts->branch_misses += delta.branch_misses;
+    }
+}
+
+
+/*
+ * One line per stage which did anything.
+ * Instructions per cycle and misses per thousand instructions make stages of different sizes easy to compare.
+ */
+static void print_counts(const char *label, const PerfCounts *counts) {
+    for (int stage = 0; stage < PERF_STAGES; ++stage) {
+        const PerfCounts& c = counts[stage];
+
+        if (c.nanoseconds == 0) {
+            continue;
+        }
+
+        printf("%s %-10s %10.3f ms", label, STAGE_NAMES[stage], c.nanoseconds / 1e6);
+
+        if (hardware_open) {
+            double ipc = c.cycles ? (double) c.instructions / c.cycles : 0;
+            double thousands = c.instructions ? c.instructions / 1000.0 : 1;
+
+            printf("  cycles %12llu  instructions %12llu  IPC %5.2f  "
+                   "cache misses %10llu (%6.2f/k instr)  branch misses %10llu (%6.2f/k instr)",
+                   (unsigned long long) c.cycles, (unsigned long long) c.instructions, ipc,
+                   (unsigned long long) c.cache_misses, c.cache_misses / thousands,
+                   (unsigned long long) c.branch_misses, c.branch_misses / thousands);
+        }
+
+        printf("\n");
+    }
+}
+
+
+void perf_end_frame(const char *label) {
+    if (!perf_enabled) {
+        return;
+    }
+
+    if (hardware_open) {
+        print_counts(label, frame_counts);
+    }
+
+    memset(frame_counts, 0, sizeof(frame_counts));
+}
+
+
+void perf_totals(PerfCounts *totals) {
+    memcpy(totals, total_counts, sizeof(total_counts));
+}
+
+
+void perf_report_totals(const char *label) {
+    if (!perf_enabled) {
+        return;
+    }
+
+    print_counts(label, total_counts);
+}
@@ -0,0 +1,121 @@
+/*
+ * Hardware performance counters.
+ *
+ * The CPU keeps count of things like how many clock cycles have gone by, how many instructions
+ * it has finished, how often it had to wait for memory (cache misses) and how often it guessed
+ * the wrong way at an 'if' (branch mispredictions).
+ *
+ * Comparing these for each stage of drawing tells us what is holding that stage back.
+ * Few instructions per cycle along with lots of cache misses means the stage spends its time
+ * waiting for memory, and it would benefit from touching less of it. Lots of instructions per
+ * cycle means it is busy computing, so it would benefit from doing less maths.
+ *
+ * Wrap a stage in PERF_SCOPE(PERF_TESSELLATE) and so on, and run with --perf.
+ * This needs Linux, and permission to read the counters (see /proc/sys/kernel/perf_event_paranoid).
+ *
+ * The time spent in each stage is always recorded once perf_start has been called,
+ * even if the hardware counters aren't available.
+ */
+
+#ifndef PERF_HPP
+#define PERF_HPP
+
+#include <cstdint>
+
+
+/*
+ * The stages which we count separately.
+ * Curves are evaluated as part of tessellating them, so that is counted under PERF_TESSELLATE.
+ */
+enum PerfStage {
+    PERF_TESSELLATE,
+    PERF_CLEAR,
+    PERF_RASTERIZE,
+    PERF_PRESENT,
+    PERF_STAGES
+};
+
+
+typedef struct {
+    uint64_t nanoseconds;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t cache_misses;
+    uint64_t branch_misses;
+} PerfCounts;
+
+
+/*
+ * A short name for a stage, for printing.
+ */
+const char *perf_stage_name(PerfStage stage);
+
+/*
+ * Set between perf_start and perf_stop. Checking this is all that PERF_SCOPE costs otherwise.
+ */
+extern bool perf_enabled;
+
+/*
+ * Start recording each stage.
+ * With 'hardware', also open the CPU's counters; returns false (after explaining why)
+ * if they can't be used, in which case only the time is recorded.
+ */
+bool perf_start(bool hardware);
+void perf_stop();
+
+/*
+ * The counts so far. Threads started after perf_start are included once they have finished.
+ */
+PerfCounts perf_read();
+
+/*
+ * Add the counts between start and now to a stage.
+ */
+void perf_add(PerfStage stage, const PerfCounts& start);
+
+/*
+ * Start counting a new frame. If the hardware counters are open,
+ * first print what each stage counted in the frame which just finished.
+ */
+void perf_end_frame(const char *label);
+
+/*
+ * What each stage counted since perf_start.
+ */
+void perf_totals(PerfCounts *totals);
+
+/*
+ * Print what each stage counted since perf_start.
+ */
+void perf_report_totals(const char *label);
+
+
+/*
+ * Counts between being created and going out of scope.
+ */
+class PerfScope {
+public:
+    PerfScope(PerfStage stage) : stage(stage) {
+        if (perf_enabled) {
+            start = perf_read();
+        }
+    }
+
+    ~PerfScope() {
+        if (perf_enabled) {
+            perf_add(stage, start);
+        }
+    }
+
+private:
+    PerfStage stage;
+    PerfCounts start;
+};
+
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+
+#define PERF_SCOPE(stage) PerfScope PERF_CONCAT(perf_scope_, __LINE__)(stage)
+
+#endif
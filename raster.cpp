@@ -0,0 +1,404 @@
+/*
+ * libbezier; drawing lines and curves into a block of memory (a 'canvas').
+ *
+ * This does the same job as SDL_RenderDrawLine, but without needing SDL or a window,
+ * so that curves can be drawn by programs which never show anything on the screen.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "bezier.hpp"
+
+
+void bz_canvas_clear(bz_canvas *canvas, uint32_t colour) {
+    for (int y = 0; y < canvas->height; ++y) {
+        uint32_t *row = canvas->pixels + (size_t) y * canvas->pitch;
+        std::fill(row, row + canvas->width, colour);
+    }
+}
+
+
+/*
+ * Cut a line down to just the part which is inside the canvas.
+ * Returns false if none of it is inside.
+ *
+ * This stops us from stepping through thousands of pixels which we can't see,
+ * when a zoomed-in curve runs a long way off the edge.
+ *
+ * (This is the 'Liang-Barsky' method; we think of the line as starting at
+ * interp = 0 and ending at interp = 1, and move the start and end inwards
+ * past each edge of the canvas in turn.)
+ */
+static bool clip_line(int width, int height, float *x0, float *y0, float *x1, float *y1) {
+    float dx = *x1 - *x0;
+    float dy = *y1 - *y0;
+    float start = 0;
+    float end = 1;
+
+    // For each edge: how fast the line moves towards the outside of it, and how far inside it the start is
+    float towards[4] = {-dx, dx, -dy, dy};
+    float inside[4] = {*x0, width - 1 - *x0, *y0, height - 1 - *y0};
+
+    for (int edge = 0; edge < 4; ++edge) {
+        if (towards[edge] == 0) {
+            // Parallel to this edge; either all inside or all outside
+            if (inside[edge] < 0) {
+                return false;
+            }
+        } else {
+            float crossing = inside[edge] / towards[edge];
+
+            if (towards[edge] < 0) {
+                start = std::max(start, crossing);
+            } else {
+                end = std::min(end, crossing);
+            }
+        }
+    }
+
+    if (start > end) {
+        return false;
+    }
+
+    *x1 = *x0 + end * dx;
+    *y1 = *y0 + end * dy;
+    *x0 = *x0 + start * dx;
+    *y0 = *y0 + start * dy;
+    return true;
+}
+
+
+/*
+ * Draw a line one pixel at a time (this is 'Bresenham's algorithm').
+ *
+ * We always take one step along the longer direction, and keep track of how far
+ * the line has drifted along the shorter direction ('error'). Whenever it has
+ * drifted by more than half a pixel, we take a step that way too.
+ * Everything is a whole number, so nothing builds up rounding errors.
+ */
+void bz_draw_line(bz_canvas *canvas, float fx0, float fy0, float fx1, float fy1, uint32_t colour) {
+    if (!clip_line(canvas->width, canvas->height, &fx0, &fy0, &fx1, &fy1)) {
+        return;
+    }
+
+    int x0 = (int) std::lround(fx0);
+    int y0 = (int) std::lround(fy0);
+    int x1 = (int) std::lround(fx1);
+    int y1 = (int) std::lround(fy1);
+
+    int dx = std::abs(x1 - x0);
+    int dy = -std::abs(y1 - y0);
+    int step_x = x0 < x1 ? 1 : -1;
+    int step_y = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+
+    while (true) {
+        canvas->pixels[(size_t) y0 * canvas->pitch + x0] = colour;
+
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+
+        int error2 = 2 * error;
+
+        if (error2 >= dy) {
+            error += dy;
+            x0 += step_x;
+        }
+
+        if (error2 <= dx) {
+            error += dx;
+            y0 += step_y;
+        }
+    }
+}
+
+
+/*
+ * Drawing lots of lines at once.
+ *
+ * Tessellated curves are made of many short lines of about the same length. Rather than
+ * drawing them one after another, we draw LANES of them side by side: on every step,
+ * we work out the next pixel of all of them with a single set of 'SIMD' (single
+ * instruction, multiple data) instructions, which do the same sum on several numbers at once.
+ *
+ * Each line is drawn as a 'DDA' (digital differential analyser); we split it into as many
+ * steps as it is pixels long in its longer direction, and on step k the pixel is at
+ * start + k * (end - start) / steps. Unlike Bresenham's method, there are no 'if's
+ * which depend on the line, so all of the lines can take their steps in lock-step.
+ *
+ * The vector types below are a GCC/Clang feature; the compiler turns them into SSE or AVX
+ * instructions on x86, NEON on ARM, or plain loops anywhere else. Vectors wider than the
+ * CPU's registers are much slower than narrow ones, so only use 8 lanes when AVX is turned on
+ * (e.g. with -march=native).
+ */
+#ifdef __AVX__
+const int LANES = 8;
+#else
+const int LANES = 4;
+#endif
+
+typedef float lane_float __attribute__((vector_size(LANES * sizeof(float))));
+typedef int32_t lane_int __attribute__((vector_size(LANES * sizeof(int32_t))));
+
+
+/*
+ * Lines waiting to be drawn together, already clipped to the canvas,
+ * and the box around all of them (to see whether another line could draw over them).
+ */
+typedef struct {
+    float x[LANES];
+    float y[LANES];
+    float step_x[LANES];    // How far each step moves
+    float step_y[LANES];
+    int32_t steps[LANES];
+    uint32_t colour[LANES];
+    int count;
+    bool mixed;             // Whether any of the lines are a different colour from the first
+    float min_x, min_y, max_x, max_y;
+} LineBatch;
+
+
+/*
+ * Where pixels live in an ordinary canvas; one row after another.
+ */
+typedef struct {
+    uint32_t *pixels;
+    int width;
+    int height;
+    int32_t pitch;
+
+    lane_int address(lane_int x, lane_int y) const {
+        return y * pitch + x;
+    }
+} LinearLayout;
+
+
+/*
+ * Where pixels live in a tiled canvas (see bz_tiled_canvas in bezier.h).
+ * The tile comes from the top bits of x and y, and the position within the tile from the bottom bits.
+ */
+typedef struct {
+    uint32_t *pixels;
+    int width;
+    int height;
+    int32_t tiles_across;
+
+    lane_int address(lane_int x, lane_int y) const {
+        const int32_t mask = BZ_TILE_SIZE - 1;
+        lane_int tile = (y / BZ_TILE_SIZE) * tiles_across + x / BZ_TILE_SIZE;
+        return tile * (BZ_TILE_SIZE * BZ_TILE_SIZE) + (y & mask) * BZ_TILE_SIZE + (x & mask);
+    }
+} TiledLayout;
+
+
+/*
+ * Draw every line in the batch, and empty it.
+ */
+template <typename Layout>
+static void draw_batch(LineBatch& batch, const Layout& layout) {
+    // Unused lanes get no steps, and are never drawn
+    for (int lane = batch.count; lane < LANES; ++lane) {
+        batch.x[lane] = batch.y[lane] = batch.step_x[lane] = batch.step_y[lane] = 0;
+        batch.steps[lane] = -1;
+    }
+
+    lane_float x, y, step_x, step_y;
+    lane_int steps;
+    memcpy(&x, batch.x, sizeof(x));
+    memcpy(&y, batch.y, sizeof(y));
+    memcpy(&step_x, batch.step_x, sizeof(step_x));
+    memcpy(&step_y, batch.step_y, sizeof(step_y));
+    memcpy(&steps, batch.steps, sizeof(steps));
+
+    int longest = *std::max_element(batch.steps, batch.steps + LANES);
+
+    for (int k = 0; k <= longest; ++k) {
+        // Every line's pixel for this step, all at once.
+        // Clipping means that nothing is below zero, so adding 0.5 and
+        // dropping the fraction rounds to the nearest pixel.
+        lane_float kf = (lane_float) {} + (float) k;
+        lane_int px = __builtin_convertvector(x + kf * step_x + 0.5f, lane_int);
+        lane_int py = __builtin_convertvector(y + kf * step_y + 0.5f, lane_int);
+        lane_int address = layout.address(px, py);
+
+        // Writing to memory can't be done all at once, because the pixels are all over the place
+        for (int lane = 0; lane < batch.count; ++lane) {
+            if (k <= batch.steps[lane]) {
+                layout.pixels[address[lane]] = batch.colour[lane];
+            }
+        }
+    }
+
+    batch.count = 0;
+}
+
+
+/*
+ * Add a line (in canvas pixels) to the batch, drawing the batch if it is full.
+ */
+template <typename Layout>
+static void add_line(LineBatch& batch, const Layout& layout, float x0, float y0, float x1, float y1, uint32_t colour) {
+    if (!clip_line(layout.width, layout.height, &x0, &y0, &x1, &y1)) {
+        return;
+    }
+
+    // The lines in a batch are drawn side by side rather than one after another, so where a line
+    // of a different colour from the others might cross them, which one ends up on top would be
+    // down to chance. To keep later curves on top, such a line waits for the next batch instead.
+    // (A pixel's box is a pixel wider than its line, to allow for rounding.)
+    float min_x = std::min(x0, x1) - 1, max_x = std::max(x0, x1) + 1;
+    float min_y = std::min(y0, y1) - 1, max_y = std::max(y0, y1) + 1;
+
+    if (batch.count > 0 && (batch.mixed || colour != batch.colour[0]) &&
+        min_x <= batch.max_x && max_x >= batch.min_x && min_y <= batch.max_y && max_y >= batch.min_y) {
+        draw_batch(batch, layout);
+    }
+
+    if (batch.count == 0) {
+        batch.mixed = false;
+        batch.min_x = min_x;
+        batch.min_y = min_y;
+        batch.max_x = max_x;
+        batch.max_y = max_y;
+    } else {
+        batch.mixed |= colour != batch.colour[0];
+        batch.min_x = std::min(batch.min_x, min_x);
+        batch.min_y = std::min(batch.min_y, min_y);
+        batch.max_x = std::max(batch.max_x, max_x);
+        batch.max_y = std::max(batch.max_y, max_y);
+    }
+
+    float length = std::max(std::fabs(x1 - x0), std::fabs(y1 - y0));
+    int steps = (int) std::ceil(length);
+
+    batch.x[batch.count] = x0;
+    batch.y[batch.count] = y0;
+    batch.step_x[batch.count] = steps ? (x1 - x0) / steps : 0;
+    batch.step_y[batch.count] = steps ? (y1 - y0) / steps : 0;
+    batch.steps[batch.count] = steps;
+    batch.colour[batch.count] = colour;
+
+    if (++batch.count == LANES) {
+        draw_batch(batch, layout);
+    }
+}
+
+
+/*
+ * Draw the output of bz_tessellate using either layout.
+ * Returns the number of lines drawn.
+ */
+template <typename Layout>
+static size_t rasterize_lines(const Layout& layout, const bz_transform *transform,
+                            const bz_curve *curves, size_t count, int steps, const bz_point *points) {
+    LineBatch batch;
+    batch.count = 0;
+
+    size_t lines = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const bz_point *curve_points = points + i * (steps + 1);
+        uint32_t colour = 0xff000000u | (curves[i].r << 16) | (curves[i].g << 8) | curves[i].b;
+
+        float prev_x = curve_points[0].x * transform->scale_x + transform->offset_x;
+        float prev_y = curve_points[0].y * transform->scale_y + transform->offset_y;
+
+        // Tiny or nearly straight curves only need a single pixel or line
+        CurveDetail detail = curve_detail(curves[i], *transform, COLLAPSE_TOLERANCE);
+
+        if (detail != DETAIL_FULL) {
+            float x = prev_x;
+            float y = prev_y;
+
+            if (detail == DETAIL_LINE) {
+                x = curve_points[steps].x * transform->scale_x + transform->offset_x;
+                y = curve_points[steps].y * transform->scale_y + transform->offset_y;
+            }
+
+            add_line(batch, layout, prev_x, prev_y, x, y, colour);
+            ++lines;
+            continue;
+        }
+
+        lines += steps;
+
+        for (int j = 1; j <= steps; ++j) {
+            float x = curve_points[j].x * transform->scale_x + transform->offset_x;
+            float y = curve_points[j].y * transform->scale_y + transform->offset_y;
+
+            add_line(batch, layout, prev_x, prev_y, x, y, colour);
+
+            prev_x = x;
+            prev_y = y;
+        }
+    }
+
+    if (batch.count > 0) {
+        draw_batch(batch, layout);
+    }
+
+    return lines;
+}
+
+
+size_t bz_rasterize(bz_canvas *canvas, const bz_transform *transform,
+                    const bz_curve *curves, size_t count, int steps, const bz_point *points) {
+    LinearLayout layout = {canvas->pixels, canvas->width, canvas->height, canvas->pitch};
+    return rasterize_lines(layout, transform, curves, count, steps, points);
+}
+
+
+/*
+ * A tiled canvas.
+ *
+ * In an ordinary canvas, one row of a 4K picture is 15KB long, so a line going down the
+ * picture touches a different part of memory for every single pixel, and the CPU's caches
+ * (which fetch memory in small blocks) and its address translation cache (the TLB) get
+ * very little reuse. Keeping the picture in small square tiles instead means that all of
+ * the pixels near each other, in any direction, share the same few KB of memory.
+ */
+size_t bz_tiled_canvas_pixels(int width, int height) {
+    size_t tiles_across = (width + BZ_TILE_SIZE - 1) / BZ_TILE_SIZE;
+    size_t tiles_down = (height + BZ_TILE_SIZE - 1) / BZ_TILE_SIZE;
+    return tiles_across * tiles_down * BZ_TILE_SIZE * BZ_TILE_SIZE;
+}
+
+
+bz_tiled_canvas bz_tiled_canvas_make(uint32_t *memory, int width, int height) {
+    return bz_tiled_canvas{memory, width, height, (width + BZ_TILE_SIZE - 1) / BZ_TILE_SIZE};
+}
+
+
+void bz_tiled_canvas_clear(bz_tiled_canvas *canvas, uint32_t colour) {
+    std::fill(canvas->pixels, canvas->pixels + bz_tiled_canvas_pixels(canvas->width, canvas->height), colour);
+}
+
+
+size_t bz_tiled_rasterize(bz_tiled_canvas *canvas, const bz_transform *transform,
+                          const bz_curve *curves, size_t count, int steps, const bz_point *points) {
+    TiledLayout layout = {canvas->pixels, canvas->width, canvas->height, canvas->tiles_across};
+    return rasterize_lines(layout, transform, curves, count, steps, points);
+}
+
+
+void bz_tiled_canvas_copy(const bz_tiled_canvas *tiled, bz_canvas *canvas) {
+    int width = std::min(tiled->width, canvas->width);
+    int height = std::min(tiled->height, canvas->height);
+
+    // One row of one tile at a time
+    for (int y = 0; y < height; ++y) {
+        uint32_t *row = canvas->pixels + (size_t) y * canvas->pitch;
+        size_t tile_row = (size_t) (y / BZ_TILE_SIZE) * tiled->tiles_across;
+
+        for (int x = 0; x < width; x += BZ_TILE_SIZE) {
+            const uint32_t *from = tiled->pixels
+                                 + (tile_row + x / BZ_TILE_SIZE) * BZ_TILE_SIZE * BZ_TILE_SIZE
+                                 + (y % BZ_TILE_SIZE) * BZ_TILE_SIZE;
+
+            std::copy(from, from + std::min(BZ_TILE_SIZE, width - x), row + x);
+        }
+    }
+}
@@ -0,0 +1,472 @@
+/*
+ * libbezier; drawing quadratic curves straight onto a canvas, one pixel at a time,
+ * without splitting them into line segments first.
+ *
+ * Bresenham's line algorithm (see raster.cpp) walks along a line one pixel at a time,
+ * keeping track of how far the pixels have drifted from the true line in an 'error' value,
+ * and only ever adding to it. The same trick works for quadratic curves; the error just
+ * changes by a different amount on each step, and those amounts are themselves updated
+ * by adding (the 'second differences'), because a quadratic curve bends at a steady rate.
+ *
+ * The result is a gap-free, '8-connected' line of pixels (each one touching the next along a side
+ * or at a corner), and it takes time in proportion to how many pixels long the curve is rather
+ * than to STEPS. It is only an approximation, though; the control points are rounded to whole
+ * pixels, and the error is in the units of the curve's equation rather than pixels, so it only
+ * roughly says which pixel is nearer. Pixels can be up to 2 pixels from the exact curve (which
+ * --bench --raster direct checks), although most are within 1.
+ *
+ * This follows Alois Zingl's 'A Rasterizing Algorithm for Drawing Curves' (2012), which
+ * explains where every one of these numbers comes from.
+ *
+ * The walk only works while the curve keeps heading the same way in both x and y,
+ * so each curve is first cut at the points where it turns around.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "bezier.hpp"
+
+
+/*
+ * Control points further than this from the canvas are handled by cutting the curve in half
+ * until the pieces are small enough; this keeps every sum below comfortably inside 64 bits.
+ */
+const float MAX_COORDINATE = 1 << 20;
+
+
+/*
+ * The most times a piece of a rational curve is halved to bring its weight up; each halving takes
+ * the weight most of the way to 1, so this is only reached by weights within a rounding error of 0.
+ */
+const int MAX_HALVINGS = 20;
+
+
+static inline void set_pixel(bz_canvas *canvas, long x, long y, uint32_t colour) {
+    if (x >= 0 && y >= 0 && x < canvas->width && y < canvas->height) {
+        canvas->pixels[(size_t) y * canvas->pitch + x] = colour;
+    }
+}
+
+
+/*
+ * Draw one piece of a quadratic curve which doesn't turn around in x or y.
+ */
+static void draw_quadratic_segment(bz_canvas *canvas, long x0, long y0, long x1, long y1, long x2, long y2, uint32_t colour) {
+    long sx = x2 - x1;
+    long sy = y2 - y1;
+    long xx = x0 - x1;
+    long yy = y0 - y1;
+    long xy;
+    double dx, dy, err;
+    double cur = (double) xx * sy - (double) yy * sx;     // How much (and which way) the curve bends
+
+    // Start from whichever end has the longer part, where the curve is flattest
+    if (sx * sx + sy * sy > xx * xx + yy * yy) {
+        x2 = x0;
+        x0 = sx + x1;
+        y2 = y0;
+        y0 = sy + y1;
+        cur = -cur;
+    }
+
+    // A curve which doesn't bend is just a line, which the end of this function draws
+    if (cur != 0) {
+        xx += sx;
+        xx *= sx = x0 < x2 ? 1 : -1;        // Which way we step in x
+        yy += sy;
+        yy *= sy = y0 < y2 ? 1 : -1;        // Which way we step in y
+
+        // How much the error's steps change by, on each step (the second differences)
+        xy = 2 * xx * yy;
+        xx *= xx;
+        yy *= yy;
+
+        if (cur * sx * sy < 0) {
+            xx = -xx;
+            yy = -yy;
+            xy = -xy;
+            cur = -cur;
+        }
+
+        // How much the error changes by, for a step in x or in y (the first differences)
+        dx = 4.0 * sy * cur * (x1 - x0) + xx - xy;
+        dy = 4.0 * sx * cur * (y0 - y1) + yy - xy;
+        xx += xx;
+        yy += yy;
+        err = dx + dy + xy;
+
+        do {
+            set_pixel(canvas, x0, y0, colour);
+
+            if (x0 == x2 && y0 == y2) {
+                return;
+            }
+
+            // Step in x, y or both; whichever keeps us closest to the curve
+            bool step_y = 2 * err < dx;
+
+            if (2 * err > dy) {
+                x0 += sx;
+                dx -= xy;
+                err += dy += yy;
+            }
+
+            if (step_y) {
+                y0 += sy;
+                dy -= xy;
+                err += dx += xx;
+            }
+        } while (dy < 0 && dx > 0);
+        // (When the differences change sign the curve has become so nearly straight
+        // that the steps above can't follow it, so we finish off with a line.)
+    }
+
+    bz_draw_line(canvas, x0, y0, x2, y2, colour);
+}
+
+
+/*
+ * Draw one piece of a rational quadratic curve which doesn't turn around in x or y.
+ *
+ * A 'rational' curve gives its middle control point a weight, w, which says how strongly
+ * it pulls the curve towards it. A weight of 1 is an ordinary quadratic curve; other weights
+ * give exact circles, ellipses and hyperbolas, which ordinary Bezier curves can't.
+ * Here, w is the weight squared.
+ */
+static void draw_rational_segment(bz_canvas *canvas, long x0, long y0, long x1, long y1, long x2, long y2,
+                                  double w, uint32_t colour) {
+    long sx = x2 - x1;
+    long sy = y2 - y1;
+    double dx = x0 - x2;
+    double dy = y0 - y2;
+    double xx = x0 - x1;
+    double yy = y0 - y1;
+    double xy = xx * sy + yy * sx;
+    double cur = xx * sy - yy * sx;
+    double err;
+
+    if (cur != 0.0 && w > 0.0) {
+        if (sx * sx + sy * sy > xx * xx + yy * yy) {
+            x2 = x0;
+            x0 -= dx;
+            y2 = y0;
+            y0 -= dy;
+            cur = -cur;
+        }
+
+        xx = 2.0 * (4.0 * w * sx * xx + dx * dx);
+        yy = 2.0 * (4.0 * w * sy * yy + dy * dy);
+        sx = x0 < x2 ? 1 : -1;
+        sy = y0 < y2 ? 1 : -1;
+        xy = -2.0 * sx * sy * (2.0 * w * xy + dx * dy);
+
+        if (cur * sx * sy < 0.0) {
+            xx = -xx;
+            yy = -yy;
+            xy = -xy;
+            cur = -cur;
+        }
+
+        dx = 4.0 * w * (x1 - x0) * sy * cur + xx / 2.0 + xy;
+        dy = 4.0 * w * (y0 - y1) * sx * cur + yy / 2.0 + xy;
+
+        // Very flat ellipses (small weights) can bend too suddenly for the walk to follow, and it would
+        // finish them off with a straight line, so cut them in half and draw each half on its own.
+        // Zingl only cuts when the first steps show the walk failing, but that misses some which fail
+        // later on; the halves always have a weight of at least sqrt(1/2), which the walk can follow.
+        if (w < 0.5) {
+            cur = (w + 1.0) / 2.0;
+            w = std::sqrt(w);
+            xy = 1.0 / (w + 1.0);
+
+            long mid_x = std::floor((x0 + 2.0 * w * x1 + x2) * xy / 2.0 + 0.5);
+            long mid_y = std::floor((y0 + 2.0 * w * y1 + y2) * xy / 2.0 + 0.5);
+
+            draw_rational_segment(canvas, x0, y0, std::floor((w * x1 + x0) * xy + 0.5), std::floor((w * y1 + y0) * xy + 0.5),
+                                  mid_x, mid_y, cur, colour);
+            draw_rational_segment(canvas, mid_x, mid_y, std::floor((w * x1 + x2) * xy + 0.5), std::floor((w * y1 + y2) * xy + 0.5),
+                                  x2, y2, cur, colour);
+            return;
+        }
+
+        err = dx + dy - xy;
+
+        do {
+            set_pixel(canvas, x0, y0, colour);
+
+            if (x0 == x2 && y0 == y2) {
+                return;
+            }
+
+            bool step_x = 2 * err > dy;
+            bool step_y = 2 * (err + yy) < -dy;
+
+            if (2 * err < dx || step_y) {
+                y0 += sy;
+                dy += xy;
+                err += dx += xx;
+            }
+
+            if (2 * err > dx || step_x) {
+                x0 += sx;
+                dx += xy;
+                err += dy += yy;
+            }
+        } while (dy <= xy && dx >= xy);
+    }
+
+    bz_draw_line(canvas, x0, y0, x2, y2, colour);
+}
+
+
+/*
+ * Where (from 0 to 1) one coordinate of a rational quadratic curve turns around, given that coordinate
+ * of its three control points and the middle one's weight; or -1 if it never does. It only turns
+ * around if the middle control point is beyond both ends.
+ */
+static double turn_at(double a0, double a1, double a2, double w) {
+    if ((a0 - a1) * (a2 - a1) <= 0) {
+        return -1;
+    }
+
+    if (a0 == a2 || w == 1) {
+        return (a0 - a1) / (a0 - 2 * a1 + a2);
+    }
+
+    double q = std::sqrt(4 * w * w * (a0 - a1) * (a2 - a1) + (a2 - a0) * (a2 - a0));
+
+    if (a1 < a0) {
+        q = -q;
+    }
+
+    return (2 * w * (a0 - a1) - a0 + a2 + q) / (2 * (1 - w) * (a2 - a0));
+}
+
+
+/*
+ * Draw any rational quadratic curve with whole-number control points (w being 1 for an ordinary one),
+ * cutting it where it turns around in x and in y, so that each piece can be drawn by
+ * draw_quadratic_segment or draw_rational_segment.
+ *
+ * Every piece is cut from the exact curve; cutting the rounded-off remainder of the first cut again
+ * would add up the rounding, and leave gaps near the second turn. Where two pieces meet, the curve is
+ * heading straight along one axis, so the middle control points on both sides of the cut are level
+ * with it in that direction, and use exactly the same rounded number as the cut itself; and each
+ * piece's middle control point is kept within the box between its ends, so no piece can turn around.
+ *
+ * The pieces are worked out with 'homogeneous' coordinates, which are just the control points
+ * multiplied by their weights; cutting those is the same as cutting an ordinary curve.
+ * Pieces whose weight is too small for draw_rational_segment to follow are halved here too, while
+ * they are still exact, rather than by draw_rational_segment after every point has been rounded off.
+ */
+static void draw_quadratic_pixels(bz_canvas *canvas, long x0, long y0, long x1, long y1, long x2, long y2,
+                                  double w, uint32_t colour) {
+    double turn_x = turn_at(x0, x1, x2, w), turn_y = turn_at(y0, y1, y2, w);
+    double cuts[4] = {0};
+    int cut_count = 1;
+
+    for (double t : {std::min(turn_x, turn_y), std::max(turn_x, turn_y)}) {
+        if (t > cuts[cut_count - 1] && t < 1) {
+            cuts[cut_count++] = t;
+        }
+    }
+
+    cuts[cut_count] = 1;
+
+    // The weighted sum of the control points for a pair of places along the curve (their 'blossom');
+    // the same place twice is a point on the curve, and two ends of a piece give its middle control point
+    auto blossom = [&](double a, double b, double *x, double *y, double *weight) {
+        double p0 = (1 - a) * (1 - b), p1 = (1 - a) * b + a * (1 - b), p2 = a * b;
+        *weight = p0 + p1 * w + p2;
+        *x = (p0 * x0 + p1 * w * x1 + p2 * x2) / *weight;
+        *y = (p0 * y0 + p1 * w * y1 + p2 * y2) / *weight;
+    };
+
+    long start_x = x0, start_y = y0;
+    double start_weight = 1;
+
+    for (int i = 0; i < cut_count; ++i) {
+        double a = cuts[i];
+
+        while (a < cuts[i + 1]) {
+            double b = cuts[i + 1];
+            double end_x, end_y, end_weight, middle_x, middle_y, middle_weight, piece_w;
+
+            // (The ends get a weight of 1, which changes the middle one's to match)
+            for (int halvings = 0; ; ++halvings) {
+                blossom(b, b, &end_x, &end_y, &end_weight);
+                blossom(a, b, &middle_x, &middle_y, &middle_weight);
+                piece_w = middle_weight / std::sqrt(start_weight * end_weight);
+
+                if (piece_w * piece_w >= 0.5 || halvings == MAX_HALVINGS) {
+                    break;
+                }
+
+                b = (a + b) / 2;
+            }
+
+            long x = b == 1 ? x2 : std::lround(end_x);
+            long y = b == 1 ? y2 : std::lround(end_y);
+            long mx = a == turn_x ? start_x : b == turn_x ? x : std::lround(middle_x);
+            long my = a == turn_y ? start_y : b == turn_y ? y : std::lround(middle_y);
+            mx = std::min(std::max(mx, std::min(start_x, x)), std::max(start_x, x));
+            my = std::min(std::max(my, std::min(start_y, y)), std::max(start_y, y));
+
+            if (w == 1) {
+                draw_quadratic_segment(canvas, start_x, start_y, mx, my, x, y, colour);
+            } else {
+                draw_rational_segment(canvas, start_x, start_y, mx, my, x, y, piece_w * piece_w, colour);
+            }
+
+            start_x = x;
+            start_y = y;
+            start_weight = end_weight;
+            a = b;
+        }
+    }
+}
+
+
+/*
+ * Is the box around these control points completely off the canvas?
+ * (A curve never leaves the box around its control points.)
+ */
+static bool off_canvas(const bz_canvas *canvas, const bz_point *p, int count) {
+    float min_x = p[0].x, max_x = p[0].x, min_y = p[0].y, max_y = p[0].y;
+
+    for (int i = 1; i < count; ++i) {
+        min_x = std::min(min_x, p[i].x);
+        max_x = std::max(max_x, p[i].x);
+        min_y = std::min(min_y, p[i].y);
+        max_y = std::max(max_y, p[i].y);
+    }
+
+    return max_x < -1 || max_y < -1 || min_x > canvas->width || min_y > canvas->height;
+}
+
+
+static bool too_far(const bz_point *p, int count) {
+    for (int i = 0; i < count; ++i) {
+        if (std::fabs(p[i].x) > MAX_COORDINATE || std::fabs(p[i].y) > MAX_COORDINATE) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/*
+ * Draw a rational quadratic curve in canvas pixels, cutting it in half first
+ * while it is too big for the sums to stay exact.
+ */
+static void draw_rational_clipped(bz_canvas *canvas, const bz_point *p, double w, uint32_t colour, int depth) {
+    if (off_canvas(canvas, p, 3)) {
+        return;
+    }
+
+    if (depth < 32 && too_far(p, 3)) {
+        // Cut in half (the rational version of de Casteljau's interpolation).
+        // Each half's middle point moves halfway towards the old middle point,
+        // and both halves get the weight sqrt((1 + w) / 2).
+        bz_point mid_left = Point{(float) ((p[0].x + w * p[1].x) / (1 + w)), (float) ((p[0].y + w * p[1].y) / (1 + w))};
+        bz_point mid_right = Point{(float) ((w * p[1].x + p[2].x) / (1 + w)), (float) ((w * p[1].y + p[2].y) / (1 + w))};
+        bz_point middle = lerp(0.5f, mid_left, mid_right);
+        double half_w = std::sqrt((1 + w) / 2);
+
+        bz_point left[3] = {p[0], mid_left, middle};
+        bz_point right[3] = {middle, mid_right, p[2]};
+
+        draw_rational_clipped(canvas, left, half_w, colour, depth + 1);
+        draw_rational_clipped(canvas, right, half_w, colour, depth + 1);
+        return;
+    }
+
+    if (too_far(p, 3)) {
+        return;
+    }
+
+    draw_quadratic_pixels(canvas, std::lround(p[0].x), std::lround(p[0].y),
+                          std::lround(p[1].x), std::lround(p[1].y),
+                          std::lround(p[2].x), std::lround(p[2].y), w, colour);
+}
+
+
+void bz_draw_quadratic(bz_canvas *canvas, float x0, float y0, float x1, float y1, float x2, float y2, uint32_t colour) {
+    bz_point p[3] = {{x0, y0}, {x1, y1}, {x2, y2}};
+
+    // An ordinary quadratic curve is a rational one with a weight of 1;
+    // this only takes the rational path when it needs cutting up.
+    if (!off_canvas(canvas, p, 3) && !too_far(p, 3)) {
+        draw_quadratic_pixels(canvas, std::lround(x0), std::lround(y0), std::lround(x1), std::lround(y1),
+                              std::lround(x2), std::lround(y2), 1, colour);
+    } else {
+        draw_rational_clipped(canvas, p, 1, colour, 0);
+    }
+}
+
+
+void bz_draw_rational_quadratic(bz_canvas *canvas, float x0, float y0, float x1, float y1, float x2, float y2,
+                                float w, uint32_t colour) {
+    bz_point p[3] = {{x0, y0}, {x1, y1}, {x2, y2}};
+
+    if (w < 0) {
+        return;
+    }
+
+    draw_rational_clipped(canvas, p, w, colour, 0);
+}
+
+
+size_t bz_rasterize_direct(bz_canvas *canvas, const bz_transform *transform,
+                           const bz_curve *curves, size_t count, int cubic_steps) {
+    size_t lines = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        const bz_curve& curve = curves[i];
+        uint32_t colour = 0xff000000u | (curve.r << 16) | (curve.g << 8) | curve.b;
+        bz_point p[4];
+
+        for (int j = 0; j <= curve.degree; ++j) {
+            p[j] = Point{curve.p[j].x * transform->scale_x + transform->offset_x,
+                         curve.p[j].y * transform->scale_y + transform->offset_y};
+        }
+
+        if (curve.degree == 2) {
+            bz_draw_quadratic(canvas, p[0].x, p[0].y, p[1].x, p[1].y, p[2].x, p[2].y, colour);
+            continue;
+        }
+
+        if (off_canvas(canvas, p, 4)) {
+            continue;
+        }
+
+        // Cubic curves are still drawn as line segments, worked out as we go,
+        // unless they are small or straight enough for a single pixel or line
+        Curve pixels = curve;
+        std::copy(p, p + 4, pixels.p);
+
+        CurveDetail detail = curve_detail(pixels, bz_transform{1, 1, 0, 0}, COLLAPSE_TOLERANCE);
+
+        if (detail != DETAIL_FULL) {
+            Point end = detail == DETAIL_LINE ? p[3] : p[0];
+            bz_draw_line(canvas, p[0].x, p[0].y, end.x, end.y, colour);
+            ++lines;
+            continue;
+        }
+
+        Point prev = p[0];
+
+        for (int j = 1; j <= cubic_steps; ++j) {
+            Point next = evaluate_curve(pixels, (float) j / cubic_steps);
+            bz_draw_line(canvas, prev.x, prev.y, next.x, next.y, colour);
+            prev = next;
+        }
+
+        lines += cubic_steps;
+    }
+
+    return lines;
+}
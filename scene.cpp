@@ -0,0 +1,249 @@
+/*
+ * Loading and ordering the curves in the scene.
+ */
+
+#include "scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using std::cerr;
+using std::endl;
+
+
+/*
+ * Rebuild once this fraction of the scene (1 in REBUILD_FRACTION curves) has been added or moved.
+ */
+const size_t REBUILD_FRACTION = 8;
+
+
+void curve_bounds(const Curve& curve, Point *min, Point *max) {
+    *min = curve.p[0];
+    *max = curve.p[0];
+
+    for (int i = 1; i <= curve.degree; ++i) {
+        min->x = std::min(min->x, curve.p[i].x);
+        min->y = std::min(min->y, curve.p[i].y);
+        max->x = std::max(max->x, curve.p[i].x);
+        max->y = std::max(max->y, curve.p[i].y);
+    }
+}
+
+
+/*
+ * Spread the 16 bits of a number out so that there is a 0 between each of them.
+ * For example, 1111 becomes 1010101.
+ */
+static uint32_t spread_bits(uint32_t v) {
+    v &= 0x0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+
+/*
+ * The position of a point along the Morton curve.
+ *
+ * We turn x and y into whole numbers between 0 and 65535 (measured across the
+ * whole scene), and then weave their bits together; x in the even bits and y
+ * in the odd bits. Sorting by the result visits the grid in a repeating 'Z' shape.
+ *
+ * A point which isn't a number (NaN) goes at the start; turning NaN into a whole
+ * number isn't allowed, and std::max would pass it straight through.
+ */
+static uint32_t morton_code(const Point& p, const Point& scene_min, const Point& scene_size) {
+    float fx = scene_size.x > 0 ? (p.x - scene_min.x) / scene_size.x : 0;
+    float fy = scene_size.y > 0 ? (p.y - scene_min.y) / scene_size.y : 0;
+
+    uint32_t x = (uint32_t) (fx >= 0 ? std::min(fx, 1.0f) * 65535 : 0);
+    uint32_t y = (uint32_t) (fy >= 0 ? std::min(fy, 1.0f) * 65535 : 0);
+
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+
+void rebuild_scene(Scene& scene) {
+    std::vector<Curve>& curves = scene.curves;
+    size_t n = curves.size();
+
+    scene.sorted_count = n;
+    scene.edits_since_rebuild = 0;
+
+    if (n < 2) {
+        return;
+    }
+
+    // Find the middle of every curve, and the box around the whole scene (leaving out any which aren't numbers)
+    std::vector<Point> centres(n);
+    Point scene_min = {}, scene_max = {};
+    bool found = false;
+
+    for (size_t i = 0; i < n; ++i) {
+        Point min, max;
+        curve_bounds(curves[i], &min, &max);
+        centres[i] = Point{(min.x + max.x) / 2, (min.y + max.y) / 2};
+
+        if (!std::isfinite(centres[i].x) || !std::isfinite(centres[i].y)) {
+            continue;
+        }
+
+        if (!found) {
+            found = true;
+            scene_min = scene_max = centres[i];
+        } else {
+            scene_min.x = std::min(scene_min.x, centres[i].x);
+            scene_min.y = std::min(scene_min.y, centres[i].y);
+            scene_max.x = std::max(scene_max.x, centres[i].x);
+            scene_max.y = std::max(scene_max.y, centres[i].y);
+        }
+    }
+
+    Point scene_size = Point{scene_max.x - scene_min.x, scene_max.y - scene_min.y};
+
+    // Pair every curve's position along the Morton curve with where it is now
+    std::vector<uint64_t> keys(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = ((uint64_t) morton_code(centres[i], scene_min, scene_size) << 32) | i;
+    }
+
+    /*
+     * Sort by the Morton code, 8 bits at a time (a 'radix sort').
+     * This takes the same time for every pass no matter how the curves are arranged,
+     * which matters when there are hundreds of millions of them.
+     * Only the top 32 bits hold the code; the bottom 32 bits just come along for the ride.
+     */
+    std::vector<uint64_t> sorted(n);
+
+    for (int shift = 32; shift < 64; shift += 8) {
+        size_t counts[257] = {0};
+
+        for (size_t i = 0; i < n; ++i) {
+            ++counts[((keys[i] >> shift) & 0xff) + 1];
+        }
+
+        for (int b = 0; b < 256; ++b) {
+            counts[b + 1] += counts[b];
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            sorted[counts[(keys[i] >> shift) & 0xff]++] = keys[i];
+        }
+
+        keys.swap(sorted);
+    }
+
+    // Finally, move the curves themselves into their new order
+    std::vector<Curve> reordered(n);
+
+    for (size_t i = 0; i < n; ++i) {
+        reordered[i] = curves[keys[i] & 0xffffffff];
+    }
+
+    curves.swap(reordered);
+}
+
+
+void add_curve(Scene& scene, const Curve& curve) {
+    scene.curves.push_back(curve);
+}
+
+
+void edit_curve(Scene& scene, size_t index, const Curve& curve) {
+    scene.curves[index] = curve;
+
+    // Curves after sorted_count will be sorted at the next rebuild anyway
+    if (index < scene.sorted_count) {
+        ++scene.edits_since_rebuild;
+    }
+}
+
+
+bool rebuild_scene_if_needed(Scene& scene) {
+    size_t out_of_place = scene.curves.size() - scene.sorted_count + scene.edits_since_rebuild;
+
+    if (out_of_place == 0 || out_of_place * REBUILD_FRACTION < scene.curves.size()) {
+        return false;
+    }
+
+    rebuild_scene(scene);
+    return true;
+}
+
+
+bool load_scene(const char *filename, Scene& scene) {
+    std::ifstream file(filename);
+
+    if (!file) {
+        cerr << "Error: Could not open scene file " << filename << endl;
+        return false;
+    }
+
+    std::string line;
+    int line_number = 0;
+
+    scene.curves.clear();
+
+    while (std::getline(file, line)) {
+        ++line_number;
+
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        Curve curve;
+        int r, g, b;
+        int values;
+
+        if (line[0] == 'Q') {
+            curve.degree = 2;
+            curve.p[3] = Point{0, 0};
+            values = sscanf(line.c_str() + 1, "%f %f %f %f %f %f %d %d %d",
+                            &curve.p[0].x, &curve.p[0].y,
+                            &curve.p[1].x, &curve.p[1].y,
+                            &curve.p[2].x, &curve.p[2].y,
+                            &r, &g, &b);
+        } else if (line[0] == 'C') {
+            curve.degree = 3;
+            values = sscanf(line.c_str() + 1, "%f %f %f %f %f %f %f %f %d %d %d",
+                            &curve.p[0].x, &curve.p[0].y,
+                            &curve.p[1].x, &curve.p[1].y,
+                            &curve.p[2].x, &curve.p[2].y,
+                            &curve.p[3].x, &curve.p[3].y,
+                            &r, &g, &b);
+        } else {
+            cerr << "Error: " << filename << ":" << line_number << ": not a curve" << endl;
+            return false;
+        }
+
+        // Every control point needs both of its coordinates,
+        // and a colour must be given completely or not at all.
+        int points = 2 * (curve.degree + 1);
+
+        if (values != points && values != points + 3) {
+            cerr << "Error: " << filename << ":" << line_number << ": not a curve" << endl;
+            return false;
+        }
+
+        if (values == points) {
+            r = curve.degree == 2 ? 0 : 255;
+            g = curve.degree == 2 ? 255 : 0;
+            b = 0;
+        }
+
+        curve.r = r;
+        curve.g = g;
+        curve.b = b;
+        scene.curves.push_back(curve);
+    }
+
+    rebuild_scene(scene);
+    return true;
+}
@@ -0,0 +1,81 @@
+/*
+ * The scene; every curve which we are going to draw.
+ *
+ * Curves can be loaded from a text file with one curve per line:
+ *
+ *   Q x0 y0 x1 y1 x2 y2 [r g b]          (a quadratic curve)
+ *   C x0 y0 x1 y1 x2 y2 x3 y3 [r g b]    (a cubic curve)
+ *
+ * Lines starting with # are ignored. The colour is optional;
+ * quadratic curves are green and cubic curves are red unless told otherwise.
+ */
+
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include "bezier.hpp"
+
+
+/*
+ * The curves, kept in 'Morton order'.
+ *
+ * Curves which are close to each other on the screen are usually drawn or
+ * searched at the same time. If they are also close to each other in memory,
+ * the computer can stream through them rather than jumping all over a huge array.
+ *
+ * A Morton (or 'Z-order') curve is a way of visiting every cell of a grid
+ * such that cells which are next to each other are mostly visited close together.
+ * We work out where the middle of each curve's bounding box falls on that path
+ * and sort the curves by it.
+ *
+ * Curves which are added or moved after sorting would spoil the order, so rather
+ * than re-sorting after every change we just count the changes, and sort everything
+ * again once enough of the scene is out of place.
+ */
+typedef struct {
+    std::vector<Curve> curves;
+
+    // curves[0] to curves[sorted_count - 1] were in order at the last rebuild.
+    // Anything after that has been added since.
+    size_t sorted_count;
+
+    // How many of the sorted curves have been moved since the last rebuild
+    size_t edits_since_rebuild;
+} Scene;
+
+
+/*
+ * The smallest box which contains a whole curve.
+ * A Bezier curve never leaves the box around its control points,
+ * so we don't need to work out any points on the curve itself.
+ */
+void curve_bounds(const Curve& curve, Point *min, Point *max);
+
+/*
+ * Read curves from a scene file and put them in Morton order.
+ * Returns false (after explaining why) if the file could not be read.
+ */
+bool load_scene(const char *filename, Scene& scene);
+
+/*
+ * Put every curve into Morton order.
+ */
+void rebuild_scene(Scene& scene);
+
+/*
+ * Add a new curve, or change an existing one.
+ * These don't re-sort anything themselves; call rebuild_scene_if_needed afterwards.
+ */
+void add_curve(Scene& scene, const Curve& curve);
+void edit_curve(Scene& scene, size_t index, const Curve& curve);
+
+/*
+ * Re-sort the scene once enough of it has been added or moved since the last rebuild.
+ * Returns true if the curves were reordered (so anything which refers to curves by index needs updating).
+ */
+bool rebuild_scene_if_needed(Scene& scene);
+
+#endif
@@ -0,0 +1,296 @@
+/*
+ * Make up scenes full of curves, for testing how the program copes with big or awkward scenes.
+ *
+ *   ./scenegen --count 1000000 --seed 7 > scene.txt
+ *   ./bezier scene.txt
+ *
+ * The same options and seed always give exactly the same scene (on any computer),
+ * so a benchmark can be repeated by anyone with just the command line.
+ * The file starts with a comment recording the options which made it.
+ *
+ * Options:
+ *   --seed N          Which random scene to make (default 1)
+ *   --count N         How many curves (default 1000)
+ *   --cubic F         The fraction of curves which are cubic; the rest are quadratic (default 0.5)
+ *   --min-size S      The smallest and largest curves, as a fraction of the window.
+ *   --max-size S      Sizes in between are spread so there are as many tiny curves as big ones (defaults 0.01 and 0.2)
+ *   --extreme F       The fraction of curves with a control point flung far away, making a very sharp bend
+ *                     (like the cubic curve's p2 in main.cpp, which is off the bottom of the window) (default 0.05)
+ *   --clusters N      Gather curves around N random spots instead of spreading them evenly (default 0; evenly)
+ *   --spread S        How far curves stray from their spot (default 0.05)
+ *   -o FILE           Write to FILE instead of the standard output
+ */
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+using std::cerr;
+using std::endl;
+
+
+// How much further away than the rest of the curve an 'extreme' control point is flung
+const float EXTREME_SCALE = 4;
+
+
+/*
+ * Random numbers.
+ *
+ * We use our own generator (called 'splitmix64') rather than the standard library's,
+ * because the standard library is allowed to turn random bits into numbers differently
+ * on different computers, which would give different scenes from the same seed.
+ */
+typedef struct {
+    uint64_t state;
+} Random;
+
+
+uint64_t random_bits(Random& random) {
+    uint64_t z = (random.state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+
+/*
+ * A random number from 0 up to (but not including) 1.
+ */
+double random_uniform(Random& random) {
+    return (random_bits(random) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+/*
+ * A random number from a 'normal' (bell-shaped) spread with an average of 0 and a spread of 1.
+ * (This is the 'Box-Muller' method.)
+ */
+double random_normal(Random& random) {
+    double u = 1 - random_uniform(random);
+    double v = random_uniform(random);
+    return std::sqrt(-2 * std::log(u)) * std::cos(2 * M_PI * v);
+}
+
+
+/*
+ * Writing numbers quickly.
+ *
+ * For a hundred million curves, formatting numbers with printf takes longer than everything else put together.
+ * We only ever need 5 decimal places, so we can write the digits ourselves into a big buffer,
+ * and hand the whole buffer to the operating system at once.
+ * If the operating system can't take it all (say the disk is full), 'failed' is set, so that we can say so at the end.
+ */
+typedef struct {
+    FILE *file;
+    char buffer[1 << 20];
+    size_t used;
+    bool failed;
+} Writer;
+
+
+void flush(Writer& writer) {
+    if (fwrite(writer.buffer, 1, writer.used, writer.file) != writer.used) {
+        writer.failed = true;
+    }
+
+    writer.used = 0;
+}
+
+
+void write_text(Writer& writer, const char *text) {
+    size_t length = strlen(text);
+
+    if (writer.used + length > sizeof(writer.buffer)) {
+        flush(writer);
+    }
+
+    memcpy(writer.buffer + writer.used, text, length);
+    writer.used += length;
+}
+
+
+void write_number(Writer& writer, double value) {
+    // Enough room for a sign, 19 digits, a point and 5 more digits, and a space
+    if (writer.used + 32 > sizeof(writer.buffer)) {
+        flush(writer);
+    }
+
+    char *out = writer.buffer + writer.used;
+    long long fixed = std::llround(value * 100000);
+
+    *out++ = ' ';
+
+    if (fixed < 0) {
+        *out++ = '-';
+        fixed = -fixed;
+    }
+
+    // Write the digits backwards, then turn them around
+    char digits[24];
+    int count = 0;
+
+    while (fixed > 0 || count < 7) {
+        digits[count++] = '0' + fixed % 10;
+        fixed /= 10;
+
+        if (count == 5) {
+            digits[count++] = '.';
+        }
+    }
+
+    while (count > 0) {
+        *out++ = digits[--count];
+    }
+
+    writer.used = out - writer.buffer;
+}
+
+
+/*
+ * Read a whole number above 0, as bezier does for --bench. Returns false for anything else,
+ * including a minus sign, which strtoull would quietly turn into a huge number.
+ */
+bool read_count(const char *text, uint64_t *number) {
+    char *end;
+    errno = 0;
+    *number = strtoull(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && *number > 0 && !strchr(text, '-');
+}
+
+
+int main(int argc, char **argv) {
+    uint64_t seed = 1;
+    uint64_t count = 1000;
+    double cubic = 0.5;
+    double min_size = 0.01;
+    double max_size = 0.2;
+    double extreme = 0.05;
+    int clusters = 0;
+    double spread = 0.05;
+    const char *filename = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (!value) {
+            cerr << "Error: " << argv[i] << " needs a value" << endl;
+            return 1;
+        }
+
+        if      (strcmp(argv[i], "--seed") == 0)     seed = strtoull(value, NULL, 10);
+        else if (strcmp(argv[i], "--count") == 0) {
+            if (!read_count(value, &count)) {
+                cerr << "Error: --count needs a number of curves, above 0" << endl;
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--cubic") == 0)    cubic = atof(value);
+        else if (strcmp(argv[i], "--min-size") == 0) min_size = atof(value);
+        else if (strcmp(argv[i], "--max-size") == 0) max_size = atof(value);
+        else if (strcmp(argv[i], "--extreme") == 0)  extreme = atof(value);
+        else if (strcmp(argv[i], "--clusters") == 0) clusters = atoi(value);
+        else if (strcmp(argv[i], "--spread") == 0)   spread = atof(value);
+        else if (strcmp(argv[i], "-o") == 0)         filename = value;
+        else {
+            cerr << "Error: Unknown option " << argv[i] << " (see the top of scenegen.cpp)" << endl;
+            return 1;
+        }
+
+        ++i;
+    }
+
+    if (min_size <= 0 || max_size < min_size) {
+        cerr << "Error: Sizes must be above 0, with --min-size no bigger than --max-size" << endl;
+        return 1;
+    }
+
+    if (clusters < 0) {
+        cerr << "Error: --clusters can't be below 0" << endl;
+        return 1;
+    }
+
+    static Writer writer;
+    writer.file = filename ? fopen(filename, "w") : stdout;
+
+    if (!writer.file) {
+        cerr << "Error: Could not write to " << filename << endl;
+        return 2;
+    }
+
+    Random random = {seed};
+
+    // Record how the scene was made, so that it can be made again
+    char header[512];
+    snprintf(header, sizeof(header),
+             "# scenegen --seed %llu --count %llu --cubic %g --min-size %g --max-size %g --extreme %g --clusters %d --spread %g\n",
+             (unsigned long long) seed, (unsigned long long) count, cubic, min_size, max_size, extreme, clusters, spread);
+    write_text(writer, header);
+
+    // The spots which clustered curves gather around
+    std::vector<double> cluster_x(clusters);
+    std::vector<double> cluster_y(clusters);
+
+    for (int c = 0; c < clusters; ++c) {
+        cluster_x[c] = random_uniform(random);
+        cluster_y[c] = random_uniform(random);
+    }
+
+    for (uint64_t i = 0; i < count; ++i) {
+        int degree = random_uniform(random) < cubic ? 3 : 2;
+
+        // Pick a size so that each doubling of size is equally likely
+        double size = min_size * std::pow(max_size / min_size, random_uniform(random));
+
+        // Pick where the middle of the curve goes
+        double centre_x, centre_y;
+
+        if (clusters > 0) {
+            int c = random_bits(random) % clusters;
+            centre_x = cluster_x[c] + spread * random_normal(random);
+            centre_y = cluster_y[c] + spread * random_normal(random);
+        } else {
+            centre_x = random_uniform(random);
+            centre_y = random_uniform(random);
+        }
+
+        // Scatter the control points around the middle
+        double x[4], y[4];
+
+        for (int p = 0; p <= degree; ++p) {
+            x[p] = centre_x + size * (random_uniform(random) - 0.5);
+            y[p] = centre_y + size * (random_uniform(random) - 0.5);
+        }
+
+        // Fling one of the middle control points a long way away.
+        // The ends of the curve stay put, so it makes a long, sharp spike.
+        if (random_uniform(random) < extreme) {
+            int p = 1 + random_bits(random) % (degree - 1);
+            x[p] = centre_x + EXTREME_SCALE * size * (x[p] - centre_x) / (0.5 * size);
+            y[p] = centre_y + EXTREME_SCALE * size * (y[p] - centre_y) / (0.5 * size);
+        }
+
+        write_text(writer, degree == 2 ? "Q" : "C");
+
+        for (int p = 0; p <= degree; ++p) {
+            write_number(writer, x[p]);
+            write_number(writer, y[p]);
+        }
+
+        write_text(writer, "\n");
+    }
+
+    flush(writer);
+
+    // Closing the file (or flushing the standard output) writes anything the C library was still holding on to
+    if ((filename ? fclose(writer.file) : fflush(writer.file)) != 0 || writer.failed) {
+        cerr << "Error: Could not write all of the scene to " << (filename ? filename : "the standard output") << endl;
+        return 2;
+    }
+
+    return 0;
+}
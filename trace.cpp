@@ -0,0 +1,153 @@
+/*
+ * Recording and writing out the timeline.
+ *
+ * Every thread keeps its own list of events, so recording an event never has to wait
+ * for another thread. The lists are only gathered together when the file is written.
+ */
+
+#include "trace.hpp"
+
+#include <cstdio>
+#include <iostream>
+
+using std::cerr;
+using std::endl;
+
+
+static const char *trace_filename = NULL;
+
+
+#ifdef BEZIER_TRACE
+
+#include <mutex>
+#include <vector>
+
+
+bool trace_enabled = false;
+
+
+typedef struct {
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+} TraceEvent;
+
+
+typedef struct {
+    int tid;
+    const char *thread_name;
+    std::vector<TraceEvent> events;
+} TraceBuffer;
+
+
+static std::chrono::steady_clock::time_point trace_epoch;
+
+// Every thread's list. These are never freed, because worker threads finish
+// (and lose their thread_local pointer) long before the file is written.
+static std::mutex trace_buffers_mutex;
+static std::vector<TraceBuffer *> trace_buffers;
+
+static thread_local TraceBuffer *thread_buffer = NULL;
+
+
+/*
+ * The current thread's list, made the first time the thread records anything.
+ */
+static TraceBuffer *get_thread_buffer() {
+    if (!thread_buffer) {
+        std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+
+        thread_buffer = new TraceBuffer{(int) trace_buffers.size() + 1, NULL, {}};
+        thread_buffer->events.reserve(4096);
+        trace_buffers.push_back(thread_buffer);
+    }
+
+    return thread_buffer;
+}
+
+
+void trace_record(const char *name, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end) {
+    get_thread_buffer()->events.push_back(TraceEvent{name, start, end});
+}
+
+
+void trace_thread_name(const char *name) {
+    if (trace_enabled) {
+        get_thread_buffer()->thread_name = name;
+    }
+}
+
+
+/*
+ * Microseconds since recording started; the unit which the trace format uses.
+ */
+static double trace_microseconds(std::chrono::steady_clock::time_point time) {
+    return std::chrono::duration<double, std::micro>(time - trace_epoch).count();
+}
+
+
+bool trace_start(const char *filename) {
+    trace_filename = filename;
+    trace_epoch = std::chrono::steady_clock::now();
+    trace_enabled = true;
+    TRACE_THREAD_NAME("main");
+    return true;
+}
+
+
+bool trace_finish() {
+    if (!trace_enabled) {
+        return true;
+    }
+
+    trace_enabled = false;
+
+    FILE *file = fopen(trace_filename, "w");
+
+    if (!file) {
+        cerr << "Error: Could not write trace file " << trace_filename << endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+    const char *separator = "";
+
+    fprintf(file, "{\"traceEvents\":[\n");
+
+    for (TraceBuffer *buffer : trace_buffers) {
+        if (buffer->thread_name) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    separator, buffer->tid, buffer->thread_name);
+            separator = ",\n";
+        }
+
+        for (const TraceEvent& event : buffer->events) {
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    separator, event.name, buffer->tid,
+                    trace_microseconds(event.start), trace_microseconds(event.end) - trace_microseconds(event.start));
+            separator = ",\n";
+        }
+
+        buffer->events.clear();
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+#else
+
+bool trace_start(const char *filename) {
+    trace_filename = filename;
+    cerr << "Warning: Tracing was not built into this program (rebuild with make TRACE=1)" << endl;
+    return false;
+}
+
+
+bool trace_finish() {
+    return true;
+}
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Timeline tracing.
+ *
+ * Wrapping a block of code in TRACE_SCOPE("name") records when it started and how long
+ * it took, on whichever thread ran it. Running the program with --trace out.json then
+ * writes everything that was recorded in the Chrome trace format, which can be opened
+ * in chrome://tracing or https://ui.perfetto.dev to see every thread's work side by side.
+ *
+ * Tracing is only built into the program when it is compiled with BEZIER_TRACE defined
+ * (make TRACE=1). Otherwise TRACE_SCOPE disappears completely and costs nothing at all.
+ */
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+
+
+/*
+ * Start recording, to be written to a file by trace_finish.
+ * Returns false if tracing wasn't built into the program.
+ */
+bool trace_start(const char *filename);
+
+/*
+ * Write everything recorded so far to the file given to trace_start.
+ * Returns false if the file could not be written.
+ */
+bool trace_finish();
+
+
+#ifdef BEZIER_TRACE
+
+/*
+ * Set while we are recording. Checking this is all that an unrecorded scope costs.
+ */
+extern bool trace_enabled;
+
+/*
+ * Record one finished block of code on the current thread.
+ * 'name' must stay around until trace_finish; in practice it is always a string literal.
+ */
+void trace_record(const char *name, std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end);
+
+/*
+ * Give the current thread a name in the timeline.
+ */
+void trace_thread_name(const char *name);
+
+
+/*
+ * Records the time between being created and going out of scope.
+ */
+class TraceScope {
+public:
+    TraceScope(const char *name) : name(name) {
+        if (trace_enabled) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~TraceScope() {
+        if (trace_enabled) {
+            trace_record(name, start, std::chrono::steady_clock::now());
+        }
+    }
+
+private:
+    const char *name;
+    std::chrono::steady_clock::time_point start;
+};
+
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+
+#endif
+
+#endif
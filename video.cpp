@@ -0,0 +1,343 @@
+/*
+ * Writing a video, as a YUV4MPEG2 stream on standard output (see video.hpp).
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "trace.hpp"
+#include "video.hpp"
+
+
+/*
+ * Four numbers at once, which the compiler keeps together in one SSE or NEON register
+ * and does the same sum to with a single instruction.
+ */
+typedef uint32_t quad_u32 __attribute__((vector_size(4 * sizeof(uint32_t))));
+typedef int32_t quad_int __attribute__((vector_size(4 * sizeof(int32_t))));
+typedef uint8_t quad_u8 __attribute__((vector_size(4)));
+
+
+/*
+ * How many frames can be on their way through at once; one being drawn,
+ * one being converted and one being written.
+ */
+const int SLOTS = 3;
+
+
+/*
+ * Where a frame is up to.
+ */
+enum SlotState {
+    SLOT_FREE,          // Waiting to be drawn into
+    SLOT_DRAWN,         // Waiting to be converted
+    SLOT_CONVERTED      // Waiting to be written
+};
+
+
+typedef struct {
+    std::vector<uint32_t> pixels;
+    std::vector<uint8_t> yuv;
+    SlotState state;
+} Slot;
+
+
+/*
+ * Everything the three threads share. Frames go round the slots in order, and each thread
+ * keeps count of the next frame it will deal with; 'changed' wakes the others whenever a
+ * slot moves on.
+ */
+static struct {
+    int width;
+    int height;
+    Slot slots[SLOTS];
+    size_t next_draw;
+    size_t next_convert;
+    size_t next_write;
+    bool finishing;     // No more frames are coming
+    bool failed;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::thread converter;
+    std::thread writer;
+    void (*old_sigpipe)(int);   // What SIGPIPE did before the video started (see video_start)
+} video;
+
+
+/*
+ * One pixel's brightness, and the colour differences for the average of some pixels.
+ * These are the standard BT.601 sums in whole numbers; multiplied up by 256, then back down.
+ */
+static inline uint8_t luma(int r, int g, int b) {
+    return (uint8_t) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+static inline uint8_t chroma_u(int r, int g, int b) {
+    return (uint8_t) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+static inline uint8_t chroma_v(int r, int g, int b) {
+    return (uint8_t) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+
+/*
+ * The colour differences for one 2x2 square, one at a time; for the edges of odd-sized frames,
+ * where the square hangs off the edge and the pixels on the edge are used again instead.
+ */
+static void chroma_one(const uint32_t *argb, int width, int height, int cx, int cy, uint8_t *u, uint8_t *v) {
+    int r = 0, g = 0, b = 0;
+
+    for (int dy = 0; dy < 2; ++dy) {
+        for (int dx = 0; dx < 2; ++dx) {
+            int x = std::min(2 * cx + dx, width - 1);
+            int y = std::min(2 * cy + dy, height - 1);
+            uint32_t pixel = argb[(size_t) y * width + x];
+
+            r += (pixel >> 16) & 0xff;
+            g += (pixel >> 8) & 0xff;
+            b += pixel & 0xff;
+        }
+    }
+
+    *u = chroma_u((r + 2) >> 2, (g + 2) >> 2, (b + 2) >> 2);
+    *v = chroma_v((r + 2) >> 2, (g + 2) >> 2, (b + 2) >> 2);
+}
+
+
+/*
+ * One colour channel of 4 pixels.
+ */
+static inline quad_int channel(quad_u32 pixels, int shift) {
+    return (quad_int) ((pixels >> shift) & 0xff);
+}
+
+
+void rgb_to_yuv420(const uint32_t *argb, int width, int height, uint8_t *y, uint8_t *u, uint8_t *v) {
+    // Brightness; 4 pixels at a time
+    for (int row = 0; row < height; ++row) {
+        const uint32_t *in = argb + (size_t) row * width;
+        uint8_t *out = y + (size_t) row * width;
+        int x = 0;
+
+        for (; x + 4 <= width; x += 4) {
+            quad_u32 pixels;
+            memcpy(&pixels, in + x, sizeof(pixels));
+
+            quad_int r = channel(pixels, 16), g = channel(pixels, 8), b = channel(pixels, 0);
+            quad_int luma4 = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+
+            quad_u8 bytes = __builtin_convertvector(luma4, quad_u8);
+            memcpy(out + x, &bytes, sizeof(bytes));
+        }
+
+        for (; x < width; ++x) {
+            out[x] = luma((in[x] >> 16) & 0xff, (in[x] >> 8) & 0xff, in[x] & 0xff);
+        }
+    }
+
+    // Colour differences; 4 squares (8 pixels from each of 2 rows) at a time
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (height + 1) / 2;
+
+    for (int cy = 0; cy < chroma_height; ++cy) {
+        uint8_t *out_u = u + (size_t) cy * chroma_width;
+        uint8_t *out_v = v + (size_t) cy * chroma_width;
+        int cx = 0;
+
+        if (2 * cy + 1 < height) {
+            const uint32_t *top = argb + (size_t) (2 * cy) * width;
+            const uint32_t *bottom = top + width;
+
+            for (; 2 * cx + 8 <= width; cx += 4) {
+                quad_u32 pixels[4];
+                memcpy(&pixels[0], top + 2 * cx, sizeof(quad_u32));
+                memcpy(&pixels[1], top + 2 * cx + 4, sizeof(quad_u32));
+                memcpy(&pixels[2], bottom + 2 * cx, sizeof(quad_u32));
+                memcpy(&pixels[3], bottom + 2 * cx + 4, sizeof(quad_u32));
+
+                // Add up each square; the even pixels of each row plus the odd ones
+                quad_int sums[3];
+
+                for (int c = 0; c < 3; ++c) {
+                    int shift = 16 - 8 * c;
+                    quad_int t0 = channel(pixels[0], shift), t1 = channel(pixels[1], shift);
+                    quad_int b0 = channel(pixels[2], shift), b1 = channel(pixels[3], shift);
+
+                    sums[c] = __builtin_shufflevector(t0, t1, 0, 2, 4, 6) + __builtin_shufflevector(t0, t1, 1, 3, 5, 7)
+                            + __builtin_shufflevector(b0, b1, 0, 2, 4, 6) + __builtin_shufflevector(b0, b1, 1, 3, 5, 7);
+                    sums[c] = (sums[c] + 2) >> 2;
+                }
+
+                quad_int r = sums[0], g = sums[1], b = sums[2];
+                quad_u8 u4 = __builtin_convertvector(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128, quad_u8);
+                quad_u8 v4 = __builtin_convertvector(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128, quad_u8);
+                memcpy(out_u + cx, &u4, sizeof(u4));
+                memcpy(out_v + cx, &v4, sizeof(v4));
+            }
+        }
+
+        for (; cx < chroma_width; ++cx) {
+            chroma_one(argb, width, height, cx, cy, &out_u[cx], &out_v[cx]);
+        }
+    }
+}
+
+
+/*
+ * The converting thread.
+ */
+static void convert_frames() {
+    TRACE_THREAD_NAME("convert");
+
+    size_t luma_size = (size_t) video.width * video.height;
+    size_t chroma_size = (size_t) ((video.width + 1) / 2) * ((video.height + 1) / 2);
+
+    while (true) {
+        Slot *slot;
+
+        {
+            std::unique_lock<std::mutex> hold(video.lock);
+            video.changed.wait(hold, []() {
+                return video.slots[video.next_convert % SLOTS].state == SLOT_DRAWN
+                    || (video.finishing && video.next_convert == video.next_draw);
+            });
+
+            if (video.next_convert == video.next_draw) {
+                return;
+            }
+
+            slot = &video.slots[video.next_convert % SLOTS];
+        }
+
+        {
+            TRACE_SCOPE("convert");
+            uint8_t *yuv = slot->yuv.data();
+            rgb_to_yuv420(slot->pixels.data(), video.width, video.height,
+                          yuv, yuv + luma_size, yuv + luma_size + chroma_size);
+        }
+
+        std::lock_guard<std::mutex> hold(video.lock);
+        slot->state = SLOT_CONVERTED;
+        ++video.next_convert;
+        video.changed.notify_all();
+    }
+}
+
+
+/*
+ * The writing thread.
+ */
+static void write_frames() {
+    TRACE_THREAD_NAME("write");
+
+    while (true) {
+        Slot *slot;
+
+        {
+            std::unique_lock<std::mutex> hold(video.lock);
+            video.changed.wait(hold, []() {
+                return video.slots[video.next_write % SLOTS].state == SLOT_CONVERTED
+                    || (video.finishing && video.next_write == video.next_draw);
+            });
+
+            if (video.next_write == video.next_draw) {
+                return;
+            }
+
+            slot = &video.slots[video.next_write % SLOTS];
+        }
+
+        // After a failure, frames are still taken off the queue so that nothing waits forever
+        if (!video.failed) {
+            TRACE_SCOPE("write");
+
+            if (fputs("FRAME\n", stdout) == EOF
+                || fwrite(slot->yuv.data(), 1, slot->yuv.size(), stdout) != slot->yuv.size()) {
+                video.failed = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> hold(video.lock);
+        slot->state = SLOT_FREE;
+        ++video.next_write;
+        video.changed.notify_all();
+    }
+}
+
+
+bool video_start(int width, int height, int fps) {
+    if (isatty(fileno(stdout))) {
+        return false;
+    }
+
+    // If the program reading the video stops early, writing to it raises SIGPIPE, which would end this
+    // program on the spot; ignoring it makes the write fail instead, so video_finish can say what happened
+    video.old_sigpipe = std::signal(SIGPIPE, SIG_IGN);
+
+    video.width = width;
+    video.height = height;
+    video.next_draw = video.next_convert = video.next_write = 0;
+    video.finishing = false;
+    video.failed = false;
+
+    size_t yuv_size = (size_t) width * height + 2 * (size_t) ((width + 1) / 2) * ((height + 1) / 2);
+
+    for (int i = 0; i < SLOTS; ++i) {
+        video.slots[i].pixels.assign((size_t) width * height, 0);
+        video.slots[i].yuv.assign(yuv_size, 0);
+        video.slots[i].state = SLOT_FREE;
+    }
+
+    // 'Ip' means whole frames rather than interlaced halves, 'A1:1' square pixels,
+    // and 'C420jpeg' one colour sample in the middle of each 2x2 square
+    printf("YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+
+    video.converter = std::thread(convert_frames);
+    video.writer = std::thread(write_frames);
+    return true;
+}
+
+
+uint32_t *video_frame() {
+    std::unique_lock<std::mutex> hold(video.lock);
+    Slot& slot = video.slots[video.next_draw % SLOTS];
+
+    video.changed.wait(hold, [&slot]() { return slot.state == SLOT_FREE; });
+    return slot.pixels.data();
+}
+
+
+void video_submit() {
+    std::lock_guard<std::mutex> hold(video.lock);
+    video.slots[video.next_draw % SLOTS].state = SLOT_DRAWN;
+    ++video.next_draw;
+    video.changed.notify_all();
+}
+
+
+bool video_finish() {
+    {
+        std::lock_guard<std::mutex> hold(video.lock);
+        video.finishing = true;
+        video.changed.notify_all();
+    }
+
+    video.converter.join();
+    video.writer.join();
+
+    if (fflush(stdout) != 0) {
+        video.failed = true;
+    }
+
+    std::signal(SIGPIPE, video.old_sigpipe);
+    return !video.failed;
+}
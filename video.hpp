@@ -0,0 +1,58 @@
+/*
+ * Writing a video, as a YUV4MPEG2 ('y4m') stream on standard output.
+ *
+ * y4m is about the simplest video format there is; a line of text saying how big the frames
+ * are and how fast they go, then each frame's pixels, uncompressed. Almost every video tool
+ * can read it, e.g. `./bezier --video 300 scene.txt | ffmpeg -i - promo.mp4`.
+ *
+ * Frames are stored the way video encoders want them; a brightness ('Y') for every pixel,
+ * and two colour differences ('U' and 'V') for every square of 2x2 pixels, since eyes notice
+ * fine detail in brightness much more than in colour.
+ *
+ * Three things happen to every frame; it is drawn, converted to YUV, and written out.
+ * Each has its own thread, so while one frame is being written the next is being converted
+ * and the one after that drawn, and the video goes as fast as the slowest of the three
+ * rather than all three added together.
+ */
+
+#ifndef VIDEO_HPP
+#define VIDEO_HPP
+
+#include <cstdint>
+
+
+/*
+ * Write the stream's header and start the converting and writing threads.
+ * Returns false if standard output is a terminal, which can't show a video.
+ */
+bool video_start(int width, int height, int fps);
+
+
+/*
+ * Wait for a frame's worth of pixels (width * height, ARGB, one row after another)
+ * which is free to draw into.
+ */
+uint32_t *video_frame();
+
+
+/*
+ * Send the frame from video_frame, now that it has been drawn, to be converted and written.
+ */
+void video_submit();
+
+
+/*
+ * Wait for every frame to be written, and stop the threads.
+ * Returns false if writing failed (for instance, the program reading the video stopped).
+ */
+bool video_finish();
+
+
+/*
+ * Convert a frame from ARGB pixels to YUV 4:2:0; y has width * height bytes, and u and v have
+ * one byte for each 2x2 square (rounding up at odd edges). Uses the BT.601 'studio' levels
+ * which video players expect.
+ */
+void rgb_to_yuv420(const uint32_t *argb, int width, int height, uint8_t *y, uint8_t *u, uint8_t *v);
+
+#endif
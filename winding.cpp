@@ -0,0 +1,604 @@
+/*
+ * libbezier; whether points are inside shapes made of curves.
+ *
+ * The 'winding number' of a point is how many times the outlines go round it; clockwise
+ * (on the screen) counts as +1 and anticlockwise as -1. One way to find it is to go from the
+ * point off to the right forever, and add up the outlines crossed: +1 for each going down,
+ * and -1 for each going up. The fill rules then decide what counts as inside; anything but 0,
+ * or only odd numbers (see bz_fill_rule).
+ *
+ * Going all the way to the right means looking at every curve to the right of the point, though.
+ * Instead, the shapes are covered with a grid of tiles, and we work out the winding number at
+ * the middle of every tile beforehand. The winding number only changes when an outline is
+ * crossed, so for a point in a tile we start from the winding number in the middle of the tile,
+ * then go across to the point's x and then up or down to the point, adding up the crossings on
+ * the way. Everything crossed is inside the tile, so only the curves which pass through that
+ * tile need to be looked at.
+ *
+ * To make the crossings easy to find, each curve is cut into pieces which only go one way in x
+ * and one way in y (where its slope in x or y is 0; at most 4 places for a cubic). A piece like
+ * that crosses any horizontal or vertical line at most once, its box goes from its start to
+ * its end, and finding where it crosses is just a matter of halving the part of the piece the
+ * crossing is in. The crossings with each tile's middle row are found beforehand too.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "bezier.hpp"
+
+
+/*
+ * The most steps taken to find where a piece crosses a line, and how close is close enough
+ * (as a fraction of the piece).
+ */
+const int MAX_SOLVE_STEPS = 16;
+const float SOLVE_TOLERANCE = 1e-6f;
+
+
+/*
+ * About how many pieces each tile has, on average, for the grid chosen by bz_winding_grid_size;
+ * more tiles mean less to look at for each point, but more memory and a longer wait beforehand.
+ * Long pieces pass through lots of tiles, though, so there are fewer, bigger tiles when the pieces
+ * would otherwise be in more than MAX_TILES_PER_PIECE tiles each, on average.
+ */
+const double PIECES_PER_TILE = 2;
+const double MAX_TILES_PER_PIECE = 8;
+const int MAX_GRID_SIZE = 4096;
+
+
+/*
+ * A piece of a curve, between t0 and t1, which only goes one way in x and in y.
+ * x and y are the whole curve's coordinates as polynomials in t.
+ */
+typedef struct {
+    float x[4], y[4];
+    float t0, t1;
+    bz_point start, end;
+} Piece;
+
+
+/*
+ * A piece in a tile; which one, where it crosses the middle row of the tile (or INFINITY if it
+ * doesn't, which then never counts as a crossing), and the part of the tile's row it passes through.
+ */
+typedef struct {
+    uint32_t piece;
+    float middle_x;
+    float left, right;
+} TileEntry;
+
+
+/*
+ * Where everything goes in the caller's memory.
+ */
+typedef struct {
+    Piece *pieces;
+    TileEntry *entries;
+    uint32_t *tile_first;   // Each tile's first entry, with one more at the end
+    int32_t *tile_winding;  // The winding number in the middle of each tile
+} GridMemory;
+
+
+static GridMemory grid_memory(const bz_winding_grid& grid) {
+    GridMemory memory;
+    size_t tiles = (size_t) grid.columns * grid.rows;
+
+    memory.pieces = (Piece *) grid.memory;
+    memory.entries = (TileEntry *) (memory.pieces + grid.piece_count);
+    memory.tile_first = (uint32_t *) (memory.entries + grid.entry_count);
+    memory.tile_winding = (int32_t *) (memory.tile_first + tiles + 1);
+    return memory;
+}
+
+
+static inline float evaluate(const float *c, float t) {
+    return ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+}
+
+
+static inline float slope(const float *c, float t) {
+    return (3 * c[3] * t + 2 * c[2]) * t + c[1];
+}
+
+
+/*
+ * One coordinate of a curve (or of a straight line, with 'degree' 1) as a polynomial;
+ * the same sums as in moments.cpp.
+ */
+static void coefficients(float p0, float p1, float p2, float p3, int degree, float *c) {
+    c[0] = p0;
+
+    if (degree == 1) {
+        c[1] = p1 - p0;
+        c[2] = c[3] = 0;
+    } else if (degree == 2) {
+        c[1] = 2 * (p1 - p0);
+        c[2] = p2 - 2 * p1 + p0;
+        c[3] = 0;
+    } else {
+        c[1] = 3 * (p1 - p0);
+        c[2] = 3 * (p2 - 2 * p1 + p0);
+        c[3] = p3 - 3 * p2 + 3 * p1 - p0;
+    }
+}
+
+
+/*
+ * Add the places between 0 and 1 where a coordinate's slope is 0 to 'splits'.
+ */
+static void add_turning_points(const float *c, float *splits, int& count) {
+    // The slope is 3 c[3] t^2 + 2 c[2] t + c[1]
+    float a = 3 * c[3], b = 2 * c[2];
+    float roots[2];
+    int root_count = 0;
+
+    if (std::fabs(a) < 1e-12f) {
+        if (b != 0) {
+            roots[root_count++] = -c[1] / b;
+        }
+    } else {
+        float discriminant = b * b - 4 * a * c[1];
+
+        if (discriminant > 0) {
+            float root = std::sqrt(discriminant);
+            roots[root_count++] = (-b - root) / (2 * a);
+            roots[root_count++] = (-b + root) / (2 * a);
+        }
+    }
+
+    for (int i = 0; i < root_count; ++i) {
+        if (roots[i] > 0 && roots[i] < 1) {
+            splits[count++] = roots[i];
+        }
+    }
+}
+
+
+/*
+ * Cut one curve, or a straight line with 'degree' 1, into pieces.
+ */
+template <typename Found>
+static void cut_into_pieces(const bz_point *p, int degree, Found found) {
+    const bz_point& last = p[degree];
+    Piece piece;
+
+    coefficients(p[0].x, p[1].x, p[std::min(degree, 2)].x, last.x, degree, piece.x);
+    coefficients(p[0].y, p[1].y, p[std::min(degree, 2)].y, last.y, degree, piece.y);
+
+    float splits[6];
+    int count = 0;
+
+    splits[count++] = 0;
+
+    if (degree > 1) {
+        add_turning_points(piece.x, splits, count);
+        add_turning_points(piece.y, splits, count);
+
+        // Put them in order; there are only ever a few
+        for (int i = 2; i < count; ++i) {
+            for (int j = i; j > 1 && splits[j] < splits[j - 1]; --j) {
+                std::swap(splits[j], splits[j - 1]);
+            }
+        }
+    }
+
+    splits[count++] = 1;
+
+    for (int i = 0; i + 1 < count; ++i) {
+        if (splits[i + 1] <= splits[i]) {
+            continue;
+        }
+
+        // The ends of the curve are exactly its control points, so that the pieces of
+        // curves which meet in a path meet exactly too
+        piece.t0 = splits[i];
+        piece.t1 = splits[i + 1];
+        piece.start = i == 0 ? p[0] : bz_point{evaluate(piece.x, piece.t0), evaluate(piece.y, piece.t0)};
+        piece.end = i + 2 == count ? last : bz_point{evaluate(piece.x, piece.t1), evaluate(piece.y, piece.t1)};
+        found(piece);
+    }
+}
+
+
+/*
+ * Every piece of every path, including the straight lines which close the paths and join up
+ * curves which don't quite meet (as in bz_path_moments).
+ */
+template <typename Found>
+static void for_each_piece(const bz_curve *curves, const size_t *path_ends, size_t path_count, Found found) {
+    size_t first = 0;
+
+    for (size_t path = 0; path < path_count; ++path) {
+        size_t end = path_ends[path];
+
+        for (size_t i = first; i < end; ++i) {
+            cut_into_pieces(curves[i].p, curves[i].degree, found);
+
+            const bz_curve& next = curves[i + 1 < end ? i + 1 : first];
+            bz_point join[2] = {curves[i].p[curves[i].degree], next.p[0]};
+
+            if (join[0].x != join[1].x || join[0].y != join[1].y) {
+                cut_into_pieces(join, 1, found);
+            }
+        }
+
+        first = end;
+    }
+}
+
+
+/*
+ * Where a piece crosses the line where one of its coordinates (c, going from 'from' at t0 to
+ * 'to' at t1) equals 'target'; the caller has already checked that it does. Returns t.
+ *
+ * This starts from where a straight line between the piece's ends would cross, and improves
+ * that with Newton's method, which usually only takes a few steps. The crossing is always
+ * somewhere between 'low' and 'high'; whenever Newton's method would go outside them, the gap
+ * between them is halved instead, which is slower but always gets there (as in intersect.cpp).
+ */
+static float solve(const Piece& piece, const float *c, float from, float to, float target) {
+    float low = piece.t0, high = piece.t1;
+    bool rising = to > from;
+    float t = low + (high - low) * (target - from) / (to - from);
+
+    for (int i = 0; i < MAX_SOLVE_STEPS; ++i) {
+        float error = evaluate(c, t) - target;
+
+        if ((error < 0) == rising) {
+            low = t;
+        } else {
+            high = t;
+        }
+
+        float s = slope(c, t);
+        float next = s != 0 ? t - error / s : low;
+
+        if (!(next > low && next < high)) {
+            next = 0.5f * (low + high);
+        }
+
+        if (std::fabs(next - t) <= SOLVE_TOLERANCE * (piece.t1 - piece.t0)) {
+            return next;
+        }
+
+        t = next;
+    }
+
+    return t;
+}
+
+
+/*
+ * Where a piece crosses the row at height y, or INFINITY if it doesn't. A piece which starts
+ * on the row counts, but one which ends on it doesn't, so that where one piece carries on
+ * from another, the crossing is only counted once.
+ */
+static float crossing_x(const Piece& piece, float y) {
+    float low = std::min(piece.start.y, piece.end.y), high = std::max(piece.start.y, piece.end.y);
+
+    if (!(y >= low && y < high)) {
+        return INFINITY;
+    }
+
+    return evaluate(piece.x, solve(piece, piece.y, piece.start.y, piece.end.y, y));
+}
+
+
+/*
+ * Where a piece crosses the row at height y, where y is anywhere from its start to its end.
+ */
+static float x_at(const Piece& piece, float y) {
+    if (y == piece.start.y) {
+        return piece.start.x;
+    } else if (y == piece.end.y) {
+        return piece.end.x;
+    }
+
+    return evaluate(piece.x, solve(piece, piece.y, piece.start.y, piece.end.y, y));
+}
+
+
+/*
+ * The grid's size; enough tiles for about PIECES_PER_TILE pieces each, in the shape of the box
+ * around all of the pieces, unless that would put them in too many tiles. A piece w by h only
+ * goes one way, so it passes through about w / tile_width + h / tile_height + 1 tiles;
+ * 'lengths' is w / width + h / height added up for all of the pieces.
+ */
+static void choose_grid(bz_winding_grid& grid, float max_x, float max_y, double lengths) {
+    float width = std::max(max_x - grid.min_x, 1e-6f);
+    float height = std::max(max_y - grid.min_y, 1e-6f);
+    double tiles = std::max(grid.piece_count / PIECES_PER_TILE, 1.0);
+
+    while (true) {
+        grid.columns = std::min(std::max((int) std::sqrt(tiles * width / height), 1), MAX_GRID_SIZE);
+        grid.rows = std::min(std::max((int) (tiles / grid.columns), 1), MAX_GRID_SIZE);
+
+        double entries = lengths * std::max(grid.columns, grid.rows) + grid.piece_count;
+
+        if (tiles <= 1 || entries <= MAX_TILES_PER_PIECE * grid.piece_count) {
+            break;
+        }
+
+        tiles /= 2;
+    }
+
+    // A tiny bit bigger, so that the far edges are inside the last tiles
+    grid.tile_width = width / grid.columns * 1.0001f;
+    grid.tile_height = height / grid.rows * 1.0001f;
+}
+
+
+static inline float middle_x(const bz_winding_grid& grid, int column) {
+    return grid.min_x + (column + 0.5f) * grid.tile_width;
+}
+
+
+static inline float middle_y(const bz_winding_grid& grid, int row) {
+    return grid.min_y + (row + 0.5f) * grid.tile_height;
+}
+
+
+static inline int column_at(const bz_winding_grid& grid, float x) {
+    return std::min(std::max((int) std::floor((x - grid.min_x) / grid.tile_width), 0), grid.columns - 1);
+}
+
+
+static inline int row_at(const bz_winding_grid& grid, float y) {
+    return std::min(std::max((int) std::floor((y - grid.min_y) / grid.tile_height), 0), grid.rows - 1);
+}
+
+
+/*
+ * How many tiles in a row have their middle to the left of x; worked out with exactly
+ * the same sums as bz_winding_numbers does, so that they agree.
+ */
+static int tiles_left_of(const bz_winding_grid& grid, float x) {
+    int left = std::min(std::max((int) ((x - grid.min_x) / grid.tile_width + 0.5f), 0), grid.columns);
+
+    while (left > 0 && !(x > middle_x(grid, left - 1))) {
+        --left;
+    }
+
+    while (left < grid.columns && x > middle_x(grid, left)) {
+        ++left;
+    }
+
+    return left;
+}
+
+
+/*
+ * Call found(row, column, left, right) for every tile a piece passes through, where left to right
+ * is the part of the row which the piece passes through.
+ *
+ * Within each row, that is from where the piece crosses the top of the row to where it crosses the
+ * bottom (or from its start or end, if that is in the row). A little is added on either side, so
+ * that a piece which only just touches a tile is still in it, despite rounding.
+ */
+template <typename Found>
+static void for_each_tile(const bz_winding_grid& grid, const Piece& piece, Found found) {
+    float min_y = std::min(piece.start.y, piece.end.y), max_y = std::max(piece.start.y, piece.end.y);
+    float margin = grid.tile_width * 0.01f;
+    int row0 = row_at(grid, min_y), row1 = row_at(grid, max_y);
+    float top_x = x_at(piece, min_y);
+
+    for (int row = row0; row <= row1; ++row) {
+        float bottom_y = std::min(grid.min_y + (row + 1) * grid.tile_height, max_y);
+        float bottom_x = row == row1 ? x_at(piece, max_y) : x_at(piece, bottom_y);
+        float left = std::min(top_x, bottom_x), right = std::max(top_x, bottom_x);
+
+        // A flat piece is all in one row
+        if (min_y == max_y) {
+            left = std::min(piece.start.x, piece.end.x);
+            right = std::max(piece.start.x, piece.end.x);
+        }
+
+        int column0 = column_at(grid, left - margin), column1 = column_at(grid, right + margin);
+
+        for (int column = column0; column <= column1; ++column) {
+            found(row, column, left, right);
+        }
+
+        top_x = bottom_x;
+    }
+}
+
+
+/*
+ * Everything about the grid except where it goes in memory; the same for bz_winding_grid_size
+ * and bz_winding_grid_build, so that they always agree.
+ */
+static bz_winding_grid plan_grid(const bz_curve *curves, const size_t *path_ends, size_t path_count) {
+    bz_winding_grid grid = {};
+    float max_x = -INFINITY, max_y = -INFINITY;
+    double width_sum = 0, height_sum = 0;
+
+    grid.min_x = grid.min_y = INFINITY;
+
+    for_each_piece(curves, path_ends, path_count, [&](const Piece& piece) {
+        grid.min_x = std::min(grid.min_x, std::min(piece.start.x, piece.end.x));
+        grid.min_y = std::min(grid.min_y, std::min(piece.start.y, piece.end.y));
+        max_x = std::max(max_x, std::max(piece.start.x, piece.end.x));
+        max_y = std::max(max_y, std::max(piece.start.y, piece.end.y));
+        width_sum += std::fabs(piece.end.x - piece.start.x);
+        height_sum += std::fabs(piece.end.y - piece.start.y);
+        ++grid.piece_count;
+    });
+
+    if (grid.piece_count == 0) {
+        grid.min_x = grid.min_y = max_x = max_y = 0;
+    }
+
+    double lengths = width_sum / std::max(max_x - grid.min_x, 1e-6f) + height_sum / std::max(max_y - grid.min_y, 1e-6f);
+    choose_grid(grid, max_x, max_y, lengths);
+
+    for_each_piece(curves, path_ends, path_count, [&grid](const Piece& piece) {
+        for_each_tile(grid, piece, [&grid](int, int, float, float) {
+            ++grid.entry_count;
+        });
+    });
+
+    return grid;
+}
+
+
+size_t bz_winding_grid_size(const bz_curve *curves, const size_t *path_ends, size_t path_count) {
+    bz_winding_grid grid = plan_grid(curves, path_ends, path_count);
+    size_t tiles = (size_t) grid.columns * grid.rows;
+
+    return grid.piece_count * sizeof(Piece) + grid.entry_count * sizeof(TileEntry)
+         + (tiles + 1) * sizeof(uint32_t) + tiles * sizeof(int32_t);
+}
+
+
+bz_winding_grid bz_winding_grid_build(const bz_curve *curves, const size_t *path_ends, size_t path_count, void *memory) {
+    bz_winding_grid grid = plan_grid(curves, path_ends, path_count);
+    grid.memory = memory;
+
+    GridMemory m = grid_memory(grid);
+    size_t tiles = (size_t) grid.columns * grid.rows;
+    size_t piece_count = 0;
+
+    for_each_piece(curves, path_ends, path_count, [&m, &piece_count](const Piece& piece) {
+        m.pieces[piece_count++] = piece;
+    });
+
+    // Count the pieces in each tile, then turn the counts into where each tile's entries start
+    std::fill(m.tile_first, m.tile_first + tiles + 1, 0);
+    std::fill(m.tile_winding, m.tile_winding + tiles, 0);
+
+    for (size_t i = 0; i < piece_count; ++i) {
+        for_each_tile(grid, m.pieces[i], [&grid, &m](int row, int column, float, float) {
+            ++m.tile_first[(size_t) row * grid.columns + column + 1];
+        });
+    }
+
+    for (size_t tile = 0; tile < tiles; ++tile) {
+        m.tile_first[tile + 1] += m.tile_first[tile];
+    }
+
+    // Fill in the entries (using tile_first to count up as they go in, and putting it back afterwards).
+    // At the same time, each piece crossing a tile's middle row adds its direction to the winding
+    // number in the middle of every tile to its left. For now, that is only added to the nearest
+    // of them, and carried along to the others at the end.
+    for (size_t i = 0; i < piece_count; ++i) {
+        const Piece& piece = m.pieces[i];
+        int32_t direction = piece.end.y > piece.start.y ? 1 : -1;
+        int last_row = -1;
+        float x = INFINITY;
+
+        for_each_tile(grid, piece, [&](int row, int column, float left, float right) {
+            if (row != last_row) {
+                x = crossing_x(piece, middle_y(grid, row));
+                last_row = row;
+
+                int left = x != INFINITY ? tiles_left_of(grid, x) : 0;
+
+                if (left > 0) {
+                    m.tile_winding[(size_t) row * grid.columns + left - 1] += direction;
+                }
+            }
+
+            m.entries[m.tile_first[(size_t) row * grid.columns + column]++] = TileEntry{(uint32_t) i, x, left, right};
+        });
+    }
+
+    for (size_t tile = tiles; tile > 0; --tile) {
+        m.tile_first[tile] = m.tile_first[tile - 1];
+    }
+
+    m.tile_first[0] = 0;
+
+    for (int row = 0; row < grid.rows; ++row) {
+        int32_t *winding = m.tile_winding + (size_t) row * grid.columns;
+
+        for (int column = grid.columns - 2; column >= 0; --column) {
+            winding[column] += winding[column + 1];
+        }
+    }
+
+    return grid;
+}
+
+
+/*
+ * Whether a piece crosses the vertical line through x = px somewhere below height y. When the piece
+ * crosses that height too, at x = crossing (or just INFINITY or -INFINITY, if all that is known is
+ * which side of px it is), that says which way round they are: the further a piece goes in x,
+ * the further it goes in y.
+ */
+static inline bool crosses_below(const Piece& piece, float px, float y, float crossing) {
+    float min_y = std::min(piece.start.y, piece.end.y), max_y = std::max(piece.start.y, piece.end.y);
+
+    if (min_y > y || max_y <= y) {
+        return min_y > y;
+    }
+
+    bool same_way = (piece.end.x > piece.start.x) == (piece.end.y > piece.start.y);
+    return same_way ? px > crossing : px < crossing;
+}
+
+
+static int32_t winding_number(const bz_winding_grid& grid, const GridMemory& m, bz_point point) {
+    float px = point.x, py = point.y;
+    int column = (int) std::floor((px - grid.min_x) / grid.tile_width);
+    int row = (int) std::floor((py - grid.min_y) / grid.tile_height);
+
+    // Outside the box around every path, nothing goes round the point
+    if (column < 0 || column >= grid.columns || row < 0 || row >= grid.rows) {
+        return 0;
+    }
+
+    size_t tile = (size_t) row * grid.columns + column;
+    float cx = middle_x(grid, column), cy = middle_y(grid, row);
+    int32_t winding = m.tile_winding[tile];
+
+    for (uint32_t i = m.tile_first[tile]; i < m.tile_first[tile + 1]; ++i) {
+        const TileEntry& entry = m.entries[i];
+        const Piece& piece = m.pieces[entry.piece];
+        int32_t y_direction = piece.end.y > piece.start.y ? 1 : -1;
+
+        // Across the middle row, from the middle of the tile to the point's x; the difference
+        // between what going off to the right from each of them would cross
+        winding += y_direction * ((entry.middle_x > px) - (entry.middle_x > cx));
+
+        // Then up or down to the point. Going down across a piece which goes to the right
+        // is +1, and one which goes to the left is -1; a piece is crossed on the way if it
+        // crosses the point's x below one end of the way and not the other
+        if (!(px >= std::min(piece.start.x, piece.end.x) && px < std::max(piece.start.x, piece.end.x))) {
+            continue;
+        }
+
+        bool below_middle = crosses_below(piece, px, cy, entry.middle_x);
+        // Only work out where the piece crosses the point's row if it could be either side of the point
+        float crossing = px < entry.left ? INFINITY : px > entry.right ? -INFINITY : crossing_x(piece, py);
+        bool below_point = crosses_below(piece, px, py, crossing);
+
+        if (below_middle != below_point) {
+            int32_t x_direction = piece.end.x > piece.start.x ? 1 : -1;
+            winding += below_middle ? x_direction : -x_direction;
+        }
+    }
+
+    return winding;
+}
+
+
+void bz_winding_numbers(const bz_winding_grid *grid, const bz_point *points, size_t count, int32_t *winding) {
+    GridMemory m = grid_memory(*grid);
+
+    for (size_t i = 0; i < count; ++i) {
+        winding[i] = winding_number(*grid, m, points[i]);
+    }
+}
+
+
+void bz_points_inside(const bz_winding_grid *grid, const bz_point *points, size_t count, bz_fill_rule rule, uint8_t *inside) {
+    GridMemory m = grid_memory(*grid);
+
+    for (size_t i = 0; i < count; ++i) {
+        int32_t winding = winding_number(*grid, m, points[i]);
+        inside[i] = rule == BZ_FILL_EVEN_ODD ? (winding & 1) != 0 : winding != 0;
+    }
+}